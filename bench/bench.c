@@ -0,0 +1,407 @@
+#define _POSIX_C_SOURCE 200809L /* clock_gettime, getline, fork */
+
+#include <stdio.h>          /* FILE, fopen, fprintf */
+#include <stdlib.h>         /* EXIT_SUCCESS, malloc, qsort, atoi */
+#include <string.h>         /* strcmp, strrchr */
+#include <sys/resource.h>   /* getrusage */
+#include <sys/wait.h>       /* waitpid */
+#include <time.h>           /* clock_gettime, time */
+#include <unistd.h>         /* fork */
+
+#include "bitmask.h"
+#include "sudoku.h"
+
+/* Puzzles of one corpus file, parsed before anything is timed */
+struct bench_corpus {
+    char name[64];          /* File name without directory and extension */
+    int npuzzles;
+    int maxpuzzles;         /* Capacity of PUZZLES */
+    struct sudoku **puzzles;
+};
+
+/* Measurements of solving one corpus with one engine */
+struct bench_result {
+    long nsolves;           /* Puzzles times rounds */
+    long nsolved;
+    long nwrong;            /* Solutions breaking a rule or a given */
+    double seconds;         /* Time spent in the solver */
+    double mean;            /* Latencies per puzzle in microseconds */
+    double p50;
+    double p99;
+    double max;
+    long maxrss;            /* Peak resident set size in KiB */
+    long nnodes;            /* Search nodes summed over all solves */
+};
+
+/* Returns wall clock time in seconds */
+static double
+bench_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/* Read puzzles in one-line format from FILE into CORPUS, skipping empty lines
+ * and comments starting with '#'. Returns zero if FILE cannot be read or holds
+ * an invalid puzzle. */
+static int
+bench_corpus_read(struct bench_corpus *corpus, const char *file)
+{
+    FILE *in = fopen(file, "r");
+    if (!in) {
+        fprintf(stderr, "Could not read file '%s'!\n", file);
+        return 0;
+    }
+
+    const char *base = strrchr(file, '/');
+    base = base ? base + 1 : file;
+    snprintf(corpus->name, sizeof corpus->name, "%s", base);
+    char *ext = strrchr(corpus->name, '.');
+    if (ext) {
+        *ext = '\0';
+    }
+
+    corpus->npuzzles = 0;
+    corpus->maxpuzzles = 0;
+    corpus->puzzles = NULL;
+
+    char *line = NULL;
+    size_t linecap = 0;
+    ssize_t len;
+    int ok = 1;
+    while (ok && (len = getline(&line, &linecap, in)) != -1) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            --len;
+        }
+        if (len == 0 || line[0] == '#') {
+            continue;
+        }
+        if (corpus->npuzzles == corpus->maxpuzzles) {
+            corpus->maxpuzzles = corpus->maxpuzzles ? 2 * corpus->maxpuzzles : 256;
+            corpus->puzzles = realloc(corpus->puzzles,
+                                      corpus->maxpuzzles * sizeof *corpus->puzzles);
+        }
+        struct sudoku *puzzle = sudoku_create(3);
+        if (!sudoku_parse_line(puzzle, line, (int) len)) {
+            fprintf(stderr, "Invalid puzzle in '%s': %.*s\n", file, (int) len, line);
+            sudoku_free(puzzle);
+            ok = 0;
+            continue;
+        }
+        corpus->puzzles[corpus->npuzzles++] = puzzle;
+    }
+
+    free(line);
+    fclose(in);
+    return ok;
+}
+
+/* Returns whether SOLUTION is a complete grid obeying all rules that keeps the
+ * givens of PUZZLE */
+static int
+bench_check(const struct sudoku *puzzle, const struct sudoku *solution)
+{
+    const int size = puzzle->size;
+    const int nelems = puzzle->nelems;
+    char seen[3][64 * 64];
+
+    if (solution->nelems != nelems || nelems > 64) {
+        return 0;
+    }
+    memset(seen, 0, sizeof seen);
+    for (int cell = 0; cell < nelems * nelems; ++cell) {
+        const int elem = solution->data[cell];
+        if (elem < 1 || elem > nelems
+            || (puzzle->data[cell] != 0 && puzzle->data[cell] != elem)) {
+            return 0;
+        }
+        const int row = cell / nelems;
+        const int col = cell % nelems;
+        const int units[3] = { row, col, (row / size) * size + col / size };
+        for (int i = 0; i < 3; ++i) {
+            char *mark = &seen[i][units[i] * nelems + elem - 1];
+            if (*mark) {
+                return 0;
+            }
+            *mark = 1;
+        }
+    }
+    return 1;
+}
+
+static int
+bench_compare(const void *a, const void *b)
+{
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/* Returns the P-quantile of the N ascending values VALUES (nearest rank) */
+static double
+bench_quantile(const double *values, long n, double p)
+{
+    long rank = (long) (p * n + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+    return values[rank - 1];
+}
+
+/* Solve every puzzle of CORPUS ROUNDS times with options OPTS, timing each
+ * solve on its own, and store the measurements in RESULT */
+static void
+bench_run(const struct bench_corpus *corpus, const struct sudoku_options *opts,
+          int rounds, struct bench_result *result)
+{
+    struct sudoku_solver *solver = sudoku_solver_create(opts);
+    struct sudoku *solution = sudoku_create(3);
+    double *latencies = malloc((size_t) corpus->npuzzles * rounds * sizeof *latencies);
+
+    result->nsolves = 0;
+    result->nsolved = 0;
+    result->nwrong = 0;
+    result->seconds = 0;
+    result->nnodes = 0;
+    for (int round = 0; round < rounds; ++round) {
+        for (int i = 0; i < corpus->npuzzles; ++i) {
+            const struct sudoku *puzzle = corpus->puzzles[i];
+            if (solution->size != puzzle->size) {
+                sudoku_free(solution);
+                solution = sudoku_create(puzzle->size);
+            }
+
+            const double start = bench_time();
+            const int solved = sudoku_solver_solve(solver, puzzle, solution);
+            const double seconds = bench_time() - start;
+
+            latencies[result->nsolves++] = 1e6 * seconds;
+            result->seconds += seconds;
+            result->nnodes += sudoku_solver_stats(solver)->nnodes;
+            if (solved) {
+                ++result->nsolved;
+                result->nwrong += !bench_check(puzzle, solution);
+            }
+        }
+    }
+
+    qsort(latencies, result->nsolves, sizeof *latencies, &bench_compare);
+    result->mean = result->nsolves ? 1e6 * result->seconds / result->nsolves : 0;
+    result->p50 = result->nsolves ? bench_quantile(latencies, result->nsolves, 0.5) : 0;
+    result->p99 = result->nsolves ? bench_quantile(latencies, result->nsolves, 0.99) : 0;
+    result->max = result->nsolves ? latencies[result->nsolves - 1] : 0;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    result->maxrss = usage.ru_maxrss;
+
+    free(latencies);
+    sudoku_free(solution);
+    sudoku_solver_free(solver);
+}
+
+static const char *
+bench_engine_name(enum sudoku_engine engine)
+{
+    return (engine == SUDOKU_ENGINE_DLX) ? "dlx"
+         : (engine == SUDOKU_ENGINE_BITMASK) ? "bitmask"
+         : (engine == SUDOKU_ENGINE_BITSET) ? "bitset" : "auto";
+}
+
+static const char *
+bench_propagate_name(enum sudoku_propagate propagate)
+{
+    return (propagate == SUDOKU_PROPAGATE_NONE) ? "none"
+         : (propagate == SUDOKU_PROPAGATE_LOCKED) ? "locked" : "singles";
+}
+
+/* Benchmark corpus FILE with options OPTS and write a line of results to
+ * standard output and a JSON object to JSON unless it is NULL. Engines the
+ * corpus is too large for are skipped. Returns zero if the corpus could not
+ * be read or some solution was wrong. */
+static int
+bench_corpus(const char *file, const struct sudoku_options *opts, int rounds,
+             FILE *json)
+{
+    struct bench_corpus corpus;
+    if (!bench_corpus_read(&corpus, file)) {
+        return 0;
+    }
+
+    int ok = 1;
+    if (corpus.npuzzles > 0 && (opts->engine != SUDOKU_ENGINE_BITMASK
+                                || bitmask_supports(corpus.puzzles[0]->size))) {
+        struct bench_result res;
+        bench_run(&corpus, opts, rounds, &res);
+        const double rate = res.seconds > 0 ? res.nsolves / res.seconds : 0;
+
+        printf("%-12s %-8s %8ld %8ld %10.0f %10.1f %10.1f %10.1f %10.1f %8ld %12ld\n",
+               corpus.name, bench_engine_name(opts->engine), res.nsolves, res.nsolved,
+               rate, res.mean, res.p50, res.p99, res.max, res.maxrss, res.nnodes);
+        if (json) {
+            fprintf(json, "{\"time\": %ld, \"corpus\": \"%s\", \"engine\": \"%s\", "
+                    "\"propagate\": \"%s\", \"puzzles\": %ld, \"solved\": %ld, "
+                    "\"wrong\": %ld, \"seconds\": %.6f, \"puzzles_per_sec\": %.1f, "
+                    "\"mean_us\": %.2f, \"p50_us\": %.2f, \"p99_us\": %.2f, "
+                    "\"max_us\": %.2f, \"peak_rss_kib\": %ld, \"nodes\": %ld}\n",
+                    (long) time(NULL), corpus.name, bench_engine_name(opts->engine),
+                    bench_propagate_name(opts->propagate), res.nsolves, res.nsolved,
+                    res.nwrong, res.seconds, rate, res.mean, res.p50, res.p99,
+                    res.max, res.maxrss, res.nnodes);
+        }
+        if (res.nwrong > 0) {
+            fprintf(stderr, "%ld wrong solutions for '%s'!\n", res.nwrong, file);
+            ok = 0;
+        }
+    }
+
+    for (int i = 0; i < corpus.npuzzles; ++i) {
+        sudoku_free(corpus.puzzles[i]);
+    }
+    free(corpus.puzzles);
+    return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+    static const char *usage =
+      "usage: bench [OPTIONS] CORPUS...\n"
+      "Solve every puzzle of each CORPUS (one puzzle per line) with each engine\n"
+      "and report throughput, latency per puzzle, peak memory and search nodes.\n"
+      "Each corpus and engine runs in a process of its own, so that peak memory\n"
+      "is measured separately.\n"
+      "\n"
+      "  -e, --engine  engine to run: dlx, bitmask, bitset, all (default)\n"
+      "  -p, --propagate  logic applied before searching: none, singles\n"
+      "                (default), locked\n"
+      "  -r, --rounds  solve every puzzle N times (default 1)\n"
+      "  -o, --json    append results as one JSON object per line to FILE\n"
+      "  -h, --help    display this help and exit\n";
+
+    enum sudoku_engine engines[3] = {
+        SUDOKU_ENGINE_DLX, SUDOKU_ENGINE_BITMASK, SUDOKU_ENGINE_BITSET
+    };
+    int nengines = 3;
+    struct sudoku_options opts = {
+        SUDOKU_ENGINE_AUTO, SUDOKU_PROPAGATE_SINGLES,
+        { DLSELECT_MRV, 0, 1, { 0, 0, NULL } }
+    };
+    int rounds = 1;
+    const char *jsonfile = NULL;
+    int ncorpora = 0;
+    char **corpora = malloc(argc * sizeof *corpora);
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-e") == 0 || strcmp(argv[i], "--engine") == 0) {
+            ++i;
+            nengines = 1;
+            if (i < argc && strcmp(argv[i], "dlx") == 0) {
+                engines[0] = SUDOKU_ENGINE_DLX;
+            } else if (i < argc && strcmp(argv[i], "bitmask") == 0) {
+                engines[0] = SUDOKU_ENGINE_BITMASK;
+            } else if (i < argc && strcmp(argv[i], "bitset") == 0) {
+                engines[0] = SUDOKU_ENGINE_BITSET;
+            } else if (i < argc && strcmp(argv[i], "all") == 0) {
+                nengines = 3;
+            } else {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--propagate") == 0) {
+            ++i;
+            if (i < argc && strcmp(argv[i], "none") == 0) {
+                opts.propagate = SUDOKU_PROPAGATE_NONE;
+            } else if (i < argc && strcmp(argv[i], "singles") == 0) {
+                opts.propagate = SUDOKU_PROPAGATE_SINGLES;
+            } else if (i < argc && strcmp(argv[i], "locked") == 0) {
+                opts.propagate = SUDOKU_PROPAGATE_LOCKED;
+            } else {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--rounds") == 0) {
+            ++i;
+            if (i == argc || atoi(argv[i]) < 1) {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            rounds = atoi(argv[i]);
+            continue;
+        }
+
+        if (strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--json") == 0) {
+            ++i;
+            if (i == argc) {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            jsonfile = argv[i];
+            continue;
+        }
+
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            fprintf(stdout, "%s", usage);
+            return EXIT_SUCCESS;
+        }
+
+        corpora[ncorpora++] = argv[i];
+    }
+
+    if (ncorpora == 0) {
+        fprintf(stderr, "%s", usage);
+        return EXIT_FAILURE;
+    }
+
+    FILE *json = NULL;
+    if (jsonfile) {
+        json = fopen(jsonfile, "a");
+        if (!json) {
+            fprintf(stderr, "Could not open output file '%s'\n", jsonfile);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("%-12s %-8s %8s %8s %10s %10s %10s %10s %10s %8s %12s\n",
+           "corpus", "engine", "puzzles", "solved", "puzzles/s", "mean_us", "p50_us",
+           "p99_us", "max_us", "rss_kib", "nodes");
+
+    int ok = 1;
+    for (int i = 0; i < ncorpora; ++i) {
+        for (int k = 0; k < nengines; ++k) {
+            opts.engine = engines[k];
+
+            /* Buffered output must not be written twice */
+            fflush(NULL);
+            const pid_t pid = fork();
+            if (pid == 0) {
+                const int res = bench_corpus(corpora[i], &opts, rounds, json);
+                fflush(NULL);
+                _exit(res ? EXIT_SUCCESS : EXIT_FAILURE);
+            }
+
+            int status = 0;
+            if (pid < 0) {
+                /* Peak memory then covers all runs so far */
+                ok &= bench_corpus(corpora[i], &opts, rounds, json);
+            } else if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)
+                       || WEXITSTATUS(status) != EXIT_SUCCESS) {
+                ok = 0;
+            }
+        }
+    }
+
+    if (json) {
+        fclose(json);
+    }
+    free(corpora);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,576 @@
+#define _POSIX_C_SOURCE 200809L /* clock_gettime, getline */
+
+#include <errno.h>          /* errno */
+#include <pthread.h>        /* pthread_create */
+#include <signal.h>         /* signal, SIGPIPE */
+#include <stdio.h>          /* FILE, fopen, fprintf */
+#include <stdlib.h>         /* EXIT_SUCCESS, malloc, qsort, atoi */
+#include <string.h>         /* strcmp, memcpy */
+#include <sys/socket.h>     /* socket, connect */
+#include <sys/un.h>         /* sockaddr_un */
+#include <time.h>           /* clock_gettime */
+#include <unistd.h>         /* read, write, close */
+
+#include "server.h"
+
+/* Puzzles in one-line format, sent as they are */
+struct client_corpus {
+    int npuzzles;
+    int maxpuzzles;         /* Capacity of LINES and LENS */
+    char **lines;
+    int *lens;
+};
+
+/* One connection of a load test, with its own thread */
+struct client_conn {
+    pthread_t thread;
+    const char *path;
+    const struct client_corpus *corpus;
+    int inflight;           /* Requests kept in flight */
+    int first;              /* Puzzle sent first */
+    double seconds;         /* Duration of the test */
+    long nrequests;         /* Responses received */
+    long nfailed;           /* Responses with another status than solved */
+    long nlatencies;
+    long maxlatencies;      /* Capacity of LATENCIES */
+    double *latencies;      /* Round trip of each request in microseconds */
+    int ok;                 /* Whether the connection worked throughout */
+};
+
+/* Returns wall clock time in seconds */
+static double
+client_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/* Read puzzles in one-line format from FILE into CORPUS, skipping empty lines
+ * and comments starting with '#'. Returns zero if FILE cannot be read or has
+ * a line too long for a request. */
+static int
+client_corpus_read(struct client_corpus *corpus, const char *file)
+{
+    FILE *in = (strcmp(file, "-") == 0) ? stdin : fopen(file, "r");
+    if (!in) {
+        fprintf(stderr, "Could not read file '%s'!\n", file);
+        return 0;
+    }
+
+    corpus->npuzzles = 0;
+    corpus->maxpuzzles = 0;
+    corpus->lines = NULL;
+    corpus->lens = NULL;
+
+    char *line = NULL;
+    size_t linecap = 0;
+    ssize_t len;
+    int ok = 1;
+    while (ok && (len = getline(&line, &linecap, in)) != -1) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            --len;
+        }
+        if (len == 0 || line[0] == '#') {
+            continue;
+        }
+        if (len > SERVER_MAX_PAYLOAD) {
+            fprintf(stderr, "Puzzle in '%s' is too long!\n", file);
+            ok = 0;
+            continue;
+        }
+        if (corpus->npuzzles == corpus->maxpuzzles) {
+            corpus->maxpuzzles = corpus->maxpuzzles ? 2 * corpus->maxpuzzles : 256;
+            corpus->lines = realloc(corpus->lines,
+                                    corpus->maxpuzzles * sizeof *corpus->lines);
+            corpus->lens = realloc(corpus->lens, corpus->maxpuzzles * sizeof *corpus->lens);
+        }
+        corpus->lines[corpus->npuzzles] = malloc(len);
+        memcpy(corpus->lines[corpus->npuzzles], line, len);
+        corpus->lens[corpus->npuzzles] = (int) len;
+        ++corpus->npuzzles;
+    }
+
+    free(line);
+    if (in != stdin) {
+        fclose(in);
+    }
+    return ok;
+}
+
+static void
+client_corpus_free(struct client_corpus *corpus)
+{
+    for (int i = 0; i < corpus->npuzzles; ++i) {
+        free(corpus->lines[i]);
+    }
+    free(corpus->lines);
+    free(corpus->lens);
+}
+
+/* Returns socket connected to server at PATH, or -1 */
+static int
+client_connect(const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof addr.sun_path) {
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof addr) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+/* Write the LEN bytes of BUF to FD. Returns zero on error. */
+static int
+client_write_all(int fd, const unsigned char *buf, size_t len)
+{
+    while (len > 0) {
+        const ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 0;
+        }
+        buf += n;
+        len -= (size_t) n;
+    }
+    return 1;
+}
+
+/* Append request of type TYPE with id ID and the LEN bytes of PAYLOAD to BUF
+ * at *POS, and advance *POS */
+static void
+client_put_request(unsigned char *buf, size_t *pos, uint32_t id, int type,
+                   const char *payload, int len)
+{
+    server_put_header(buf + *pos, (uint32_t) len, id, type);
+    memcpy(buf + *pos + SERVER_HEADER_SIZE, payload, len);
+    *pos += SERVER_HEADER_SIZE + len;
+}
+
+/* Response read by `client_read_response' */
+struct client_response {
+    uint32_t id;
+    int status;
+    int len;
+    const unsigned char *payload;
+};
+
+/* Reader of responses from a connection */
+struct client_reader {
+    int fd;
+    unsigned char buf[65536];
+    size_t pos;
+    size_t len;
+};
+
+/* Read next response from READER into RESP, reading from its socket only if
+ * no complete response is buffered. RESP stays valid until the next call.
+ * Returns zero if the connection ended. */
+static int
+client_read_response(struct client_reader *reader, struct client_response *resp)
+{
+    for (;;) {
+        const size_t avail = reader->len - reader->pos;
+        if (avail >= 4) {
+            const uint32_t flen = server_get_u32(reader->buf + reader->pos);
+            if (flen < SERVER_HEADER_SIZE - 4 || flen > sizeof reader->buf - 4) {
+                return 0;
+            }
+            if (avail >= 4 + flen) {
+                const unsigned char *frame = reader->buf + reader->pos;
+                resp->id = server_get_u32(frame + 4);
+                resp->status = frame[8];
+                resp->len = (int) (flen + 4 - SERVER_HEADER_SIZE);
+                resp->payload = frame + SERVER_HEADER_SIZE;
+                reader->pos += 4 + flen;
+                return 1;
+            }
+        }
+        memmove(reader->buf, reader->buf + reader->pos, avail);
+        reader->len = avail;
+        reader->pos = 0;
+        const ssize_t n = read(reader->fd, reader->buf + reader->len,
+                               sizeof reader->buf - reader->len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 0;
+        }
+        reader->len += (size_t) n;
+    }
+}
+
+/* Returns whether the next response of READER could be read without waiting */
+static int
+client_response_buffered(const struct client_reader *reader)
+{
+    const size_t avail = reader->len - reader->pos;
+    return avail >= 4 && avail >= 4 + server_get_u32(reader->buf + reader->pos);
+}
+
+/* Send stats request over READER's connection and print the answer to OUT.
+ * Returns zero on error. */
+static int
+client_print_stats(struct client_reader *reader, FILE *out)
+{
+    unsigned char req[SERVER_HEADER_SIZE];
+    size_t pos = 0;
+    client_put_request(req, &pos, 0, SERVER_REQUEST_STATS, "", 0);
+    struct client_response resp;
+    if (!client_write_all(reader->fd, req, pos) || !client_read_response(reader, &resp)
+        || resp.status != SERVER_STATUS_STATS) {
+        return 0;
+    }
+    fprintf(out, "%.*s", resp.len, (const char *) resp.payload);
+    return 1;
+}
+
+/* Send all puzzles of CORPUS to the server at PATH with up to INFLIGHT
+ * requests in flight and print one line per puzzle in input order: the
+ * solution, or "unsolvable", "aborted" resp. "invalid". Prints statistics of the server
+ * if SHOWSTATS is set. Returns zero on error. */
+static int
+client_solve(const char *path, const struct client_corpus *corpus, int inflight,
+             int showstats)
+{
+    const int fd = client_connect(path);
+    if (fd < 0) {
+        fprintf(stderr, "Could not connect to '%s'!\n", path);
+        return 0;
+    }
+
+    /* Request ids are puzzle indices; answers are kept until all before
+     * them are printed */
+    const int n = corpus->npuzzles;
+    char **answers = calloc(n ? n : 1, sizeof *answers);
+    int *lens = malloc((n ? n : 1) * sizeof *lens);
+    unsigned char *sendbuf = malloc((size_t) inflight
+                                    * (SERVER_HEADER_SIZE + SERVER_MAX_PAYLOAD));
+    struct client_reader *reader = malloc(sizeof *reader);
+    reader->fd = fd;
+    reader->pos = 0;
+    reader->len = 0;
+
+    int nsent = 0;
+    int nrecv = 0;
+    int nprinted = 0;
+    int ok = 1;
+    while (ok && nprinted < n) {
+        /* Fill the window, then wait for what is ready */
+        size_t pos = 0;
+        while (nsent < n && nsent - nrecv < inflight) {
+            client_put_request(sendbuf, &pos, (uint32_t) nsent, SERVER_REQUEST_SOLVE,
+                               corpus->lines[nsent], corpus->lens[nsent]);
+            ++nsent;
+        }
+        if (pos > 0 && !client_write_all(fd, sendbuf, pos)) {
+            ok = 0;
+            break;
+        }
+        do {
+            struct client_response resp;
+            if (!client_read_response(reader, &resp) || (int) resp.id >= n
+                || answers[resp.id]) {
+                ok = 0;
+                break;
+            }
+            const char *text = (resp.status == SERVER_STATUS_SOLVED) ? (const char *) resp.payload
+                             : (resp.status == SERVER_STATUS_UNSOLVABLE) ? "unsolvable"
+                             : (resp.status == SERVER_STATUS_ABORTED) ? "aborted"
+                             : "invalid";
+            lens[resp.id] = (resp.status == SERVER_STATUS_SOLVED) ? resp.len
+                                                                  : (int) strlen(text);
+            answers[resp.id] = malloc(lens[resp.id] + 1);
+            memcpy(answers[resp.id], text, lens[resp.id]);
+            ++nrecv;
+        } while (client_response_buffered(reader));
+
+        while (nprinted < n && answers[nprinted]) {
+            fwrite(answers[nprinted], 1, lens[nprinted], stdout);
+            putchar('\n');
+            free(answers[nprinted]);
+            answers[nprinted] = NULL;
+            ++nprinted;
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "Connection to '%s' failed!\n", path);
+    }
+    if (ok && showstats) {
+        ok = client_print_stats(reader, stderr);
+    }
+
+    for (int i = nprinted; i < n; ++i) {
+        free(answers[i]);
+    }
+    free(answers);
+    free(lens);
+    free(sendbuf);
+    free(reader);
+    close(fd);
+    return ok;
+}
+
+/* Thread of one connection of a load test ARG: keeps its requests in flight,
+ * going round the puzzles, until its time is up */
+static void *
+client_conn_run(void *arg)
+{
+    struct client_conn *conn = arg;
+    const struct client_corpus *corpus = conn->corpus;
+    const int inflight = conn->inflight;
+
+    conn->nrequests = 0;
+    conn->nfailed = 0;
+    conn->nlatencies = 0;
+    conn->maxlatencies = 0;
+    conn->latencies = NULL;
+    conn->ok = 0;
+    const int fd = client_connect(conn->path);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    /* Request ids are slots of the window, which keep their send time */
+    double *sent = malloc(inflight * sizeof *sent);
+    unsigned char *sendbuf = malloc((size_t) inflight
+                                    * (SERVER_HEADER_SIZE + SERVER_MAX_PAYLOAD));
+    struct client_reader *reader = malloc(sizeof *reader);
+    reader->fd = fd;
+    reader->pos = 0;
+    reader->len = 0;
+
+    int next = conn->first;
+    const double end = client_time() + conn->seconds;
+    size_t pos = 0;
+    for (int slot = 0; slot < inflight; ++slot) {
+        client_put_request(sendbuf, &pos, (uint32_t) slot, SERVER_REQUEST_SOLVE,
+                           corpus->lines[next], corpus->lens[next]);
+        next = (next + 1) % corpus->npuzzles;
+        sent[slot] = client_time();
+    }
+    int ok = client_write_all(fd, sendbuf, pos);
+    int pending = inflight;
+    int sending = 1;
+    while (ok && pending > 0) {
+        pos = 0;
+        do {
+            struct client_response resp;
+            if (!client_read_response(reader, &resp) || (int) resp.id >= inflight) {
+                ok = 0;
+                break;
+            }
+            const double now = client_time();
+            if (conn->nlatencies == conn->maxlatencies) {
+                conn->maxlatencies = conn->maxlatencies ? 2 * conn->maxlatencies : 65536;
+                conn->latencies = realloc(conn->latencies,
+                                          conn->maxlatencies * sizeof *conn->latencies);
+            }
+            conn->latencies[conn->nlatencies++] = 1e6 * (now - sent[resp.id]);
+            ++conn->nrequests;
+            conn->nfailed += resp.status != SERVER_STATUS_SOLVED;
+            --pending;
+
+            sending = sending && now < end;
+            if (sending) {
+                client_put_request(sendbuf, &pos, resp.id, SERVER_REQUEST_SOLVE,
+                                   corpus->lines[next], corpus->lens[next]);
+                next = (next + 1) % corpus->npuzzles;
+                sent[resp.id] = now;
+                ++pending;
+            }
+        } while (client_response_buffered(reader));
+        if (ok && pos > 0) {
+            ok = client_write_all(fd, sendbuf, pos);
+        }
+    }
+    conn->ok = ok;
+
+    free(sent);
+    free(sendbuf);
+    free(reader);
+    close(fd);
+    return NULL;
+}
+
+static int
+client_compare(const void *a, const void *b)
+{
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/* Returns the P-quantile of the N ascending values VALUES (nearest rank) */
+static double
+client_quantile(const double *values, long n, double p)
+{
+    long rank = (long) (p * n + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+    return values[rank - 1];
+}
+
+/* Load server at PATH for SECONDS seconds over NCONNS connections with
+ * INFLIGHT requests in flight each, going round the puzzles of CORPUS, and
+ * print throughput and round trip latencies, and the statistics of the server
+ * if SHOWSTATS is set. Returns zero on error. */
+static int
+client_load(const char *path, const struct client_corpus *corpus, int nconns,
+            int inflight, double seconds, int showstats)
+{
+    struct client_conn *conns = malloc(nconns * sizeof *conns);
+    const double start = client_time();
+    for (int i = 0; i < nconns; ++i) {
+        conns[i].path = path;
+        conns[i].corpus = corpus;
+        conns[i].inflight = inflight;
+        conns[i].first = (int) ((long) i * corpus->npuzzles / nconns);
+        conns[i].seconds = seconds;
+        pthread_create(&conns[i].thread, NULL, &client_conn_run, &conns[i]);
+    }
+
+    long nrequests = 0;
+    long nfailed = 0;
+    int ok = 1;
+    for (int i = 0; i < nconns; ++i) {
+        pthread_join(conns[i].thread, NULL);
+        nrequests += conns[i].nrequests;
+        nfailed += conns[i].nfailed;
+        ok &= conns[i].ok;
+    }
+    const double elapsed = client_time() - start;
+
+    double *latencies = malloc((nrequests ? nrequests : 1) * sizeof *latencies);
+    long n = 0;
+    for (int i = 0; i < nconns; ++i) {
+        memcpy(latencies + n, conns[i].latencies,
+               conns[i].nlatencies * sizeof *latencies);
+        n += conns[i].nlatencies;
+        free(conns[i].latencies);
+    }
+    qsort(latencies, n, sizeof *latencies, &client_compare);
+
+    if (!ok) {
+        fprintf(stderr, "Connection to '%s' failed!\n", path);
+    }
+    printf("%d connections, %d in flight each: %ld requests in %.3f s "
+           "(%.0f requests/s), %ld not solved\n",
+           nconns, inflight, nrequests, elapsed, elapsed > 0 ? nrequests / elapsed : 0.0,
+           nfailed);
+    printf("round trip p50 %.1f us, p99 %.1f us, max %.1f us\n",
+           n ? client_quantile(latencies, n, 0.5) : 0.0,
+           n ? client_quantile(latencies, n, 0.99) : 0.0,
+           n ? latencies[n - 1] : 0.0);
+    free(latencies);
+    free(conns);
+
+    if (showstats) {
+        struct client_reader *reader = malloc(sizeof *reader);
+        reader->fd = client_connect(path);
+        reader->pos = 0;
+        reader->len = 0;
+        if (reader->fd < 0 || !client_print_stats(reader, stdout)) {
+            fprintf(stderr, "Could not get statistics from '%s'!\n", path);
+            ok = 0;
+        }
+        if (reader->fd >= 0) {
+            close(reader->fd);
+        }
+        free(reader);
+    }
+
+    return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+    static const char *usage =
+      "usage: client [OPTIONS] FILE\n"
+      "Send the puzzles in one-line format of FILE (or - for stdin) to a server\n"
+      "started with 'sudoku --serve SOCKET' and write one line per puzzle to\n"
+      "standard output, as 'sudoku --batch' does. With --load measure the\n"
+      "sustained throughput of the server instead.\n"
+      "\n"
+      "  -s, --socket       socket of the server (default sudoku.sock)\n"
+      "  -n, --inflight     requests in flight per connection (default 64)\n"
+      "      --load         send the puzzles over and over and report request\n"
+      "                     rate and round trip latencies\n"
+      "  -c, --connections  connections of the load test (default 1)\n"
+      "  -t, --seconds      duration of the load test (default 5)\n"
+      "      --stats        print statistics of the server at the end\n"
+      "  -h, --help         display this help and exit\n";
+
+    const char *path = "sudoku.sock";
+    const char *file = NULL;
+    int inflight = 64;
+    int load = 0;
+    int nconns = 1;
+    double seconds = 5;
+    int showstats = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const int has_arg = i + 1 < argc;
+        if ((strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--socket") == 0) && has_arg) {
+            path = argv[++i];
+        } else if ((strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "--inflight") == 0)
+                   && has_arg) {
+            inflight = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--load") == 0) {
+            load = 1;
+        } else if ((strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--connections") == 0)
+                   && has_arg) {
+            nconns = atoi(argv[++i]);
+        } else if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--seconds") == 0)
+                   && has_arg) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            showstats = 1;
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            fprintf(stdout, "%s", usage);
+            return EXIT_SUCCESS;
+        } else if (!file) {
+            file = argv[i];
+        } else {
+            fprintf(stderr, "%s", usage);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!file || inflight < 1 || nconns < 1) {
+        fprintf(stderr, "%s", usage);
+        return EXIT_FAILURE;
+    }
+
+    /* A server going away shows as a failed write instead */
+    signal(SIGPIPE, SIG_IGN);
+
+    struct client_corpus corpus;
+    if (!client_corpus_read(&corpus, file)) {
+        return EXIT_FAILURE;
+    }
+    if (load && corpus.npuzzles == 0) {
+        fprintf(stderr, "No puzzles in '%s'!\n", file);
+        client_corpus_free(&corpus);
+        return EXIT_FAILURE;
+    }
+
+    const int ok = load ? client_load(path, &corpus, nconns, inflight, seconds, showstats)
+                        : client_solve(path, &corpus, inflight, showstats);
+    client_corpus_free(&corpus);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,617 @@
+#define _POSIX_C_SOURCE 200809L /* clock_gettime */
+
+#include "batch.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "input.h"
+#include "packed.h"
+#include "sudoku.h"
+
+/* Number of puzzles read, solved and written at a time */
+#define BATCH_BLOCK_SIZE 65536
+
+/* Initial size of the buffer streams are read into */
+#define BATCH_BUFFER_SIZE (1 << 22)
+
+/* Number of puzzles per unit of work handed between threads */
+#define BATCH_CHUNK_SIZE 64
+
+/* Longest status line written instead of a solution */
+#define BATCH_STATUS_SIZE 16
+
+/* Source of input lines: a mapped file, or a buffer refilled from a stream.
+ * Lines are parsed where they lie, without copying them. Packed files are
+ * read the same way, with records in place of lines. */
+struct batch_reader {
+    FILE *in;
+    struct input input;     /* Mapped file */
+    char *buf;              /* Stream buffer, NULL if the file is mapped */
+    size_t cap;
+    const char *data;       /* Data not read yet is DATA[POS] to DATA[LEN - 1] */
+    size_t pos;
+    size_t len;
+    int eof;                /* Nothing left to add to DATA */
+    int packed;             /* Whether the file is packed */
+    struct packed_header hdr;   /* Header of a packed file */
+    uint64_t nleft;         /* Records of a packed file still to read */
+};
+
+/* Block of input lines and the output lines produced for them */
+struct batch_block {
+    int nlines;
+    const char **lines;     /* Start of each line in the data of the reader */
+    int *lens;              /* Length of each line without newline */
+    const struct packed_header *in;     /* Header of packed lines, NULL for
+                                         * text */
+    const struct packed_header *out;    /* Header of packed output, NULL for
+                                         * text */
+    char *outbuf;       /* Output lines, at OUTOFFS[I] for line I */
+    size_t outcap;
+    size_t *outoffs;
+    int *outlens;
+};
+
+/* State of one worker thread. Chunks [LO, HI) of the current block are still
+ * to be solved; the owner takes them from the front, thieves from the back. */
+struct batch_worker {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    int lo;
+    int hi;
+    int id;
+    int nworkers;
+    struct batch_worker *workers;
+    struct batch_block *block;
+    struct sudoku_solver *solver;
+    struct cache *cache;
+    struct canon *canon;    /* NULL if there is no cache */
+    struct sudoku *puzzle;
+    struct sudoku *solution;
+    long nsolved;
+    long ninvalid;
+    long naborted;
+    long ncached;
+    long npropagated;
+    long nnodes;
+    struct dlstats search;
+};
+
+/* Returns wall clock time in seconds */
+static double
+batch_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static struct batch_block *
+batch_block_create(void)
+{
+    struct batch_block *block = malloc(sizeof *block);
+    block->nlines = 0;
+    block->in = NULL;
+    block->out = NULL;
+    block->lines = malloc(BATCH_BLOCK_SIZE * sizeof *block->lines);
+    block->lens = malloc(BATCH_BLOCK_SIZE * sizeof *block->lens);
+    block->outcap = 1 << 20;
+    block->outbuf = malloc(block->outcap);
+    block->outoffs = malloc(BATCH_BLOCK_SIZE * sizeof *block->outoffs);
+    block->outlens = malloc(BATCH_BLOCK_SIZE * sizeof *block->outlens);
+    return block;
+}
+
+static void
+batch_block_free(struct batch_block *block)
+{
+    if (!block) {
+        return;
+    }
+    free(block->lines);
+    free(block->lens);
+    free(block->outbuf);
+    free(block->outoffs);
+    free(block->outlens);
+    free(block);
+}
+
+/* Move data of READER not read yet to the front of its buffer and fill the
+ * rest from its stream. This moves lines, so none may be in use. */
+static void
+batch_reader_fill(struct batch_reader *reader)
+{
+    if (reader->eof) {
+        return;
+    }
+    reader->len -= reader->pos;
+    memmove(reader->buf, &reader->buf[reader->pos], reader->len);
+    reader->pos = 0;
+    while (reader->len < reader->cap && !reader->eof) {
+        const size_t n = fread(&reader->buf[reader->len], 1, reader->cap - reader->len,
+                               reader->in);
+        reader->len += n;
+        reader->eof = (n == 0);
+    }
+}
+
+/* Set up READER for file IN, which is mapped if possible, and read the
+ * header if it is packed */
+static void
+batch_reader_open(struct batch_reader *reader, FILE *in)
+{
+    reader->in = in;
+    reader->pos = 0;
+    if (input_map(&reader->input, in)) {
+        reader->buf = NULL;
+        reader->cap = 0;
+        reader->data = reader->input.data;
+        reader->len = reader->input.len;
+        reader->eof = 1;
+    } else {
+        reader->cap = BATCH_BUFFER_SIZE;
+        reader->buf = malloc(reader->cap);
+        reader->data = reader->buf;
+        reader->len = 0;
+        reader->eof = 0;
+        batch_reader_fill(reader);
+    }
+
+    reader->packed = packed_header_get(&reader->hdr, (const unsigned char *) reader->data,
+                                       reader->len);
+    if (reader->packed) {
+        reader->pos = PACKED_HEADER_SIZE;
+        reader->nleft = reader->hdr.count;
+    }
+}
+
+static void
+batch_reader_close(struct batch_reader *reader)
+{
+    if (reader->buf) {
+        free(reader->buf);
+    } else {
+        input_free(&reader->input);
+    }
+}
+
+/* Read up to BATCH_BLOCK_SIZE records of packed READER into BLOCK */
+static void
+batch_block_read_packed(struct batch_block *block, struct batch_reader *reader)
+{
+    const size_t recsize = reader->hdr.recsize;
+    while (block->nlines < BATCH_BLOCK_SIZE && reader->nleft > 0) {
+        const size_t avail = reader->len - reader->pos;
+        if (avail < recsize) {
+            /* A record cut short at the end of the file is dropped */
+            if (reader->eof || block->nlines > 0) {
+                break;
+            }
+            batch_reader_fill(reader);
+            continue;
+        }
+        block->lines[block->nlines] = &reader->data[reader->pos];
+        block->lens[block->nlines] = (int) recsize;
+        ++block->nlines;
+        reader->pos += recsize;
+        if (reader->nleft != PACKED_COUNT_UNKNOWN) {
+            --reader->nleft;
+        }
+    }
+}
+
+/* Read up to BATCH_BLOCK_SIZE puzzle lines from READER into BLOCK. Returns
+ * number of lines read. */
+static int
+batch_block_read(struct batch_block *block, struct batch_reader *reader)
+{
+    block->nlines = 0;
+    batch_reader_fill(reader);
+    if (reader->packed) {
+        batch_block_read_packed(block, reader);
+        return block->nlines;
+    }
+    while (block->nlines < BATCH_BLOCK_SIZE) {
+        const char *line = &reader->data[reader->pos];
+        const size_t avail = reader->len - reader->pos;
+        const char *nl = memchr(line, '\n', avail);
+        size_t len;
+        if (nl) {
+            len = nl - line;
+            reader->pos += len + 1;
+        } else if (reader->eof) {
+            /* Last line without newline */
+            if (avail == 0) {
+                break;
+            }
+            len = avail;
+            reader->pos += len;
+        } else if (block->nlines > 0) {
+            /* Line goes on past the buffer, it starts the next block */
+            break;
+        } else {
+            /* Line is longer than the buffer */
+            reader->cap *= 2;
+            reader->buf = realloc(reader->buf, reader->cap);
+            reader->data = reader->buf;
+            batch_reader_fill(reader);
+            continue;
+        }
+
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            --len;
+        }
+        if (len == 0 || line[0] == '#') {
+            continue;
+        }
+        block->lines[block->nlines] = line;
+        block->lens[block->nlines] = (int) len;
+        ++block->nlines;
+    }
+
+    return block->nlines;
+}
+
+/* Reserve room for every output line of BLOCK up front, so workers can fill
+ * their slots without synchronization */
+static void
+batch_block_reserve(struct batch_block *block)
+{
+    size_t outlen = 0;
+    for (int i = 0; i < block->nlines; ++i) {
+        block->outoffs[i] = outlen;
+        if (block->out) {
+            outlen += block->out->recsize;
+        } else if (block->in) {
+            outlen += (size_t) block->in->size * block->in->size * block->in->size
+                      * block->in->size + 1;
+        } else {
+            outlen += (block->lens[i] < BATCH_STATUS_SIZE ? BATCH_STATUS_SIZE
+                                                          : block->lens[i]) + 1;
+        }
+    }
+    if (outlen > block->outcap) {
+        while (outlen > block->outcap) {
+            block->outcap *= 2;
+        }
+        free(block->outbuf);
+        block->outbuf = malloc(block->outcap);
+    }
+}
+
+/* Returns block size of the first valid puzzle of text lines of BLOCK, or 3
+ * if there is none */
+static int
+batch_block_size(const struct batch_block *block)
+{
+    struct sudoku *sudoku = sudoku_create(3);
+    int size = 3;
+    for (int i = 0; i < block->nlines; ++i) {
+        if (sudoku_parse_line(sudoku, block->lines[i], block->lens[i])) {
+            size = sudoku->size;
+            break;
+        }
+    }
+    sudoku_free(sudoku);
+    return size;
+}
+
+/* Set up HDR for packed output of sudokus of block size SIZE and write it to
+ * OUT. Returns its offset, or -1 if OUT can't tell. */
+static long
+batch_start_packed(struct packed_header *hdr, int size, FILE *out)
+{
+    unsigned char buf[PACKED_HEADER_SIZE];
+    packed_header_init(hdr, size, PACKED_SOLUTION | PACKED_COUNT);
+    packed_header_put(hdr, buf);
+    const long start = ftell(out);
+    fwrite(buf, 1, sizeof buf, out);
+    return start;
+}
+
+/* Write output lines of BLOCK to OUT in input order. Lines are moved next to
+ * each other first, so the block goes out in a single write. */
+static void
+batch_block_write(struct batch_block *block, FILE *out)
+{
+    size_t len = 0;
+    for (int i = 0; i < block->nlines; ++i) {
+        if (block->outoffs[i] != len) {
+            memmove(&block->outbuf[len], &block->outbuf[block->outoffs[i]],
+                    block->outlens[i]);
+        }
+        len += block->outlens[i];
+    }
+    fwrite(block->outbuf, 1, len, out);
+}
+
+/* Parse line I of the current block into the puzzle of WORKER. Returns zero
+ * if it is no valid puzzle, or one the output can't hold. */
+static int
+batch_worker_parse(struct batch_worker *worker, int i)
+{
+    const struct batch_block *block = worker->block;
+    int valid;
+    if (block->in) {
+        if (worker->puzzle->size != block->in->size) {
+            sudoku_free(worker->puzzle);
+            worker->puzzle = sudoku_create(block->in->size);
+        }
+        valid = packed_decode(block->in, (const unsigned char *) block->lines[i],
+                              worker->puzzle, NULL, NULL);
+    } else {
+        valid = sudoku_parse_line(worker->puzzle, block->lines[i], block->lens[i]);
+    }
+
+    /* Lines hold no more than SUDOKU_LINE_MAX_NELEMS elements */
+    if (block->out) {
+        valid = valid && worker->puzzle->size == block->out->size;
+    } else {
+        valid = valid && worker->puzzle->nelems <= SUDOKU_LINE_MAX_NELEMS;
+    }
+    if (valid && worker->solution->size != worker->puzzle->size) {
+        sudoku_free(worker->solution);
+        worker->solution = sudoku_create(worker->puzzle->size);
+    }
+    return valid;
+}
+
+/* Write output of line I of the current block with WORKER: the solution of its
+ * puzzle if NSOLS is positive, otherwise what PACKED_COUNT_* value resp. zero
+ * says */
+static void
+batch_worker_write(struct batch_worker *worker, int i, long nsols)
+{
+    struct batch_block *block = worker->block;
+    char *out = &block->outbuf[block->outoffs[i]];
+    if (block->out) {
+        packed_encode(block->out, (unsigned char *) out,
+                      (nsols != PACKED_COUNT_INVALID) ? worker->puzzle : NULL,
+                      (nsols > 0) ? worker->solution : NULL, nsols);
+        block->outlens[i] = (int) block->out->recsize;
+    } else if (nsols > 0) {
+        block->outlens[i] = sudoku_sprint_line(out, worker->solution);
+    } else if (nsols == PACKED_COUNT_ABORTED) {
+        block->outlens[i] = sprintf(out, "aborted\n");
+    } else if (nsols == PACKED_COUNT_INVALID) {
+        block->outlens[i] = sprintf(out, "invalid\n");
+    } else {
+        block->outlens[i] = sprintf(out, "unsolvable\n");
+    }
+}
+
+/* Solve puzzles of chunk CHUNK of the current block with worker WORKER */
+static void
+batch_worker_solve_chunk(struct batch_worker *worker, int chunk)
+{
+    struct batch_block *block = worker->block;
+    const int beg = chunk * BATCH_CHUNK_SIZE;
+    const int end = (beg + BATCH_CHUNK_SIZE < block->nlines) ? beg + BATCH_CHUNK_SIZE
+                                                             : block->nlines;
+
+    for (int i = beg; i < end; ++i) {
+        if (!batch_worker_parse(worker, i)) {
+            ++worker->ninvalid;
+            batch_worker_write(worker, i, PACKED_COUNT_INVALID);
+            continue;
+        }
+
+        /* Packed records hold the number of solutions, which the cache does not
+         * know, so it only serves text output */
+        if (worker->cache && !block->out
+            && cache_lookup(worker->cache, worker->canon, worker->puzzle, worker->solution)) {
+            ++worker->nsolved;
+            ++worker->ncached;
+            batch_worker_write(worker, i, 1);
+            continue;
+        }
+
+        /* Packed records tell unique puzzles from others, which takes a
+         * search for a second solution */
+        const int nsols = sudoku_solver_solve_max(worker->solver, worker->puzzle,
+                                                  block->out ? 2 : 1, worker->solution);
+        const struct sudoku_stats *stats = sudoku_solver_stats(worker->solver);
+        worker->nnodes += stats->nnodes;
+        if (dlstats_enabled()) {
+            dlstats_add(&worker->search, &stats->search);
+        } else {
+            worker->search.nodes += stats->search.nodes;
+            worker->search.solutions += stats->search.solutions;
+        }
+        if (nsols > 0) {
+            ++worker->nsolved;
+            worker->npropagated += stats->npropagated;
+            batch_worker_write(worker, i, nsols);
+            if (worker->cache && !block->out) {
+                cache_store(worker->cache, worker->canon, worker->solution);
+            }
+        } else if (stats->aborted != DLABORT_NONE) {
+            ++worker->naborted;
+            batch_worker_write(worker, i, PACKED_COUNT_ABORTED);
+        } else {
+            batch_worker_write(worker, i, 0);
+        }
+    }
+}
+
+/* Take next chunk from own queue of WORKER. Returns -1 if it is empty. */
+static int
+batch_worker_pop(struct batch_worker *worker)
+{
+    int chunk = -1;
+    pthread_mutex_lock(&worker->lock);
+    if (worker->lo < worker->hi) {
+        chunk = worker->lo++;
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return chunk;
+}
+
+/* Steal back half of the chunks of some other worker for WORKER. Returns
+ * first stolen chunk, or -1 if all other workers ran dry. */
+static int
+batch_worker_steal(struct batch_worker *worker)
+{
+    for (int i = 1; i < worker->nworkers; ++i) {
+        struct batch_worker *victim = &worker->workers[(worker->id + i) % worker->nworkers];
+
+        pthread_mutex_lock(&victim->lock);
+        const int lo = victim->lo + (victim->hi - victim->lo) / 2;
+        const int hi = victim->hi;
+        if (lo < hi) {
+            victim->hi = lo;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (lo < hi) {
+            pthread_mutex_lock(&worker->lock);
+            worker->lo = lo + 1;
+            worker->hi = hi;
+            pthread_mutex_unlock(&worker->lock);
+            return lo;
+        }
+    }
+    return -1;
+}
+
+static void *
+batch_worker_run(void *arg)
+{
+    struct batch_worker *worker = arg;
+
+    for (;;) {
+        int chunk = batch_worker_pop(worker);
+        if (chunk < 0) {
+            chunk = batch_worker_steal(worker);
+        }
+        if (chunk < 0) {
+            break;
+        }
+        batch_worker_solve_chunk(worker, chunk);
+    }
+
+    return NULL;
+}
+
+void
+batch_solve(FILE *in, FILE *out, const struct sudoku_options *opts, int nthreads,
+            struct cache *cache, int packed, struct batch_stats *stats)
+{
+    const double start = batch_time();
+
+    if (nthreads < 1) {
+        nthreads = 1;
+    }
+
+    /* Puzzles are spread over the threads, so each one is searched serially */
+    struct sudoku_options wopts = {
+        SUDOKU_ENGINE_AUTO, SUDOKU_PROPAGATE_SINGLES,
+        { DLSELECT_MRV, 0, 1, { 0, 0, NULL } }
+    };
+    if (opts) {
+        wopts = *opts;
+        wopts.search.nthreads = 1;
+    }
+
+    /* Every worker owns its solver and grids, which are reused for all
+     * puzzles it solves */
+    struct batch_worker *workers = malloc(nthreads * sizeof *workers);
+    for (int i = 0; i < nthreads; ++i) {
+        struct batch_worker *worker = &workers[i];
+        pthread_mutex_init(&worker->lock, NULL);
+        worker->lo = 0;
+        worker->hi = 0;
+        worker->id = i;
+        worker->nworkers = nthreads;
+        worker->workers = workers;
+        worker->solver = sudoku_solver_create(&wopts);
+        worker->cache = cache;
+        worker->canon = cache ? canon_create() : NULL;
+        worker->puzzle = sudoku_create(3);
+        worker->solution = sudoku_create(3);
+        worker->nsolved = 0;
+        worker->ninvalid = 0;
+        worker->naborted = 0;
+        worker->ncached = 0;
+        worker->npropagated = 0;
+        worker->nnodes = 0;
+        memset(&worker->search, 0, sizeof worker->search);
+    }
+
+    struct batch_block *block = batch_block_create();
+    struct batch_reader reader;
+    batch_reader_open(&reader, in);
+    block->in = reader.packed ? &reader.hdr : NULL;
+
+    struct packed_header outhdr;
+    long outstart = -1;
+    stats->npuzzles = 0;
+    while (batch_block_read(block, &reader) > 0) {
+        if (packed && !block->out) {
+            /* Records of packed output have the size of the input */
+            outstart = batch_start_packed(&outhdr, reader.packed ? reader.hdr.size
+                                                                 : batch_block_size(block), out);
+            block->out = &outhdr;
+        }
+        stats->npuzzles += block->nlines;
+        batch_block_reserve(block);
+
+        /* Hand out contiguous ranges of chunks; stealing evens out the load
+         * if some puzzles are much harder than others */
+        const int nchunks = (block->nlines + BATCH_CHUNK_SIZE - 1) / BATCH_CHUNK_SIZE;
+        for (int i = 0; i < nthreads; ++i) {
+            workers[i].block = block;
+            workers[i].lo = (int) ((long) nchunks * i / nthreads);
+            workers[i].hi = (int) ((long) nchunks * (i + 1) / nthreads);
+        }
+
+        /* The calling thread works as worker 0 */
+        for (int i = 1; i < nthreads; ++i) {
+            pthread_create(&workers[i].thread, NULL, &batch_worker_run, &workers[i]);
+        }
+        batch_worker_run(&workers[0]);
+        for (int i = 1; i < nthreads; ++i) {
+            pthread_join(workers[i].thread, NULL);
+        }
+
+        batch_block_write(block, out);
+    }
+    if (packed && !block->out) {
+        outstart = batch_start_packed(&outhdr, reader.packed ? reader.hdr.size : 3, out);
+    }
+    if (packed && outstart >= 0) {
+        packed_write_count(out, outstart, (uint64_t) stats->npuzzles);
+    }
+
+    stats->nsolved = 0;
+    stats->ninvalid = 0;
+    stats->naborted = 0;
+    stats->ncached = 0;
+    stats->npropagated = 0;
+    stats->nnodes = 0;
+    memset(&stats->search, 0, sizeof stats->search);
+    for (int i = 0; i < nthreads; ++i) {
+        struct batch_worker *worker = &workers[i];
+        stats->nsolved += worker->nsolved;
+        stats->ninvalid += worker->ninvalid;
+        stats->naborted += worker->naborted;
+        stats->ncached += worker->ncached;
+        stats->npropagated += worker->npropagated;
+        stats->nnodes += worker->nnodes;
+        dlstats_add(&stats->search, &worker->search);
+        sudoku_solver_free(worker->solver);
+        canon_free(worker->canon);
+        sudoku_free(worker->puzzle);
+        sudoku_free(worker->solution);
+        pthread_mutex_destroy(&worker->lock);
+    }
+
+    batch_reader_close(&reader);
+    batch_block_free(block);
+    free(workers);
+
+    stats->seconds = batch_time() - start;
+}
@@ -0,0 +1,47 @@
+/* batch.h
+ *
+ * Header for solving streams of sudokus in one-line format.
+ *
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+
+#include "cache.h"
+#include "sudoku.h"
+
+/* Aggregate results of a batch run */
+struct batch_stats {
+    long npuzzles;      /* Number of puzzles read */
+    long nsolved;       /* Number of puzzles with a solution */
+    long ninvalid;      /* Number of lines that were no valid puzzle */
+    long naborted;      /* Number of puzzles whose search ran into the
+                         * bounds of the options */
+    long ncached;       /* Number of solved puzzles answered by the cache */
+    long npropagated;   /* Number of cells of solved puzzles filled by
+                         * propagation */
+    long nnodes;        /* Number of search nodes of all puzzles */
+    struct dlstats search;  /* Counters of all dancing links searches */
+    double seconds;     /* Wall clock time of the run */
+};
+
+/* Solve newline-delimited puzzles in one-line format from IN with search
+ * options OPTS (NULL for defaults) on NTHREADS threads and write one line per
+ * puzzle to OUT in input order: the solution, or "unsolvable", "aborted" (the
+ * search ran into the bounds of OPTS, which apply to each puzzle) resp.
+ * "invalid". Empty lines and lines starting with '#' are skipped. IN may also
+ * be a packed file (see `packed.h'), whose records are read in place of lines,
+ * and sudokus larger than 35x35 then count as invalid. With PACKED set the
+ * output is a packed file instead, with solution and number of solutions in
+ * each record, counted up to 2 (see PACKED_COUNT of `enum packed_flags'). Its
+ * sudokus have the size of those of IN resp. of the first valid line, and
+ * other sizes count as invalid. Without PACKED, puzzles are looked up in CACHE
+ * first and the solutions found are stored there, unless it is NULL. Results
+ * are written to STATS. */
+void
+batch_solve(FILE *in, FILE *out, const struct sudoku_options *opts, int nthreads,
+            struct cache *cache, int packed, struct batch_stats *stats);
+
+#endif /* BATCH_H */
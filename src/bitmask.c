@@ -0,0 +1,58 @@
+#include "bitmask.h"
+
+#include <inttypes.h>
+
+#include "bits.h"
+
+/* The engine is instantiated once per block size, so that all loop bounds
+ * and masks are compile-time constants */
+#define BITMASK_BLOCK 2
+#include "bitmask_impl.h"
+#undef BITMASK_BLOCK
+
+#define BITMASK_BLOCK 3
+#include "bitmask_impl.h"
+#undef BITMASK_BLOCK
+
+#define BITMASK_BLOCK 4
+#include "bitmask_impl.h"
+#undef BITMASK_BLOCK
+
+int
+bitmask_supports(int size)
+{
+    return size >= 2 && size <= 4;
+}
+
+long
+bitmask_solve(const struct sudoku *sudoku, long limit, const struct dlbounds *bounds,
+              bitmask_visitor visit, void *ctx, long *nnodes, enum dlabort *aborted)
+{
+    static const struct dlbounds unbounded = { 0, 0, NULL };
+    long nodes = 0;
+    long nsols = 0;
+    enum dlabort reason = DLABORT_NONE;
+    if (!bounds) {
+        bounds = &unbounded;
+    }
+    switch (sudoku->size) {
+    case 2:
+        nsols = bitmask_solve_2(sudoku, limit, bounds, visit, ctx, &nodes, &reason);
+        break;
+    case 3:
+        nsols = bitmask_solve_3(sudoku, limit, bounds, visit, ctx, &nodes, &reason);
+        break;
+    case 4:
+        nsols = bitmask_solve_4(sudoku, limit, bounds, visit, ctx, &nodes, &reason);
+        break;
+    default:
+        break;
+    }
+    if (nnodes) {
+        *nnodes = nodes;
+    }
+    if (aborted) {
+        *aborted = reason;
+    }
+    return nsols;
+}
@@ -0,0 +1,31 @@
+/* bitmask.h
+ *
+ * Header for bitmask solver specialized for sudokus with small blocks.
+ *
+ */
+
+#ifndef BITMASK_H
+#define BITMASK_H
+
+#include "sudoku.h"
+
+/* Called for every solution found with its NELEMS * NELEMS cells in GRID,
+ * which is only valid during the call. Returning non-zero stops the search. */
+typedef int (*bitmask_visitor)(const uint8_t *grid, void *ctx);
+
+/* Returns whether the bitmask solver handles sudokus with blocks of SIZE x SIZE
+ * cells (2, 3 and 4) */
+int
+bitmask_supports(int size);
+
+/* Solve SUDOKU with bitmask solver and call VISIT (if not NULL) with context
+ * CTX for each solution, stopping after LIMIT solutions or once the search
+ * runs into BOUNDS (NULL for none). Returns number of solutions found. Without
+ * a visitor the solutions are only counted. The number of search nodes is
+ * written to NNODES and the reason the search was aborted for to ABORTED,
+ * unless they are NULL. */
+long
+bitmask_solve(const struct sudoku *sudoku, long limit, const struct dlbounds *bounds,
+              bitmask_visitor visit, void *ctx, long *nnodes, enum dlabort *aborted);
+
+#endif /* BITMASK_H */
@@ -0,0 +1,246 @@
+/* bitmask_impl.h
+ *
+ * Template of the bitmask solver. Included by bitmask.c once per block size
+ * with BITMASK_BLOCK defined; has no include guard on purpose.
+ *
+ * Every cell has a candidate mask derived from the digits already used in its
+ * row, column and block. The search branches on the empty cell with the fewest
+ * candidates, unless some digit has only one place left in a unit.
+ *
+ */
+
+#define BM_PASTE(a, b) a ## b
+#define BM_NAME(a, b) BM_PASTE(a, b)
+#define BM_STATE BM_NAME(bitmask_state_, BITMASK_BLOCK)
+#define BM_SEARCH BM_NAME(bitmask_search_, BITMASK_BLOCK)
+#define BM_SOLVE BM_NAME(bitmask_solve_, BITMASK_BLOCK)
+
+#define BM_NELEMS (BITMASK_BLOCK * BITMASK_BLOCK)
+#define BM_NCELLS (BM_NELEMS * BM_NELEMS)
+#define BM_ALL ((1u << BM_NELEMS) - 1)
+#define BM_ROW(cell) ((cell) / BM_NELEMS)
+#define BM_COL(cell) ((cell) % BM_NELEMS)
+#define BM_BLOCK(cell) \
+    ((BM_ROW(cell) / BITMASK_BLOCK) * BITMASK_BLOCK + BM_COL(cell) / BITMASK_BLOCK)
+
+struct BM_STATE {
+    uint16_t rows[BM_NELEMS];       /* Digits used per row */
+    uint16_t cols[BM_NELEMS];       /* Digits used per column */
+    uint16_t blocks[BM_NELEMS];     /* Digits used per block */
+    uint16_t cand[BM_NCELLS];       /* Candidates of empty cells at this node */
+    int units[3 * BM_NELEMS][BM_NELEMS];    /* Cells of rows, cols, blocks */
+    uint8_t grid[BM_NCELLS];
+    int free[BM_NCELLS];            /* Empty cells, first NFREE are unfilled */
+    long nodes;
+    long nsols;
+    long limit;
+    const struct dlbounds *bounds;
+    double deadline;
+    long checkpoint;                /* Node count of next check of BOUNDS */
+    enum dlabort aborted;
+    int stop;
+    bitmask_visitor visit;
+    void *ctx;
+};
+
+/* Look for digit with a single place among the cells CELLS of a unit using
+ * digits USED, given candidates in ST. Returns -1 if some digit has no place
+ * left, 1 if such a hidden single was stored in CELL and DIGIT, 0 else. */
+static int
+BM_NAME(bitmask_unit_, BITMASK_BLOCK)(const struct BM_STATE *st, const int *cells,
+                                      unsigned used, int *cell, unsigned *digit)
+{
+    unsigned once = 0;
+    unsigned twice = 0;
+    for (int i = 0; i < BM_NELEMS; ++i) {
+        const unsigned mask = st->cand[cells[i]];
+        twice |= once & mask;
+        once |= mask;
+    }
+    if ((once | used) != BM_ALL) {
+        return -1;
+    }
+
+    const unsigned single = once & ~twice;
+    if (!single) {
+        return 0;
+    }
+    *digit = single & -single;
+    for (int i = 0; i < BM_NELEMS; ++i) {
+        if (st->cand[cells[i]] & *digit) {
+            *cell = cells[i];
+            break;
+        }
+    }
+    return 1;
+}
+
+/* Fill the NFREE empty cells of ST. Returns non-zero if the search should
+ * stop. */
+static int
+BM_SEARCH(struct BM_STATE *st, int nfree)
+{
+    ++st->nodes;
+    if (st->nodes >= st->checkpoint) {
+        st->aborted = dlbounds_check(st->bounds, st->deadline, st->nodes,
+                                     &st->checkpoint);
+        if (st->aborted != DLABORT_NONE) {
+            st->stop = 1;
+            return 1;
+        }
+    }
+    if (nfree == 0) {
+        ++st->nsols;
+        if (st->visit && st->visit(st->grid, st->ctx)) {
+            st->stop = 1;
+        }
+        if (st->nsols >= st->limit) {
+            st->stop = 1;
+        }
+        return st->stop;
+    }
+
+    /* Most constrained cell; a single candidate cannot be beaten */
+    int ibest = 0;
+    int nbest = BM_NELEMS + 1;
+    unsigned best = 0;
+    for (int i = 0; i < nfree; ++i) {
+        const int cell = st->free[i];
+        const unsigned mask = BM_ALL & ~(unsigned) (st->rows[BM_ROW(cell)]
+                                                   | st->cols[BM_COL(cell)]
+                                                   | st->blocks[BM_BLOCK(cell)]);
+        if (!mask) {
+            return 0;
+        }
+        st->cand[cell] = (uint16_t) mask;
+        const int n = bits_popcount(mask);
+        if (n < nbest) {
+            ibest = i;
+            nbest = n;
+            best = mask;
+        }
+    }
+
+    /* Otherwise a digit with a single place in some unit is forced as well,
+     * and a digit with no place at all is a dead end */
+    if (nbest > 1) {
+        int cell = -1;
+        unsigned digit = 0;
+        int res = 0;
+        for (int unit = 0; unit < 3 * BM_NELEMS && res == 0; ++unit) {
+            const int k = unit % BM_NELEMS;
+            const unsigned used = (unit < BM_NELEMS) ? st->rows[k]
+                                : (unit < 2 * BM_NELEMS) ? st->cols[k] : st->blocks[k];
+            res = BM_NAME(bitmask_unit_, BITMASK_BLOCK)(st, st->units[unit], used,
+                                                        &cell, &digit);
+        }
+        if (res < 0) {
+            return 0;
+        }
+        if (res > 0) {
+            for (ibest = 0; st->free[ibest] != cell; ++ibest);
+            best = digit;
+        }
+    }
+
+    const int cell = st->free[ibest];
+    st->free[ibest] = st->free[nfree - 1];
+    st->free[nfree - 1] = cell;
+
+    const int row = BM_ROW(cell);
+    const int col = BM_COL(cell);
+    const int block = BM_BLOCK(cell);
+    st->cand[cell] = 0;
+    for (unsigned mask = best; mask; mask &= mask - 1) {
+        const uint16_t bit = (uint16_t) (mask & -mask);
+        st->rows[row] |= bit;
+        st->cols[col] |= bit;
+        st->blocks[block] |= bit;
+        st->grid[cell] = (uint8_t) (bits_ctz(bit) + 1);
+
+        const int stop = BM_SEARCH(st, nfree - 1);
+
+        st->rows[row] &= (uint16_t) ~bit;
+        st->cols[col] &= (uint16_t) ~bit;
+        st->blocks[block] &= (uint16_t) ~bit;
+        if (stop) {
+            break;
+        }
+    }
+    st->grid[cell] = 0;
+
+    return st->stop;
+}
+
+static long
+BM_SOLVE(const struct sudoku *sudoku, long limit, const struct dlbounds *bounds,
+         bitmask_visitor visit, void *ctx, long *nnodes, enum dlabort *aborted)
+{
+    struct BM_STATE st;
+    int nfree = 0;
+
+    for (int i = 0; i < BM_NELEMS; ++i) {
+        st.rows[i] = 0;
+        st.cols[i] = 0;
+        st.blocks[i] = 0;
+    }
+    for (int k = 0; k < BM_NELEMS; ++k) {
+        for (int i = 0; i < BM_NELEMS; ++i) {
+            st.units[k][i] = k * BM_NELEMS + i;
+            st.units[BM_NELEMS + k][i] = i * BM_NELEMS + k;
+            st.units[2 * BM_NELEMS + k][i] =
+                ((k / BITMASK_BLOCK) * BITMASK_BLOCK + i / BITMASK_BLOCK) * BM_NELEMS
+                + (k % BITMASK_BLOCK) * BITMASK_BLOCK + i % BITMASK_BLOCK;
+        }
+    }
+    st.nodes = 0;
+    st.nsols = 0;
+    st.limit = limit;
+    st.bounds = bounds;
+    st.deadline = dlbounds_deadline(bounds);
+    st.checkpoint = 0;
+    st.aborted = DLABORT_NONE;
+    st.stop = 0;
+    st.visit = visit;
+    st.ctx = ctx;
+
+    for (int cell = 0; cell < BM_NCELLS; ++cell) {
+        const int elem = sudoku->data[cell];
+        st.grid[cell] = elem;
+        st.cand[cell] = 0;
+        if (elem == 0) {
+            st.free[nfree++] = cell;
+            continue;
+        }
+
+        /* Givens contradicting each other leave no solution */
+        const uint16_t bit = (uint16_t) (1u << (elem - 1));
+        if ((st.rows[BM_ROW(cell)] | st.cols[BM_COL(cell)]
+             | st.blocks[BM_BLOCK(cell)]) & bit) {
+            return 0;
+        }
+        st.rows[BM_ROW(cell)] |= bit;
+        st.cols[BM_COL(cell)] |= bit;
+        st.blocks[BM_BLOCK(cell)] |= bit;
+    }
+
+    if (limit > 0) {
+        BM_SEARCH(&st, nfree);
+    }
+
+    *nnodes = st.nodes;
+    *aborted = st.aborted;
+    return st.nsols;
+}
+
+#undef BM_PASTE
+#undef BM_NAME
+#undef BM_STATE
+#undef BM_SEARCH
+#undef BM_SOLVE
+#undef BM_NELEMS
+#undef BM_NCELLS
+#undef BM_ALL
+#undef BM_ROW
+#undef BM_COL
+#undef BM_BLOCK
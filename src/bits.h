@@ -0,0 +1,43 @@
+/* bits.h
+ *
+ * Header for bit counting helpers used by the bitmask based code.
+ *
+ */
+
+#ifndef BITS_H
+#define BITS_H
+
+#include <inttypes.h>
+
+/* Returns number of set bits in X. On x86 without the popcnt instruction the
+ * builtin is a library call, which the bit twiddling beats. */
+static inline int
+bits_popcount(uint64_t x)
+{
+#if (defined(__GNUC__) || defined(__clang__)) \
+    && (defined(__POPCNT__) || !(defined(__x86_64__) || defined(__i386__)))
+    return __builtin_popcountll(x);
+#else
+    x -= (x >> 1) & UINT64_C(0x5555555555555555);
+    x = (x & UINT64_C(0x3333333333333333)) + ((x >> 2) & UINT64_C(0x3333333333333333));
+    x = (x + (x >> 4)) & UINT64_C(0x0f0f0f0f0f0f0f0f);
+    return (int) ((x * UINT64_C(0x0101010101010101)) >> 56);
+#endif
+}
+
+/* Returns index of lowest set bit in X, which must not be zero */
+static inline int
+bits_ctz(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#else
+    int n = 0;
+    for (; !(x & 1); x >>= 1) {
+        ++n;
+    }
+    return n;
+#endif
+}
+
+#endif /* BITS_H */
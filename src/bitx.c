@@ -0,0 +1,658 @@
+#include "bitx.h"
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bits.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* Statistics beyond nodes and solutions, as set for links.c */
+#ifndef LINKS_STATS
+#define LINKS_STATS 0
+#endif
+
+#if LINKS_STATS
+#define BX_STAT(stmt) do { stmt; } while (0)
+#else
+#define BX_STAT(stmt) ((void) 0)
+#endif
+
+#define BX_STAT_DEPTH(d) (((d) < DLSTATS_DEPTHS) ? (d) : DLSTATS_DEPTHS - 1)
+
+/* Added to the size of covered columns, so the column with the fewest rows is
+ * the first minimum of the sizes of all columns. No matrix that fits in
+ * memory has a column of that many rows. */
+#define BX_COVERED (INT32_C(1) << 30)
+
+/* Whether bit I of bitset SET is set */
+#define BX_TEST(set, i) (((set)[(i) >> 6] >> ((i) & 63)) & 1)
+
+/* Row chosen at one depth of the search */
+struct bitx_level {
+    int col;    /* Column branched on */
+    int pos;    /* Next entry of the column's rows to try */
+    int line;   /* Line of the row chosen */
+};
+
+struct bitx_solver {
+    /* Matrix */
+    const struct smatrix *smat; /* Matrix searched, valid during a search */
+    int nwords;                 /* Words per bitset of rows */
+    int ncolwords;              /* Words of COLACTIVE */
+    int maxcols;                /* Capacity of the arrays per column, and of
+                                 * STACK and ROWBUF */
+    int maxelems;               /* Capacity of COLROWS */
+    size_t maxmask;             /* Capacity of MASKS in words */
+    int *colstart;              /* Rows of column C are COLROWS[COLSTART[C]]
+                                 * up to COLSTART[C + 1], in line order */
+    int *colrows;
+    int *masklo;                /* First word of the rows of each column */
+    size_t *maskoff;            /* Mask of column C is MASKS[MASKOFF[C]] up to
+                                 * MASKOFF[C + 1], starting at word MASKLO[C] */
+    uint64_t *masks;
+    int32_t *size;              /* Active rows per column, plus BX_COVERED
+                                 * while covered */
+    uint64_t *colactive;        /* Columns not covered yet */
+    size_t maxlevels;           /* Capacity of LEVELS in words */
+    uint64_t *levels;           /* Active rows per depth, NWORDS each */
+    struct bitx_level *stack;
+    int *rowbuf;                /* Row ids of solution handed to VISIT */
+
+    /* Search */
+    long limit;                 /* Stop after this many solutions */
+    int store;                  /* Whether solutions are kept */
+    dlvisitor visit;            /* Called for every solution unless NULL */
+    void *ctx;                  /* Context of VISIT */
+    struct dlbounds bounds;
+    double deadline;            /* Deadline of the search, 0 for none */
+    long checkpoint;            /* Node count of the next check of BOUNDS */
+    enum dlabort aborted;
+    struct dlstats stats;
+    long count;                 /* Number of solutions found */
+    int nsols;                  /* Number of solutions kept in SOLS */
+    int maxsols;                /* Capacity of SOLS */
+    struct dlsolution *sols;    /* ROWS hold offsets into BUF until the end */
+    int bufsize;
+    int bufcap;
+    int *buf;                   /* Row ids of all solutions back to back */
+    enum dlselect select;
+    uint64_t seed;
+    uint64_t rng;
+};
+
+struct bitx_solver *
+bitx_solver_create(const struct dloptions *opts)
+{
+    struct bitx_solver *bxs = calloc(1, sizeof *bxs);
+    if (opts) {
+        bxs->bounds = opts->bounds;
+    }
+    bxs->limit = LONG_MAX;
+    bxs->store = 1;
+    bxs->aborted = DLABORT_NONE;
+    bxs->select = opts ? opts->select : DLSELECT_MRV;
+    /* Same seed and generator as the dancing links solver */
+    bxs->seed = (opts && opts->seed) ? opts->seed : UINT64_C(88172645463325252);
+    bxs->rng = bxs->seed;
+    return bxs;
+}
+
+void
+bitx_solver_free(struct bitx_solver *bxs)
+{
+    if (!bxs) {
+        return;
+    }
+    free(bxs->colstart);
+    free(bxs->colrows);
+    free(bxs->masklo);
+    free(bxs->maskoff);
+    free(bxs->masks);
+    free(bxs->size);
+    free(bxs->colactive);
+    free(bxs->levels);
+    free(bxs->stack);
+    free(bxs->rowbuf);
+    free(bxs->sols);
+    free(bxs->buf);
+    free(bxs);
+}
+
+/* Clear the bits of MASK from the NWORDS words of DST */
+static void
+bitx_andnot(uint64_t *dst, const uint64_t *mask, int nwords)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= nwords; i += 4) {
+        const __m256i d = _mm256_loadu_si256((const __m256i *) &dst[i]);
+        const __m256i m = _mm256_loadu_si256((const __m256i *) &mask[i]);
+        _mm256_storeu_si256((__m256i *) &dst[i], _mm256_andnot_si256(m, d));
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 2 <= nwords; i += 2) {
+        const __m128i d = _mm_loadu_si128((const __m128i *) &dst[i]);
+        const __m128i m = _mm_loadu_si128((const __m128i *) &mask[i]);
+        _mm_storeu_si128((__m128i *) &dst[i], _mm_andnot_si128(m, d));
+    }
+#endif
+    for (; i < nwords; ++i) {
+        dst[i] &= ~mask[i];
+    }
+}
+
+const char *
+bitx_simd(void)
+{
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#else
+    return "portable";
+#endif
+}
+
+/* Make room in BXS for the bitsets of NLEVELS depths */
+static void
+bitx_reserve_levels(struct bitx_solver *bxs, int nlevels)
+{
+    const size_t need = (size_t) nlevels * bxs->nwords;
+    if (need > bxs->maxlevels) {
+        /* Searches rarely go as deep as the number of columns allows, so the
+         * bitsets grow with the depth reached */
+        bxs->maxlevels = need > 2 * bxs->maxlevels ? need : 2 * bxs->maxlevels;
+        bxs->levels = realloc(bxs->levels, bxs->maxlevels * sizeof *bxs->levels);
+    }
+}
+
+/* Load sparse binary matrix SMAT into BXS: list the rows of each column, build
+ * their masks and activate all rows and columns. Returns zero if SMAT has an
+ * empty column (and thus no solution). */
+static int
+bitx_load(struct bitx_solver *bxs, const struct smatrix *smat)
+{
+    const int nlines = smat->nlines;
+    const int ncols = smat->ncols;
+    /* A spare word keeps the bitsets of matrices without rows allocated */
+    const int nwords = nlines / 64 + 1;
+    bxs->smat = smat;
+    bxs->nwords = nwords;
+    bxs->ncolwords = (ncols + 63) / 64;
+
+    if (ncols + 1 > bxs->maxcols) {
+        bxs->maxcols = ncols + 1;
+        free(bxs->colstart);
+        free(bxs->masklo);
+        free(bxs->maskoff);
+        free(bxs->size);
+        free(bxs->colactive);
+        free(bxs->stack);
+        free(bxs->rowbuf);
+        bxs->colstart = malloc(bxs->maxcols * sizeof *bxs->colstart);
+        bxs->masklo = malloc(bxs->maxcols * sizeof *bxs->masklo);
+        bxs->maskoff = malloc(bxs->maxcols * sizeof *bxs->maskoff);
+        bxs->size = malloc(bxs->maxcols * sizeof *bxs->size);
+        bxs->colactive = malloc((bxs->maxcols + 63) / 64 * sizeof *bxs->colactive);
+        /* Every level covers at least one column, so the depth is bounded */
+        bxs->stack = malloc(bxs->maxcols * sizeof *bxs->stack);
+        bxs->rowbuf = malloc(bxs->maxcols * sizeof *bxs->rowbuf);
+    }
+    if (smat->nelems > bxs->maxelems) {
+        bxs->maxelems = smat->nelems;
+        free(bxs->colrows);
+        bxs->colrows = malloc(bxs->maxelems * sizeof *bxs->colrows);
+    }
+
+    /* Rows of each column, listed in line order by a counting sort */
+    int *colstart = bxs->colstart;
+    memset(colstart, 0, (ncols + 1) * sizeof *colstart);
+    for (int idx = 0; idx < smat->nelems; ++idx) {
+        ++colstart[smat->cols[idx] + 1];
+    }
+    for (int c = 0; c < ncols; ++c) {
+        colstart[c + 1] += colstart[c];
+    }
+    for (int line = 0; line < nlines; ++line) {
+        for (int idx = smat->offsets[line]; idx < smat->offsets[line + 1]; ++idx) {
+            bxs->colrows[colstart[smat->cols[idx]]++] = line;
+        }
+    }
+    for (int c = ncols; c > 0; --c) {
+        colstart[c] = colstart[c - 1];
+    }
+    colstart[0] = 0;
+
+    /* Masks only span the words from the first to the last row of their
+     * column, which keeps them short for the cell columns of sudokus */
+    size_t nmask = 0;
+    for (int c = 0; c < ncols; ++c) {
+        const int beg = colstart[c];
+        const int end = colstart[c + 1];
+        bxs->masklo[c] = (end > beg) ? bxs->colrows[beg] / 64 : 0;
+        bxs->maskoff[c] = nmask;
+        if (end > beg) {
+            nmask += (size_t) (bxs->colrows[end - 1] / 64 - bxs->masklo[c] + 1);
+        }
+    }
+    bxs->maskoff[ncols] = nmask;
+    if (nmask + 1 > bxs->maxmask) {
+        bxs->maxmask = nmask + 1;
+        free(bxs->masks);
+        bxs->masks = malloc(bxs->maxmask * sizeof *bxs->masks);
+    }
+    memset(bxs->masks, 0, nmask * sizeof *bxs->masks);
+
+    int empty = 0;
+    for (int c = 0; c < ncols; ++c) {
+        uint64_t *mask = &bxs->masks[bxs->maskoff[c]];
+        const int lo = bxs->masklo[c];
+        for (int i = colstart[c]; i < colstart[c + 1]; ++i) {
+            const int line = bxs->colrows[i];
+            mask[line / 64 - lo] |= UINT64_C(1) << (line & 63);
+        }
+        bxs->size[c] = 0;
+        for (size_t w = bxs->maskoff[c]; w < bxs->maskoff[c + 1]; ++w) {
+            bxs->size[c] += bits_popcount(bxs->masks[w]);
+        }
+        empty |= bxs->size[c] == 0;
+    }
+
+    /* All rows and columns start out active */
+    memset(bxs->colactive, 0, bxs->ncolwords * sizeof *bxs->colactive);
+    for (int c = 0; c < ncols; ++c) {
+        bxs->colactive[c / 64] |= UINT64_C(1) << (c & 63);
+    }
+    bitx_reserve_levels(bxs, 1);
+    memset(bxs->levels, 0, nwords * sizeof *bxs->levels);
+    for (int line = 0; line < nlines; ++line) {
+        bxs->levels[line / 64] |= UINT64_C(1) << (line & 63);
+    }
+
+    /* Cols must not be empty */
+    return !empty;
+}
+
+/* Add DELTA to the sizes of the columns of the rows of BXS active in bitset
+ * ACTIVE but not in NEXT */
+static void
+bitx_update_sizes(struct bitx_solver *bxs, const uint64_t *active, const uint64_t *next,
+                  int delta)
+{
+    const struct smatrix *smat = bxs->smat;
+    for (int w = 0; w < bxs->nwords; ++w) {
+        for (uint64_t bits = active[w] & ~next[w]; bits; bits &= bits - 1) {
+            const int line = w * 64 + bits_ctz(bits);
+            for (int idx = smat->offsets[line]; idx < smat->offsets[line + 1]; ++idx) {
+                bxs->size[smat->cols[idx]] += delta;
+            }
+            BX_STAT(bxs->stats.updates += smat->offsets[line + 1] - smat->offsets[line]);
+        }
+    }
+}
+
+/* Choose row LINE at depth DEPTH of BXS: clear the rows of its columns from
+ * the active rows of the next depth and cover the columns */
+static void
+bitx_cover(struct bitx_solver *bxs, int depth, int line)
+{
+    const struct smatrix *smat = bxs->smat;
+    const int nwords = bxs->nwords;
+    bitx_reserve_levels(bxs, depth + 2);
+    const uint64_t *active = &bxs->levels[(size_t) depth * nwords];
+    uint64_t *next = &bxs->levels[(size_t) (depth + 1) * nwords];
+
+    memcpy(next, active, nwords * sizeof *next);
+    for (int idx = smat->offsets[line]; idx < smat->offsets[line + 1]; ++idx) {
+        const int c = smat->cols[idx];
+        bitx_andnot(&next[bxs->masklo[c]], &bxs->masks[bxs->maskoff[c]],
+                    (int) (bxs->maskoff[c + 1] - bxs->maskoff[c]));
+        bxs->colactive[c / 64] &= ~(UINT64_C(1) << (c & 63));
+        bxs->size[c] += BX_COVERED;
+    }
+    bitx_update_sizes(bxs, active, next, -1);
+    bxs->stack[depth].line = line;
+}
+
+/* Undo `bitx_cover' for the row chosen at depth DEPTH of BXS */
+static void
+bitx_uncover(struct bitx_solver *bxs, int depth)
+{
+    const struct smatrix *smat = bxs->smat;
+    const int nwords = bxs->nwords;
+    const int line = bxs->stack[depth].line;
+    for (int idx = smat->offsets[line]; idx < smat->offsets[line + 1]; ++idx) {
+        const int c = smat->cols[idx];
+        bxs->colactive[c / 64] |= UINT64_C(1) << (c & 63);
+        bxs->size[c] -= BX_COVERED;
+    }
+    bitx_update_sizes(bxs, &bxs->levels[(size_t) depth * nwords],
+                      &bxs->levels[(size_t) (depth + 1) * nwords], 1);
+}
+
+/* Returns next row to try at depth DEPTH of BXS, or -1 if its column has no
+ * active row left */
+static int
+bitx_next_row(struct bitx_solver *bxs, int depth)
+{
+    struct bitx_level *level = &bxs->stack[depth];
+    const uint64_t *active = &bxs->levels[(size_t) depth * bxs->nwords];
+    const int end = bxs->colstart[level->col + 1];
+    while (level->pos < end) {
+        const int line = bxs->colrows[level->pos++];
+        if (BX_TEST(active, line)) {
+            return line;
+        }
+    }
+    return -1;
+}
+
+/* Advance random state of BXS and return next pseudo-random number, as
+ * `dlresult_random' does */
+static uint64_t
+bitx_random(struct bitx_solver *bxs)
+{
+    uint64_t x = bxs->rng;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    bxs->rng = x;
+    return x;
+}
+
+/* Returns index of the first smallest of the N sizes SIZE, which must not be
+ * empty. The minimum is found with vector compares, then its first copy. */
+static int
+bitx_first_min(const int32_t *size, int n)
+{
+    int i = 0;
+    int32_t min = INT32_MAX;
+#if defined(__AVX2__)
+    if (n >= 8) {
+        __m256i vmin = _mm256_set1_epi32(INT32_MAX);
+        for (; i + 8 <= n; i += 8) {
+            vmin = _mm256_min_epi32(vmin, _mm256_loadu_si256((const __m256i *) &size[i]));
+        }
+        int32_t lanes[8];
+        _mm256_storeu_si256((__m256i *) lanes, vmin);
+        for (int k = 0; k < 8; ++k) {
+            min = (lanes[k] < min) ? lanes[k] : min;
+        }
+    }
+#elif defined(__SSE2__)
+    if (n >= 4) {
+        /* SSE2 has no minimum of 32-bit lanes, so it is a compare and blend */
+        __m128i vmin = _mm_set1_epi32(INT32_MAX);
+        for (; i + 4 <= n; i += 4) {
+            const __m128i v = _mm_loadu_si128((const __m128i *) &size[i]);
+            const __m128i lt = _mm_cmplt_epi32(v, vmin);
+            vmin = _mm_or_si128(_mm_and_si128(lt, v), _mm_andnot_si128(lt, vmin));
+        }
+        int32_t lanes[4];
+        _mm_storeu_si128((__m128i *) lanes, vmin);
+        for (int k = 0; k < 4; ++k) {
+            min = (lanes[k] < min) ? lanes[k] : min;
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        min = (size[i] < min) ? size[i] : min;
+    }
+
+    i = 0;
+    while (size[i] != min) {
+        ++i;
+    }
+    return i;
+}
+
+/* Choose next column to branch on according to the selection policy of BXS,
+ * as `dlresult_select_column' does on the header list, which holds the active
+ * columns in index order. Returns -1 if no column is left. */
+static int
+bitx_select_column(struct bitx_solver *bxs)
+{
+    if (bxs->select == DLSELECT_MRV) {
+        /* The first column of fewest rows, as the scan of the header list
+         * finds it */
+        const int ncols = bxs->smat->ncols;
+        const int best = (ncols > 0) ? bitx_first_min(bxs->size, ncols) : -1;
+        return (best >= 0 && bxs->size[best] < BX_COVERED) ? best : -1;
+    }
+
+    int best = -1;
+    int bsize = 0;
+    int nties = 1;
+    for (int w = 0; w < bxs->ncolwords; ++w) {
+        for (uint64_t bits = bxs->colactive[w]; bits; bits &= bits - 1) {
+            const int col = w * 64 + bits_ctz(bits);
+            if (best < 0) {
+                if (bxs->select == DLSELECT_FIRST) {
+                    return col;
+                }
+                best = col;
+                bsize = bxs->size[col];
+                continue;
+            }
+            if (bsize == 0) {
+                return best;
+            }
+            const int size = bxs->size[col];
+            if (size < bsize) {
+                best = col;
+                bsize = size;
+                nties = 1;
+            } else if (size == bsize) {
+                /* Reservoir sampling picks each tied column with equal chance */
+                ++nties;
+                if (bitx_random(bxs) % nties == 0) {
+                    best = col;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+/* Append room for new solution of NROWS rows to BXS. Returns pointer to the
+ * rows to be filled in. */
+static int *
+bitx_new_solution(struct bitx_solver *bxs, int nrows)
+{
+    /* Buffers grow geometrically, so storing solutions rarely allocates */
+    if (bxs->nsols == bxs->maxsols) {
+        bxs->maxsols = bxs->maxsols ? 2 * bxs->maxsols : 4;
+        bxs->sols = realloc(bxs->sols, bxs->maxsols * sizeof *bxs->sols);
+    }
+    if (bxs->bufsize + nrows > bxs->bufcap) {
+        while (bxs->bufsize + nrows > bxs->bufcap) {
+            bxs->bufcap = bxs->bufcap ? 2 * bxs->bufcap : 4 * nrows + 4;
+        }
+        bxs->buf = realloc(bxs->buf, bxs->bufcap * sizeof *bxs->buf);
+    }
+
+    int *rows = &bxs->buf[bxs->bufsize];
+    bxs->sols[bxs->nsols].nrows = nrows;
+    bxs->sols[bxs->nsols].rows = NULL;
+    bxs->bufsize += nrows;
+    ++bxs->nsols;
+
+    return rows;
+}
+
+/* Count the DEPTH rows chosen by BXS as new solution, store them if solutions
+ * are kept and hand them to the visitor. Returns zero if the search should
+ * stop. */
+static int
+bitx_add_solution(struct bitx_solver *bxs, int depth)
+{
+    const int *ids = bxs->smat->ids;
+
+    ++bxs->count;
+    if (bxs->store) {
+        int *rows = bitx_new_solution(bxs, depth);
+        for (int i = 0; i < depth; ++i) {
+            rows[i] = ids[bxs->stack[i].line];
+        }
+    }
+    int stop = bxs->count >= bxs->limit;
+    if (bxs->visit) {
+        for (int i = 0; i < depth; ++i) {
+            bxs->rowbuf[i] = ids[bxs->stack[i].line];
+        }
+        stop |= bxs->visit(bxs->rowbuf, depth, bxs->ctx) != 0;
+    }
+    return !stop;
+}
+
+/* Algorithm X over the loaded matrix, unrolled into a loop over an explicit
+ * stack like `dlresult_search', which it follows node for node */
+static void
+bitx_search(struct bitx_solver *bxs)
+{
+    int depth = 0;
+    int stop = 0;
+
+    for (;;) {
+        /* Open new level: choose column and its first row */
+        int line = -1;
+        ++bxs->stats.nodes;
+        BX_STAT(++bxs->stats.depth_nodes[BX_STAT_DEPTH(depth)]);
+        BX_STAT(if (depth > bxs->stats.maxdepth) {
+                    bxs->stats.maxdepth = depth;
+                });
+
+        if (bxs->stats.nodes >= bxs->checkpoint) {
+            bxs->aborted = dlbounds_check(&bxs->bounds, bxs->deadline, bxs->stats.nodes,
+                                          &bxs->checkpoint);
+            stop = bxs->aborted != DLABORT_NONE;
+        }
+
+        if (!stop) {
+            const int col = bitx_select_column(bxs);
+            if (col < 0) {
+                stop = !bitx_add_solution(bxs, depth);
+            } else if (bxs->size[col] > 0) {
+                bxs->stack[depth].col = col;
+                bxs->stack[depth].pos = bxs->colstart[col];
+                line = bitx_next_row(bxs, depth);
+            } else {
+                BX_STAT(++bxs->stats.deadends);
+            }
+        }
+
+        /* Backtrack until some level has a row left to try */
+        while (line < 0 || stop) {
+            if (depth == 0) {
+                return;
+            }
+            bitx_uncover(bxs, --depth);
+            line = bitx_next_row(bxs, depth);
+        }
+
+        BX_STAT(++bxs->stats.depth_branches[BX_STAT_DEPTH(depth)]);
+        bitx_cover(bxs, depth++, line);
+    }
+}
+
+/* Search SMAT with BXS for up to LIMIT solutions (0 for no limit), keeping
+ * them if STORE is set and calling VISIT with context CTX for each one unless
+ * it is NULL. Returns number of solutions found. */
+static long
+bitx_solver_run(struct bitx_solver *bxs, const struct smatrix *smat, long limit,
+                int store, dlvisitor visit, void *ctx)
+{
+    bxs->limit = (limit > 0) ? limit : LONG_MAX;
+    bxs->store = store;
+    bxs->visit = visit;
+    bxs->ctx = ctx;
+    bxs->deadline = dlbounds_deadline(&bxs->bounds);
+    bxs->checkpoint = 0;
+    bxs->aborted = DLABORT_NONE;
+    memset(&bxs->stats, 0, sizeof bxs->stats);
+    bxs->count = 0;
+    bxs->nsols = 0;
+    bxs->bufsize = 0;
+    bxs->rng = bxs->seed;
+
+    if (bitx_load(bxs, smat)) {
+        bitx_search(bxs);
+    }
+
+    /* Point rows of solutions into the row buffer, which no longer moves */
+    int offset = 0;
+    for (int i = 0; i < bxs->nsols; ++i) {
+        bxs->sols[i].rows = &bxs->buf[offset];
+        offset += bxs->sols[i].nrows;
+    }
+    bxs->stats.solutions = bxs->count;
+    bxs->smat = NULL;
+
+    return bxs->count;
+}
+
+int
+bitx_solver_solve(struct bitx_solver *bxs, const struct smatrix *smat, int limit)
+{
+    return (int) bitx_solver_run(bxs, smat, limit, 1, NULL, NULL);
+}
+
+long
+bitx_solver_count(struct bitx_solver *bxs, const struct smatrix *smat, long limit)
+{
+    return bitx_solver_run(bxs, smat, limit, 0, NULL, NULL);
+}
+
+long
+bitx_solver_visit(struct bitx_solver *bxs, const struct smatrix *smat, dlvisitor visit,
+                  void *ctx)
+{
+    return bitx_solver_run(bxs, smat, 0, 0, visit, ctx);
+}
+
+const struct dlsolution *
+bitx_solver_solutions(const struct bitx_solver *bxs)
+{
+    return bxs->sols;
+}
+
+const struct dlstats *
+bitx_solver_stats(const struct bitx_solver *bxs)
+{
+    return &bxs->stats;
+}
+
+enum dlabort
+bitx_solver_aborted(const struct bitx_solver *bxs)
+{
+    return bxs->aborted;
+}
+
+struct dlsolution *
+bitx_solution_find(const struct smatrix *smat, const struct dloptions *opts,
+                   int max_solutions, int *nsols)
+{
+    struct bitx_solver *bxs = bitx_solver_create(opts);
+    *nsols = bitx_solver_solve(bxs, smat, max_solutions);
+
+    /* All solutions share the single row buffer, which is owned by the first
+     * one (see `dlsolution_free') */
+    struct dlsolution *sols = NULL;
+    if (*nsols > 0) {
+        sols = bxs->sols;
+        bxs->sols = NULL;
+        bxs->buf = NULL;
+    }
+
+    bitx_solver_free(bxs);
+
+    return sols;
+}
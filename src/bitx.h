@@ -0,0 +1,81 @@
+/* bitx.h
+ *
+ * Header for exact cover solver over bitsets of rows.
+ *
+ */
+
+#ifndef BITX_H
+#define BITX_H
+
+#include "links.h"
+#include "smatrix.h"
+
+/* Algorithm X on bitsets instead of dancing links. The rows still active at
+ * each depth are a bit vector over the lines of the matrix, and every column
+ * has a mask of its rows. Choosing a row clears the masks of its columns from
+ * the active rows with vector AND-NOT (AVX2 or SSE2 if the compiler targets
+ * them, 64-bit words otherwise), and backtracking goes back to the vector of
+ * the depth above, so nothing has to be relinked. Column sizes are counted by
+ * popcount when a matrix is loaded and then follow the rows each choice
+ * clears; they sit in one array, so the column with the fewest rows is found
+ * with vector compares. Columns are chosen as by the dancing links solver with
+ * the same options, rows are tried in the same order and random ties draw the
+ * same numbers, so both find the same solutions in the same order, with the
+ * same number of nodes, as the dancing links solver does on one thread.
+ * Searches run on one thread; NTHREADS of the options is ignored. The masks of a matrix of L lines and C columns take up to L * C / 8
+ * bytes, which suits the dense candidate sets of larger sudokus. */
+struct bitx_solver;
+
+/* Create reusable solver with search options OPTS (NULL for defaults) */
+struct bitx_solver *
+bitx_solver_create(const struct dloptions *opts);
+
+/* Free memory of solver BXS */
+void
+bitx_solver_free(struct bitx_solver *bxs);
+
+/* Solve sparse binary matrix SMAT with solver BXS, stopping after LIMIT
+ * solutions (0 for no limit). Returns number of solutions found. */
+int
+bitx_solver_solve(struct bitx_solver *bxs, const struct smatrix *smat, int limit);
+
+/* Count solutions of sparse binary matrix SMAT with solver BXS up to LIMIT
+ * (0 for no limit) without storing them */
+long
+bitx_solver_count(struct bitx_solver *bxs, const struct smatrix *smat, long limit);
+
+/* Solve sparse binary matrix SMAT with solver BXS and call VISIT with context
+ * CTX for every solution as soon as it is found. Returns number of solutions
+ * visited. */
+long
+bitx_solver_visit(struct bitx_solver *bxs, const struct smatrix *smat, dlvisitor visit,
+                  void *ctx);
+
+/* Returns solutions found by last call of `bitx_solver_solve' on BXS. They
+ * stay valid until the next call. */
+const struct dlsolution *
+bitx_solver_solutions(const struct bitx_solver *bxs);
+
+/* Returns statistics of the last search of BXS. With LINKS_STATS set, updates
+ * count the column sizes changed by choosing and taking back rows. */
+const struct dlstats *
+bitx_solver_stats(const struct bitx_solver *bxs);
+
+/* Returns why the last search of BXS was aborted, DLABORT_NONE if it ran to
+ * the end or its solution limit */
+enum dlabort
+bitx_solver_aborted(const struct bitx_solver *bxs);
+
+/* Solve sparse binary matrix SMAT as `dlsolution_find' does, with the bitset
+ * solver. Returns array to found solutions, to be freed with
+ * `dlsolution_free', and stores number in NSOLS. */
+struct dlsolution *
+bitx_solution_find(const struct smatrix *smat, const struct dloptions *opts,
+                   int max_solutions, int *nsols);
+
+/* Returns name of the vector instructions the solver was compiled for:
+ * "avx2", "sse2" or "portable" */
+const char *
+bitx_simd(void);
+
+#endif /* BITX_H */
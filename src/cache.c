@@ -0,0 +1,322 @@
+#include "cache.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "input.h"
+
+/* Cached solution. DATA holds the canonical form the entry is keyed by and
+ * then the solution of that form, NELEMS x NELEMS cells each. */
+struct cache_entry {
+    uint64_t hash;
+    int size;
+    long chain;         /* Next entry of the same bucket, -1 if none */
+    long newer;         /* Neighbours in order of use, -1 if none */
+    long older;
+    uint8_t *data;
+};
+
+struct cache {
+    pthread_mutex_t lock;       /* Guards all below */
+    long capacity;
+    long nentries;
+    struct cache_entry *entries;
+    long *buckets;              /* First entry of each bucket, -1 if none */
+    uint64_t mask;              /* Number of buckets minus one */
+    long newest;                /* Ends of the list of entries in order of */
+    long oldest;                /* use, -1 if empty */
+    struct cache_stats stats;
+};
+
+/* Returns hash of sudoku SUDOKU (FNV-1a of its cells and size) */
+static uint64_t
+cache_hash(const struct sudoku *sudoku)
+{
+    const size_t ncells = (size_t) sudoku->nelems * sudoku->nelems;
+    uint64_t hash = UINT64_C(14695981039346656037);
+    for (size_t i = 0; i < ncells; ++i) {
+        hash = (hash ^ sudoku->data[i]) * UINT64_C(1099511628211);
+    }
+    return (hash ^ (uint64_t) sudoku->size) * UINT64_C(1099511628211);
+}
+
+struct cache *
+cache_create(long capacity)
+{
+    struct cache *cache = malloc(sizeof *cache);
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->capacity = (capacity > 0) ? capacity : 1;
+    cache->nentries = 0;
+    cache->entries = malloc(cache->capacity * sizeof *cache->entries);
+
+    /* At least as many buckets as entries keeps the chains short */
+    long nbuckets = 1;
+    while (nbuckets < cache->capacity) {
+        nbuckets *= 2;
+    }
+    cache->buckets = malloc(nbuckets * sizeof *cache->buckets);
+    for (long i = 0; i < nbuckets; ++i) {
+        cache->buckets[i] = -1;
+    }
+    cache->mask = (uint64_t) nbuckets - 1;
+    cache->newest = -1;
+    cache->oldest = -1;
+    memset(&cache->stats, 0, sizeof cache->stats);
+    return cache;
+}
+
+void
+cache_free(struct cache *cache)
+{
+    if (!cache) {
+        return;
+    }
+    for (long i = 0; i < cache->nentries; ++i) {
+        free(cache->entries[i].data);
+    }
+    free(cache->entries);
+    free(cache->buckets);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+/* Returns index of entry of CACHE keyed by FORM with hash HASH, or -1 */
+static long
+cache_find(const struct cache *cache, const struct sudoku *form, uint64_t hash)
+{
+    const size_t ncells = (size_t) form->nelems * form->nelems;
+    for (long i = cache->buckets[hash & cache->mask]; i >= 0; i = cache->entries[i].chain) {
+        const struct cache_entry *entry = &cache->entries[i];
+        if (entry->hash == hash && entry->size == form->size
+            && memcmp(entry->data, form->data, ncells) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Take entry I of CACHE out of the order of use */
+static void
+cache_unlink(struct cache *cache, long i)
+{
+    struct cache_entry *entry = &cache->entries[i];
+    if (entry->newer >= 0) {
+        cache->entries[entry->newer].older = entry->older;
+    } else {
+        cache->newest = entry->older;
+    }
+    if (entry->older >= 0) {
+        cache->entries[entry->older].newer = entry->newer;
+    } else {
+        cache->oldest = entry->newer;
+    }
+}
+
+/* Make entry I of CACHE the most recently used one */
+static void
+cache_push(struct cache *cache, long i)
+{
+    struct cache_entry *entry = &cache->entries[i];
+    entry->newer = -1;
+    entry->older = cache->newest;
+    if (cache->newest >= 0) {
+        cache->entries[cache->newest].newer = i;
+    } else {
+        cache->oldest = i;
+    }
+    cache->newest = i;
+}
+
+/* Take entry I of CACHE out of its bucket */
+static void
+cache_unchain(struct cache *cache, long i)
+{
+    long *link = &cache->buckets[cache->entries[i].hash & cache->mask];
+    while (*link != i) {
+        link = &cache->entries[*link].chain;
+    }
+    *link = cache->entries[i].chain;
+}
+
+int
+cache_lookup(struct cache *cache, struct canon *canon, const struct sudoku *sudoku,
+             struct sudoku *solution)
+{
+    /* Canonicalizing is the costly part and needs no lock */
+    canon_sudoku(canon, sudoku, NULL);
+    const struct sudoku *form = canon_form(canon);
+    const uint64_t hash = cache_hash(form);
+
+    pthread_mutex_lock(&cache->lock);
+    ++cache->stats.lookups;
+    const long i = cache_find(cache, form, hash);
+    if (i >= 0) {
+        ++cache->stats.hits;
+        cache_unlink(cache, i);
+        cache_push(cache, i);
+        const size_t ncells = (size_t) form->nelems * form->nelems;
+        const struct sudoku stored = { form->size, form->nelems, &cache->entries[i].data[ncells] };
+        canon_restore(canon, &stored, solution);
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    return i >= 0;
+}
+
+void
+cache_store(struct cache *cache, const struct canon *canon, const struct sudoku *solution)
+{
+    const struct sudoku *form = canon_form(canon);
+    const size_t ncells = (size_t) form->nelems * form->nelems;
+    const uint64_t hash = cache_hash(form);
+
+    pthread_mutex_lock(&cache->lock);
+    long i = cache_find(cache, form, hash);
+    if (i >= 0) {
+        /* Some other thread got there first */
+        cache_unlink(cache, i);
+        cache_push(cache, i);
+        pthread_mutex_unlock(&cache->lock);
+        return;
+    }
+
+    struct cache_entry *entry;
+    if (cache->nentries < cache->capacity) {
+        i = cache->nentries++;
+        entry = &cache->entries[i];
+        entry->data = malloc(2 * ncells);
+    } else {
+        i = cache->oldest;
+        cache_unlink(cache, i);
+        cache_unchain(cache, i);
+        ++cache->stats.evictions;
+        entry = &cache->entries[i];
+        if (entry->size != form->size) {
+            free(entry->data);
+            entry->data = malloc(2 * ncells);
+        }
+    }
+    entry->hash = hash;
+    entry->size = form->size;
+    memcpy(entry->data, form->data, ncells);
+    struct sudoku stored = { form->size, form->nelems, &entry->data[ncells] };
+    canon_apply(canon, solution, &stored);
+
+    entry->chain = cache->buckets[hash & cache->mask];
+    cache->buckets[hash & cache->mask] = i;
+    cache_push(cache, i);
+    ++cache->stats.inserts;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void
+cache_stats(struct cache *cache, struct cache_stats *stats)
+{
+    pthread_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    stats->nentries = cache->nentries;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+long
+cache_save(struct cache *cache, FILE *out)
+{
+    long nsaved = 0;
+    char *buf = malloc(2 * (SUDOKU_LINE_MAX_NELEMS * SUDOKU_LINE_MAX_NELEMS + 1));
+
+    pthread_mutex_lock(&cache->lock);
+    fprintf(out, "# Sudoku solution cache: canonical form and solution\n");
+    for (long i = cache->oldest; i >= 0; i = cache->entries[i].newer) {
+        const struct cache_entry *entry = &cache->entries[i];
+        const int nelems = entry->size * entry->size;
+        if (nelems > SUDOKU_LINE_MAX_NELEMS) {
+            continue;
+        }
+        const struct sudoku form = { entry->size, nelems, entry->data };
+        const struct sudoku solution = { entry->size, nelems,
+                                         &entry->data[(size_t) nelems * nelems] };
+        const int len = sudoku_sprint_line(buf, &form);
+        buf[len - 1] = ' ';
+        const int totlen = len + sudoku_sprint_line(&buf[len], &solution);
+        fwrite(buf, 1, totlen, out);
+        ++nsaved;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    free(buf);
+    return nsaved;
+}
+
+/* Returns non-zero if SOLUTION is a complete sudoku without repeated elements
+ * that keeps the clues of SUDOKU */
+static int
+cache_check(const struct sudoku *sudoku, const struct sudoku *solution)
+{
+    const int size = sudoku->size;
+    const int nelems = sudoku->nelems;
+    if (solution->size != size) {
+        return 0;
+    }
+
+    /* Elements seen per row, column and block */
+    uint8_t *seen = calloc((size_t) 3 * nelems * (nelems + 1), 1);
+    int valid = 1;
+    for (int r = 0; r < nelems && valid; ++r) {
+        for (int c = 0; c < nelems && valid; ++c) {
+            const size_t cell = (size_t) r * nelems + c;
+            const int elem = solution->data[cell];
+            const int units[3] = { r, nelems + c, 2 * nelems + (r / size) * size + c / size };
+            valid = (elem != 0) && (sudoku->data[cell] == 0 || sudoku->data[cell] == elem);
+            for (int k = 0; k < 3 && valid; ++k) {
+                uint8_t *mark = &seen[(size_t) units[k] * (nelems + 1) + elem];
+                valid = !*mark;
+                *mark = 1;
+            }
+        }
+    }
+    free(seen);
+    return valid;
+}
+
+long
+cache_load(struct cache *cache, FILE *in)
+{
+    struct input input;
+    if (!input_map(&input, in)) {
+        input_read(&input, in);
+    }
+
+    struct canon *canon = canon_create();
+    struct sudoku *sudoku = sudoku_create(3);
+    struct sudoku *solution = sudoku_create(3);
+    long nloaded = 0;
+    size_t pos = 0;
+    while (pos < input.len) {
+        const char *line = &input.data[pos];
+        const char *nl = memchr(line, '\n', input.len - pos);
+        size_t len = nl ? (size_t) (nl - line) : input.len - pos;
+        pos += len + 1;
+        while (len > 0 && line[len - 1] == '\r') {
+            --len;
+        }
+        const char *sep = memchr(line, ' ', len);
+        if (len == 0 || line[0] == '#' || !sep) {
+            continue;
+        }
+
+        if (sudoku_parse_line(sudoku, line, (int) (sep - line))
+            && sudoku_parse_line(solution, sep + 1, (int) (len - (sep + 1 - line)))
+            && cache_check(sudoku, solution)) {
+            canon_sudoku(canon, sudoku, NULL);
+            cache_store(cache, canon, solution);
+            ++nloaded;
+        }
+    }
+
+    sudoku_free(sudoku);
+    sudoku_free(solution);
+    canon_free(canon);
+    input_free(&input);
+    return nloaded;
+}
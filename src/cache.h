@@ -0,0 +1,66 @@
+/* cache.h
+ *
+ * Header for caching solutions of sudokus by their canonical form.
+ *
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+
+#include "canon.h"
+#include "sudoku.h"
+
+/* Counters of a cache */
+struct cache_stats {
+    long lookups;       /* Number of lookups */
+    long hits;          /* Number of lookups that found a solution */
+    long inserts;       /* Number of solutions stored */
+    long evictions;     /* Number of solutions dropped to make room */
+    long nentries;      /* Number of solutions held */
+};
+
+/* Bounded cache of solutions keyed by the canonical form of their sudoku (see
+ * `canon_sudoku'), so a solution found once serves every sudoku that is the
+ * same up to the transforms the form ignores. When full, the least recently
+ * used solution is dropped. All functions may be called from several threads
+ * at once. */
+struct cache;
+
+/* Create cache holding up to CAPACITY solutions */
+struct cache *
+cache_create(long capacity);
+
+/* Free memory of cache CACHE */
+void
+cache_free(struct cache *cache);
+
+/* Look up SUDOKU in CACHE, computing its canonical form with CANON, and write
+ * its solution to SOLUTION, which must have the same size. Returns non-zero on
+ * a hit. Either way CANON keeps the form for `cache_store'. */
+int
+cache_lookup(struct cache *cache, struct canon *canon, const struct sudoku *sudoku,
+             struct sudoku *solution);
+
+/* Store SOLUTION of the sudoku last given to CANON in CACHE */
+void
+cache_store(struct cache *cache, const struct canon *canon, const struct sudoku *solution);
+
+/* Write counters of CACHE to STATS */
+void
+cache_stats(struct cache *cache, struct cache_stats *stats);
+
+/* Write solutions held by CACHE to file OUT, one "form solution" line each in
+ * one-line format, least recently used first. Sudokus too large for the
+ * one-line format are left out. Returns number of solutions written. */
+long
+cache_save(struct cache *cache, FILE *out);
+
+/* Store solutions read from file IN as written by `cache_save' in CACHE.
+ * Lines whose solution does not solve their sudoku are skipped. Returns number
+ * of solutions stored. */
+long
+cache_load(struct cache *cache, FILE *in);
+
+#endif /* CACHE_H */
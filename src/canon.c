@@ -0,0 +1,470 @@
+#include "canon.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Group of rows of a view that tie in the order, so all their permutations
+ * are tried. SEG holds their positions, ascending between tries. */
+struct canon_tie {
+    int *seg;
+    int len;
+};
+
+/* A sudoku is looked at in two views, as it is (0) and transposed (1). Rows
+ * of a view are ordered by signatures that do not change under the transforms
+ * of the form: the number of clues per stack, and per clue the number of
+ * clues in its column and block and of its digit. The columns of one view are
+ * the rows of the other. */
+struct canon {
+    int size;
+    int nelems;
+    int siglen;                 /* SIZE stack counts, then NELEMS features */
+    uint8_t *view[2];
+    int *sigs[2];               /* Signature of each row of each view */
+    int *bands[2];              /* Bands of each view in order */
+    int *rows[2];               /* Rows of band B in order at ROWS[B * SIZE] */
+    int *lines[2];              /* Number of clues per row of each view */
+    int *blocks;                /* Number of clues per block of view 0 */
+    int *digits;                /* Number of clues per digit */
+    int ntie;
+    struct canon_tie *ties;
+    int *rowsrc;                /* Transform of the current candidate */
+    int *colsrc;
+    uint8_t *map;
+    uint8_t *cur;               /* Form of the current candidate */
+    uint8_t *best;              /* Smallest form so far */
+    struct sudoku form;         /* Wraps BEST once it is final */
+    struct canon_transform tr;  /* Transform giving BEST */
+};
+
+struct canon *
+canon_create(void)
+{
+    struct canon *canon = calloc(1, sizeof *canon);
+    return canon;
+}
+
+/* Free buffers of CANON */
+static void
+canon_release(struct canon *canon)
+{
+    for (int v = 0; v < 2; ++v) {
+        free(canon->view[v]);
+        free(canon->sigs[v]);
+        free(canon->bands[v]);
+        free(canon->rows[v]);
+        free(canon->lines[v]);
+    }
+    free(canon->blocks);
+    free(canon->digits);
+    free(canon->ties);
+    free(canon->rowsrc);
+    free(canon->colsrc);
+    free(canon->map);
+    free(canon->cur);
+    free(canon->best);
+    free(canon->tr.rows);
+    free(canon->tr.cols);
+    free(canon->tr.digits);
+}
+
+void
+canon_free(struct canon *canon)
+{
+    if (!canon) {
+        return;
+    }
+    canon_release(canon);
+    free(canon);
+}
+
+/* Set up buffers of CANON for sudokus with blocks of SIZE x SIZE cells */
+static void
+canon_reserve(struct canon *canon, int size)
+{
+    if (canon->size == size) {
+        return;
+    }
+    canon_release(canon);
+
+    const int nelems = size * size;
+    const size_t ncells = (size_t) nelems * nelems;
+    canon->size = size;
+    canon->nelems = nelems;
+    canon->siglen = size + nelems;
+    for (int v = 0; v < 2; ++v) {
+        canon->view[v] = malloc(ncells);
+        canon->sigs[v] = malloc((size_t) nelems * canon->siglen * sizeof *canon->sigs[v]);
+        canon->bands[v] = malloc(size * sizeof *canon->bands[v]);
+        canon->rows[v] = malloc(nelems * sizeof *canon->rows[v]);
+        canon->lines[v] = malloc(nelems * sizeof *canon->lines[v]);
+    }
+    canon->blocks = malloc(nelems * sizeof *canon->blocks);
+    canon->digits = malloc((nelems + 1) * sizeof *canon->digits);
+    /* Every band and every row but the first of a group can start a tie */
+    canon->ties = malloc(2 * (size + nelems) * sizeof *canon->ties);
+    canon->rowsrc = malloc(nelems * sizeof *canon->rowsrc);
+    canon->colsrc = malloc(nelems * sizeof *canon->colsrc);
+    canon->map = malloc(nelems + 1);
+    canon->cur = malloc(ncells);
+    canon->best = malloc(ncells);
+    canon->tr.nelems = nelems;
+    canon->tr.rows = malloc(nelems * sizeof *canon->tr.rows);
+    canon->tr.cols = malloc(nelems * sizeof *canon->tr.cols);
+    canon->tr.digits = malloc(nelems + 1);
+}
+
+static int
+canon_compare_int(const void *a, const void *b)
+{
+    const int x = *(const int *) a;
+    const int y = *(const int *) b;
+    return (x > y) - (x < y);
+}
+
+/* Sort the N ints of A ascending; insertion sort beats qsort on short rows */
+static void
+canon_sort(int *a, int n)
+{
+    if (n > 32) {
+        qsort(a, n, sizeof *a, &canon_compare_int);
+        return;
+    }
+    for (int i = 1; i < n; ++i) {
+        const int x = a[i];
+        int j = i;
+        for (; j > 0 && a[j - 1] > x; --j) {
+            a[j] = a[j - 1];
+        }
+        a[j] = x;
+    }
+}
+
+/* Compare signatures of row R1 of view V1 and row R2 of view V2 of CANON */
+static int
+canon_compare_rows(const struct canon *canon, int v1, int r1, int v2, int r2)
+{
+    const int *a = &canon->sigs[v1][(size_t) r1 * canon->siglen];
+    const int *b = &canon->sigs[v2][(size_t) r2 * canon->siglen];
+    for (int i = 0; i < canon->siglen; ++i) {
+        if (a[i] != b[i]) {
+            return (a[i] > b[i]) - (a[i] < b[i]);
+        }
+    }
+    return 0;
+}
+
+/* Compare band B1 of view V1 and band B2 of view V2 of CANON by the
+ * signatures of their rows, which must be in order */
+static int
+canon_compare_bands(const struct canon *canon, int v1, int b1, int v2, int b2)
+{
+    const int size = canon->size;
+    for (int i = 0; i < size; ++i) {
+        const int cmp = canon_compare_rows(canon, v1, canon->rows[v1][b1 * size + i],
+                                           v2, canon->rows[v2][b2 * size + i]);
+        if (cmp != 0) {
+            return cmp;
+        }
+    }
+    return 0;
+}
+
+/* Compute signatures of the rows of view V of CANON */
+static void
+canon_sign(struct canon *canon, int v)
+{
+    const int size = canon->size;
+    const int nelems = canon->nelems;
+    const uint8_t *view = canon->view[v];
+    const int *cols = canon->lines[1 - v];
+
+    for (int r = 0; r < nelems; ++r) {
+        int *sig = &canon->sigs[v][(size_t) r * canon->siglen];
+        int *feat = &sig[size];
+        for (int k = 0; k < size; ++k) {
+            sig[k] = 0;
+        }
+        for (int c = 0; c < nelems; ++c) {
+            const int elem = view[(size_t) r * nelems + c];
+            if (elem == 0) {
+                feat[c] = 0;
+                continue;
+            }
+            const int band = r / size;
+            const int stack = c / size;
+            const int block = v ? stack * size + band : band * size + stack;
+            ++sig[stack];
+            feat[c] = 1 + ((cols[c] * (nelems + 1) + canon->blocks[block]) * (nelems + 1)
+                           + canon->digits[elem]);
+        }
+        canon_sort(sig, size);
+        canon_sort(feat, nelems);
+    }
+}
+
+/* Order the rows of view V of CANON within their bands, and the bands, by
+ * signature. Insertion sort keeps tied rows in ascending order. */
+static void
+canon_order(struct canon *canon, int v)
+{
+    const int size = canon->size;
+    int *rows = canon->rows[v];
+    int *bands = canon->bands[v];
+
+    for (int b = 0; b < size; ++b) {
+        int *band = &rows[b * size];
+        for (int i = 0; i < size; ++i) {
+            const int r = b * size + i;
+            int j = i;
+            for (; j > 0 && canon_compare_rows(canon, v, band[j - 1], v, r) > 0; --j) {
+                band[j] = band[j - 1];
+            }
+            band[j] = r;
+        }
+    }
+    for (int i = 0; i < size; ++i) {
+        int j = i;
+        for (; j > 0 && canon_compare_bands(canon, v, bands[j - 1], v, i) > 0; --j) {
+            bands[j] = bands[j - 1];
+        }
+        bands[j] = i;
+    }
+}
+
+/* Add ties of the order of view V of CANON. Returns number of orders they
+ * allow, saturated at LIMIT. */
+static long
+canon_add_ties(struct canon *canon, int v, long limit)
+{
+    const int size = canon->size;
+    long norders = 1;
+
+    for (int g = 0; g <= size; ++g) {
+        /* Group G < SIZE are the rows of band G, group SIZE the bands */
+        int *seg = (g < size) ? &canon->rows[v][g * size] : canon->bands[v];
+        for (int i = 0; i < size;) {
+            int j = i + 1;
+            while (j < size && ((g < size)
+                                ? canon_compare_rows(canon, v, seg[i], v, seg[j])
+                                : canon_compare_bands(canon, v, seg[i], v, seg[j])) == 0) {
+                ++j;
+            }
+            if (j - i > 1) {
+                canon->ties[canon->ntie].seg = &seg[i];
+                canon->ties[canon->ntie].len = j - i;
+                ++canon->ntie;
+                for (int k = 2; k <= j - i && norders < limit; ++k) {
+                    norders *= k;
+                }
+            }
+            i = j;
+        }
+    }
+
+    return (norders < limit) ? norders : limit;
+}
+
+/* Advance SEG of LEN ints to the next permutation in lexicographic order.
+ * Returns zero, with SEG in ascending order again, after the last one. */
+static int
+canon_next_permutation(int *seg, int len)
+{
+    int i = len - 2;
+    while (i >= 0 && seg[i] >= seg[i + 1]) {
+        --i;
+    }
+    if (i >= 0) {
+        int j = len - 1;
+        while (seg[j] <= seg[i]) {
+            --j;
+        }
+        const int tmp = seg[i];
+        seg[i] = seg[j];
+        seg[j] = tmp;
+    }
+    for (int lo = i + 1, hi = len - 1; lo < hi; ++lo, --hi) {
+        const int tmp = seg[lo];
+        seg[lo] = seg[hi];
+        seg[hi] = tmp;
+    }
+    return i >= 0;
+}
+
+/* Advance ties of CANON to their next combination of permutations. Returns
+ * zero after the last one. */
+static int
+canon_next(struct canon *canon)
+{
+    for (int i = 0; i < canon->ntie; ++i) {
+        if (canon_next_permutation(canon->ties[i].seg, canon->ties[i].len)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Build form of the current order of CANON with view T giving the rows, and
+ * keep it with its transform if it is smaller than the best one so far, or if
+ * there is none yet (FIRST set) */
+static void
+canon_try(struct canon *canon, int t, int first)
+{
+    const int size = canon->size;
+    const int nelems = canon->nelems;
+    for (int i = 0; i < nelems; ++i) {
+        canon->rowsrc[i] = canon->rows[t][canon->bands[t][i / size] * size + i % size];
+        canon->colsrc[i] = canon->rows[1 - t][canon->bands[1 - t][i / size] * size
+                                              + i % size];
+    }
+
+    /* Digits are relabeled in order of appearance. The candidate is dropped
+     * as soon as it turns out larger than the best one. */
+    const uint8_t *view = canon->view[t];
+    memset(canon->map, 0, nelems + 1);
+    int next = 1;
+    int smaller = first;
+    size_t pos = 0;
+    for (int i = 0; i < nelems; ++i) {
+        const uint8_t *row = &view[(size_t) canon->rowsrc[i] * nelems];
+        for (int j = 0; j < nelems; ++j, ++pos) {
+            int elem = row[canon->colsrc[j]];
+            if (elem != 0) {
+                if (canon->map[elem] == 0) {
+                    canon->map[elem] = (uint8_t) next++;
+                }
+                elem = canon->map[elem];
+            }
+            if (!smaller) {
+                if (elem > canon->best[pos]) {
+                    return;
+                }
+                smaller = elem < canon->best[pos];
+            }
+            canon->cur[pos] = (uint8_t) elem;
+        }
+    }
+    if (!smaller) {
+        return;
+    }
+
+    /* Digits missing from the sudoku take the labels left */
+    for (int elem = 1; elem <= nelems; ++elem) {
+        if (canon->map[elem] == 0) {
+            canon->map[elem] = (uint8_t) next++;
+        }
+    }
+    uint8_t *tmp = canon->best;
+    canon->best = canon->cur;
+    canon->cur = tmp;
+    canon->tr.transpose = t;
+    memcpy(canon->tr.rows, canon->rowsrc, nelems * sizeof *canon->tr.rows);
+    memcpy(canon->tr.cols, canon->colsrc, nelems * sizeof *canon->tr.cols);
+    memcpy(canon->tr.digits, canon->map, nelems + 1);
+}
+
+int
+canon_sudoku(struct canon *canon, const struct sudoku *sudoku, struct sudoku *form)
+{
+    const int size = sudoku->size;
+    const int nelems = sudoku->nelems;
+    canon_reserve(canon, size);
+
+    /* Counts of clues per row, column, block and digit */
+    memset(canon->lines[0], 0, nelems * sizeof *canon->lines[0]);
+    memset(canon->lines[1], 0, nelems * sizeof *canon->lines[1]);
+    memset(canon->blocks, 0, nelems * sizeof *canon->blocks);
+    memset(canon->digits, 0, (nelems + 1) * sizeof *canon->digits);
+    for (int r = 0; r < nelems; ++r) {
+        for (int c = 0; c < nelems; ++c) {
+            const uint8_t elem = sudoku->data[(size_t) r * nelems + c];
+            canon->view[0][(size_t) r * nelems + c] = elem;
+            canon->view[1][(size_t) c * nelems + r] = elem;
+            if (elem != 0) {
+                ++canon->lines[0][r];
+                ++canon->lines[1][c];
+                ++canon->blocks[(r / size) * size + c / size];
+                ++canon->digits[elem];
+            }
+        }
+    }
+    for (int v = 0; v < 2; ++v) {
+        canon_sign(canon, v);
+        canon_order(canon, v);
+    }
+
+    /* The view whose bands come first gives the rows; if they are the same
+     * both are tried */
+    int cmp = 0;
+    for (int i = 0; i < size && cmp == 0; ++i) {
+        cmp = canon_compare_bands(canon, 0, canon->bands[0][i], 1, canon->bands[1][i]);
+    }
+
+    canon->ntie = 0;
+    long norders = canon_add_ties(canon, 0, CANON_MAX_CANDIDATES);
+    norders *= canon_add_ties(canon, 1, CANON_MAX_CANDIDATES);
+    if (cmp == 0) {
+        norders *= 2;
+    }
+
+    long ntried = 0;
+    for (int t = (cmp > 0); t <= ((cmp < 0) ? 0 : 1) && ntried < CANON_MAX_CANDIDATES; ++t) {
+        do {
+            canon_try(canon, t, ntried == 0);
+            ++ntried;
+        } while (ntried < CANON_MAX_CANDIDATES && canon_next(canon));
+    }
+
+    canon->form.size = size;
+    canon->form.nelems = nelems;
+    canon->form.data = canon->best;
+    if (form) {
+        memcpy(form->data, canon->best, (size_t) nelems * nelems);
+    }
+    return norders <= CANON_MAX_CANDIDATES;
+}
+
+const struct sudoku *
+canon_form(const struct canon *canon)
+{
+    return &canon->form;
+}
+
+const struct canon_transform *
+canon_transform(const struct canon *canon)
+{
+    return &canon->tr;
+}
+
+void
+canon_apply(const struct canon *canon, const struct sudoku *grid, struct sudoku *out)
+{
+    const struct canon_transform *tr = &canon->tr;
+    const int nelems = tr->nelems;
+    for (int i = 0; i < nelems; ++i) {
+        for (int j = 0; j < nelems; ++j) {
+            const size_t src = tr->transpose ? (size_t) tr->cols[j] * nelems + tr->rows[i]
+                                             : (size_t) tr->rows[i] * nelems + tr->cols[j];
+            out->data[(size_t) i * nelems + j] = tr->digits[grid->data[src]];
+        }
+    }
+}
+
+void
+canon_restore(const struct canon *canon, const struct sudoku *grid, struct sudoku *out)
+{
+    const struct canon_transform *tr = &canon->tr;
+    const int nelems = tr->nelems;
+    uint8_t inverse[UINT8_MAX + 1];
+    inverse[0] = 0;
+    for (int elem = 1; elem <= nelems; ++elem) {
+        inverse[tr->digits[elem]] = (uint8_t) elem;
+    }
+    for (int i = 0; i < nelems; ++i) {
+        for (int j = 0; j < nelems; ++j) {
+            const size_t dst = tr->transpose ? (size_t) tr->cols[j] * nelems + tr->rows[i]
+                                             : (size_t) tr->rows[i] * nelems + tr->cols[j];
+            out->data[dst] = inverse[grid->data[(size_t) i * nelems + j]];
+        }
+    }
+}
@@ -0,0 +1,74 @@
+/* canon.h
+ *
+ * Header for mapping sudokus to a canonical form under the transforms that
+ * keep them valid.
+ *
+ */
+
+#ifndef CANON_H
+#define CANON_H
+
+#include <inttypes.h>
+
+#include "sudoku.h"
+
+/* Most transforms tried per sudoku; see `canon_sudoku' */
+#define CANON_MAX_CANDIDATES 512
+
+/* Transform of a sudoku into its canonical form: rows and columns are swapped
+ * if TRANSPOSE is set, then row I of the form is row ROWS[I] and column J is
+ * column COLS[J], and digit D becomes DIGITS[D] (blanks stay blank). */
+struct canon_transform {
+    int nelems;
+    int transpose;
+    int *rows;
+    int *cols;
+    uint8_t *digits;
+};
+
+/* Reusable canonicalizer which keeps its buffers and the last transform */
+struct canon;
+
+/* Create canonicalizer */
+struct canon *
+canon_create(void);
+
+/* Free memory of canonicalizer CANON */
+void
+canon_free(struct canon *canon);
+
+/* Write canonical form of SUDOKU to FORM unless it is NULL, which must have
+ * the same size, and keep form and transform in CANON. Sudokus that are the
+ * same up to relabeling digits, permuting rows within bands, columns within
+ * stacks, bands and stacks, and transposing share their canonical form. Rows,
+ * columns, bands and stacks are ordered by invariants of these transforms
+ * first; of the transforms that keep that order the one giving the smallest
+ * grid in row-major order (blanks first, digits relabeled in order of
+ * appearance) wins. If more than CANON_MAX_CANDIDATES transforms keep the
+ * order, as for nearly empty grids, only the first ones are tried, and the
+ * form is only shared with sudokus equal to SUDOKU. Returns zero in that
+ * case. */
+int
+canon_sudoku(struct canon *canon, const struct sudoku *sudoku, struct sudoku *form);
+
+/* Returns the canonical form of the last sudoku given to `canon_sudoku', valid
+ * until the next call */
+const struct sudoku *
+canon_form(const struct canon *canon);
+
+/* Returns the transform of the last sudoku given to `canon_sudoku' */
+const struct canon_transform *
+canon_transform(const struct canon *canon);
+
+/* Apply last transform of CANON to GRID, e.g. a solution of the sudoku it was
+ * found for, and write the result to OUT. Both have the size of that sudoku. */
+void
+canon_apply(const struct canon *canon, const struct sudoku *grid, struct sudoku *out);
+
+/* Apply inverse of the last transform of CANON to GRID, e.g. a solution of
+ * the canonical form, and write the result to OUT. Both have the size of that
+ * sudoku. */
+void
+canon_restore(const struct canon *canon, const struct sudoku *grid, struct sudoku *out);
+
+#endif /* CANON_H */
@@ -0,0 +1,484 @@
+#define _POSIX_C_SOURCE 200809L /* clock_gettime */
+
+#include "generate.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bits.h"
+#include "propagate.h"
+#include "sudoku.h"
+
+/* Number of puzzles generated and written at a time */
+#define GENERATE_BLOCK_SIZE 4096
+
+/* Number of puzzles per unit of work handed to a thread */
+#define GENERATE_CHUNK_SIZE 16
+
+/* Block of puzzles generated by all threads, written out in order */
+struct generate_block {
+    pthread_mutex_t lock;
+    long first;         /* Index of the first puzzle of the run */
+    int npuzzles;
+    int next;           /* Next chunk to hand out */
+    int linelen;        /* Length of a puzzle line */
+    char *buf;          /* Puzzle I at I * LINELEN */
+    int *lens;          /* Length of each line, 0 for puzzles given up on */
+};
+
+/* State of one worker thread, reused for all puzzles it generates */
+struct generate_worker {
+    pthread_t thread;
+    const struct generate_options *opts;
+    struct generate_block *block;
+    struct sudoku_solver *solver;   /* Fills grids and checks uniqueness */
+    struct sudoku *grid;            /* Full grid the puzzle is cut from */
+    struct sudoku *puzzle;
+    struct sudoku *work;
+    uint64_t *cand;
+    int *order;         /* Cells in the order their clues are removed */
+    int *rows;          /* Row, column and digit maps of the grid shuffle */
+    int *cols;
+    int *digits;
+    int *perm;
+    uint64_t *inrow;    /* Digits used per row, column and block of PUZZLE */
+    uint64_t *incol;
+    uint64_t *inblock;
+    uint64_t rng;
+    long npuzzles;
+    long nfailed;
+    long ngrids;
+    long nchecks;
+    long nclues;
+};
+
+/* Returns wall clock time in seconds */
+static double
+generate_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/* Returns random state for puzzle INDEX of a run with SEED. Mixing the index
+ * in (splitmix64) gives every puzzle a state of its own, so puzzles don't
+ * depend on which thread generates them. */
+static uint64_t
+generate_seed(unsigned long seed, long index)
+{
+    uint64_t z = (uint64_t) seed + (uint64_t) (index + 1) * UINT64_C(0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+    z ^= z >> 31;
+    return z ? z : 1;
+}
+
+/* Advance random state RNG and return random number below N */
+static int
+generate_random(uint64_t *rng, int n)
+{
+    uint64_t x = *rng;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *rng = x;
+    return (int) (x % (uint64_t) n);
+}
+
+/* Shuffle the N numbers in PERM with random state RNG */
+static void
+generate_shuffle(uint64_t *rng, int *perm, int n)
+{
+    for (int i = n - 1; i > 0; --i) {
+        const int j = generate_random(rng, i + 1);
+        const int tmp = perm[i];
+        perm[i] = perm[j];
+        perm[j] = tmp;
+    }
+}
+
+/* Write random order of the NELEMS = SIZE * SIZE lines of a sudoku to MAP
+ * that keeps lines of a band together, using scratch PERM of SIZE numbers */
+static void
+generate_lines(uint64_t *rng, int *map, int *perm, int size)
+{
+    for (int band = 0; band < size; ++band) {
+        perm[band] = band;
+    }
+    generate_shuffle(rng, perm, size);
+    for (int band = 0; band < size; ++band) {
+        int *lines = &map[band * size];
+        for (int i = 0; i < size; ++i) {
+            lines[i] = perm[band] * size + i;
+        }
+        generate_shuffle(rng, lines, size);
+    }
+}
+
+/* Fill grid of WORKER with a random full grid. Returns zero if the solver
+ * found none, which happens for some seeds of the smallest size. */
+static int
+generate_grid(struct generate_worker *worker)
+{
+    struct sudoku *seeded = worker->puzzle;
+    const int size = seeded->size;
+    const int nelems = seeded->nelems;
+    const int totnum = nelems * nelems;
+
+    /* Blocks on the diagonal share no unit, so they are filled at random
+     * independently of each other */
+    memset(seeded->data, 0, totnum * sizeof *seeded->data);
+    for (int block = 0; block < size; ++block) {
+        for (int i = 0; i < nelems; ++i) {
+            worker->perm[i] = i + 1;
+        }
+        generate_shuffle(&worker->rng, worker->perm, nelems);
+        for (int i = 0; i < nelems; ++i) {
+            const int row = block * size + i / size;
+            const int col = block * size + i % size;
+            seeded->data[row * nelems + col] = worker->perm[i];
+        }
+    }
+    if (!sudoku_solver_solve(worker->solver, seeded, worker->work)) {
+        return 0;
+    }
+
+    /* The solver completes the rest the same way every time. Shuffling
+     * digits, rows within bands, bands, columns within stacks and stacks, and
+     * transposing, keep it a valid grid and spread it over all of them. */
+    for (int i = 0; i < nelems; ++i) {
+        worker->digits[i] = i + 1;
+    }
+    generate_shuffle(&worker->rng, worker->digits, nelems);
+    generate_lines(&worker->rng, worker->rows, worker->perm, size);
+    generate_lines(&worker->rng, worker->cols, worker->perm, size);
+    const int transpose = generate_random(&worker->rng, 2);
+
+    const uint8_t *src = worker->work->data;
+    for (int row = 0; row < nelems; ++row) {
+        for (int col = 0; col < nelems; ++col) {
+            const int srow = worker->rows[row];
+            const int scol = worker->cols[col];
+            const int elem = transpose ? src[scol * nelems + srow]
+                                       : src[srow * nelems + scol];
+            worker->grid->data[row * nelems + col] = worker->digits[elem - 1];
+        }
+    }
+    return 1;
+}
+
+/* Returns whether logic LEVEL alone solves PUZZLE of WORKER, which implies
+ * the solution is unique */
+static int
+generate_logic(struct generate_worker *worker, const struct sudoku *puzzle,
+               enum sudoku_propagate level)
+{
+    const int totnum = puzzle->nelems * puzzle->nelems;
+    int nempty = 0;
+    for (int cell = 0; cell < totnum; ++cell) {
+        nempty += puzzle->data[cell] == 0;
+    }
+    memcpy(worker->work->data, puzzle->data, totnum * sizeof *puzzle->data);
+    return sudoku_propagate(worker->work, worker->cand, level) == nempty;
+}
+
+/* Returns whether digit ELEM of cell CELL, which was just emptied, is forced
+ * by the clues left, as a naked single or as a hidden single in one of its
+ * units. Digits used per unit are taken from INROW, INCOL and INBLOCK of
+ * WORKER. */
+static int
+generate_forced(const struct generate_worker *worker, const struct sudoku *puzzle,
+                int cell, int elem)
+{
+    const int size = puzzle->size;
+    const int nelems = puzzle->nelems;
+    const int row = cell / nelems;
+    const int col = cell % nelems;
+    const int block = (row / size) * size + col / size;
+    const uint64_t bit = UINT64_C(1) << (elem - 1);
+
+    if (bits_popcount(worker->inrow[row] | worker->incol[col] | worker->inblock[block])
+        == nelems - 1) {
+        return 1;
+    }
+
+    /* A unit in which every other empty cell sees ELEM */
+    for (int unit = 0; unit < 3; ++unit) {
+        int hidden = 1;
+        for (int i = 0; i < nelems && hidden; ++i) {
+            const int r = (unit == 0) ? row : (unit == 1) ? i
+                        : (row / size) * size + i / size;
+            const int c = (unit == 0) ? i : (unit == 1) ? col
+                        : (col / size) * size + i % size;
+            if ((r == row && c == col) || puzzle->data[r * nelems + c] != 0) {
+                continue;
+            }
+            hidden = ((worker->inrow[r] | worker->incol[c]
+                       | worker->inblock[(r / size) * size + c / size]) & bit) != 0;
+        }
+        if (hidden) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Returns whether PUZZLE of WORKER, in which cell CELL with digit ELEM was just
+ * emptied, still has a unique solution, and is solved by logic alone if its
+ * band asks for it */
+static int
+generate_check(struct generate_worker *worker, struct sudoku *puzzle, int cell,
+               int elem)
+{
+    /* A forced cell is filled again by the first single, which leaves the
+     * puzzle as it was before */
+    if (generate_forced(worker, puzzle, cell, elem)) {
+        return 1;
+    }
+
+    ++worker->nchecks;
+    switch (worker->opts->band) {
+    case GENERATE_BAND_EASY:
+        return generate_logic(worker, puzzle, SUDOKU_PROPAGATE_SINGLES);
+    case GENERATE_BAND_MEDIUM:
+        return generate_logic(worker, puzzle, SUDOKU_PROPAGATE_LOCKED);
+    default:
+        break;
+    }
+
+    /* The grid is a solution, so any other one puts another digit into CELL;
+     * each of them is looked for with a search stopping at the first solution */
+    const int nelems = puzzle->nelems;
+    const int row = cell / nelems;
+    const int col = cell % nelems;
+    const int block = (row / puzzle->size) * puzzle->size + col / puzzle->size;
+    uint64_t others = ~(worker->inrow[row] | worker->incol[col] | worker->inblock[block]);
+    others &= ((nelems == 64) ? ~UINT64_C(0) : (UINT64_C(1) << nelems) - 1)
+            & ~(UINT64_C(1) << (elem - 1));
+    int unique = 1;
+    for (; others && unique; others &= others - 1) {
+        puzzle->data[cell] = bits_ctz(others) + 1;
+        unique = sudoku_solver_count(worker->solver, puzzle, 1) == 0;
+    }
+    puzzle->data[cell] = 0;
+    return unique;
+}
+
+/* Remove clues from the grid of WORKER into its puzzle. Returns number of
+ * clues left if the puzzle has at most the number asked for and is in its
+ * band, or zero to drop it. */
+static int
+generate_remove(struct generate_worker *worker)
+{
+    const struct generate_options *opts = worker->opts;
+    struct sudoku *puzzle = worker->puzzle;
+    const int size = puzzle->size;
+    const int nelems = puzzle->nelems;
+    const int totnum = nelems * nelems;
+
+    memcpy(puzzle->data, worker->grid->data, totnum * sizeof *puzzle->data);
+    for (int cell = 0; cell < totnum; ++cell) {
+        worker->order[cell] = cell;
+    }
+    generate_shuffle(&worker->rng, worker->order, totnum);
+
+    /* All digits are used in every unit of the full grid */
+    const uint64_t all = (nelems == 64) ? ~UINT64_C(0) : (UINT64_C(1) << nelems) - 1;
+    for (int i = 0; i < nelems; ++i) {
+        worker->inrow[i] = all;
+        worker->incol[i] = all;
+        worker->inblock[i] = all;
+    }
+
+    int nclues = totnum;
+    for (int i = 0; i < totnum && nclues > opts->nclues; ++i) {
+        const int cell = worker->order[i];
+        const int elem = puzzle->data[cell];
+        const int row = cell / nelems;
+        const int col = cell % nelems;
+        const int block = (row / size) * size + col / size;
+        const uint64_t bit = UINT64_C(1) << (elem - 1);
+
+        puzzle->data[cell] = 0;
+        worker->inrow[row] &= ~bit;
+        worker->incol[col] &= ~bit;
+        worker->inblock[block] &= ~bit;
+        if (generate_check(worker, puzzle, cell, elem)) {
+            --nclues;
+        } else {
+            puzzle->data[cell] = elem;
+            worker->inrow[row] |= bit;
+            worker->incol[col] |= bit;
+            worker->inblock[block] |= bit;
+        }
+    }
+    if (nclues > opts->nclues && opts->nclues > 0) {
+        return 0;
+    }
+
+    /* Removals only keep the puzzle within the logic of its band, it must not
+     * fall into the band below as well */
+    if (opts->band == GENERATE_BAND_MEDIUM
+        && generate_logic(worker, puzzle, SUDOKU_PROPAGATE_SINGLES)) {
+        return 0;
+    }
+    if (opts->band == GENERATE_BAND_HARD
+        && generate_logic(worker, puzzle, SUDOKU_PROPAGATE_LOCKED)) {
+        return 0;
+    }
+    return nclues;
+}
+
+/* Generate puzzle I of the current block of WORKER */
+static void
+generate_one(struct generate_worker *worker, int i)
+{
+    struct generate_block *block = worker->block;
+
+    worker->rng = generate_seed(worker->opts->seed, block->first + i);
+    for (int ngrids = 0; ngrids < GENERATE_MAX_GRIDS; ++ngrids) {
+        if (!generate_grid(worker)) {
+            continue;
+        }
+        ++worker->ngrids;
+
+        const int nclues = generate_remove(worker);
+        if (nclues > 0) {
+            ++worker->npuzzles;
+            worker->nclues += nclues;
+            block->lens[i] = sudoku_sprint_line(&block->buf[(size_t) i * block->linelen],
+                                                worker->puzzle);
+            return;
+        }
+    }
+
+    ++worker->nfailed;
+    block->lens[i] = 0;
+}
+
+static void *
+generate_worker_run(void *arg)
+{
+    struct generate_worker *worker = arg;
+    struct generate_block *block = worker->block;
+    const int nchunks = (block->npuzzles + GENERATE_CHUNK_SIZE - 1) / GENERATE_CHUNK_SIZE;
+
+    for (;;) {
+        pthread_mutex_lock(&block->lock);
+        const int chunk = block->next++;
+        pthread_mutex_unlock(&block->lock);
+        if (chunk >= nchunks) {
+            break;
+        }
+
+        const int beg = chunk * GENERATE_CHUNK_SIZE;
+        const int end = (beg + GENERATE_CHUNK_SIZE < block->npuzzles)
+                      ? beg + GENERATE_CHUNK_SIZE : block->npuzzles;
+        for (int i = beg; i < end; ++i) {
+            generate_one(worker, i);
+        }
+    }
+
+    return NULL;
+}
+
+void
+generate_puzzles(FILE *out, long npuzzles, const struct generate_options *opts,
+                 struct generate_stats *stats)
+{
+    const double start = generate_time();
+    const int nthreads = (opts->nthreads < 1) ? 1 : opts->nthreads;
+    const int nelems = opts->size * opts->size;
+    const int totnum = nelems * nelems;
+
+    /* Singles are cheap next to searching, and settle most checks: the other
+     * digit tried in the emptied cell soon runs into a contradiction */
+    const struct sudoku_options sopts = {
+        SUDOKU_ENGINE_AUTO, SUDOKU_PROPAGATE_SINGLES,
+        { DLSELECT_MRV, 0, 1, { 0, 0, NULL } }
+    };
+
+    struct generate_block block;
+    pthread_mutex_init(&block.lock, NULL);
+    block.linelen = totnum + 1;
+    block.buf = malloc((size_t) GENERATE_BLOCK_SIZE * block.linelen);
+    block.lens = malloc(GENERATE_BLOCK_SIZE * sizeof *block.lens);
+
+    struct generate_worker *workers = malloc(nthreads * sizeof *workers);
+    for (int i = 0; i < nthreads; ++i) {
+        struct generate_worker *worker = &workers[i];
+        worker->opts = opts;
+        worker->block = &block;
+        worker->solver = sudoku_solver_create(&sopts);
+        worker->grid = sudoku_create(opts->size);
+        worker->puzzle = sudoku_create(opts->size);
+        worker->work = sudoku_create(opts->size);
+        worker->cand = malloc(totnum * sizeof *worker->cand);
+        worker->order = malloc(totnum * sizeof *worker->order);
+        worker->rows = malloc(nelems * sizeof *worker->rows);
+        worker->cols = malloc(nelems * sizeof *worker->cols);
+        worker->digits = malloc(nelems * sizeof *worker->digits);
+        worker->perm = malloc(nelems * sizeof *worker->perm);
+        worker->inrow = malloc(nelems * sizeof *worker->inrow);
+        worker->incol = malloc(nelems * sizeof *worker->incol);
+        worker->inblock = malloc(nelems * sizeof *worker->inblock);
+        worker->npuzzles = 0;
+        worker->nfailed = 0;
+        worker->ngrids = 0;
+        worker->nchecks = 0;
+        worker->nclues = 0;
+    }
+
+    for (block.first = 0; block.first < npuzzles; block.first += GENERATE_BLOCK_SIZE) {
+        block.npuzzles = (npuzzles - block.first < GENERATE_BLOCK_SIZE)
+                       ? (int) (npuzzles - block.first) : GENERATE_BLOCK_SIZE;
+        block.next = 0;
+
+        /* The calling thread works as worker 0 */
+        for (int i = 1; i < nthreads; ++i) {
+            pthread_create(&workers[i].thread, NULL, &generate_worker_run, &workers[i]);
+        }
+        generate_worker_run(&workers[0]);
+        for (int i = 1; i < nthreads; ++i) {
+            pthread_join(workers[i].thread, NULL);
+        }
+
+        for (int i = 0; i < block.npuzzles; ++i) {
+            fwrite(&block.buf[(size_t) i * block.linelen], 1, block.lens[i], out);
+        }
+    }
+
+    memset(stats, 0, sizeof *stats);
+    for (int i = 0; i < nthreads; ++i) {
+        struct generate_worker *worker = &workers[i];
+        stats->npuzzles += worker->npuzzles;
+        stats->nfailed += worker->nfailed;
+        stats->ngrids += worker->ngrids;
+        stats->nchecks += worker->nchecks;
+        stats->nclues += worker->nclues;
+        sudoku_solver_free(worker->solver);
+        sudoku_free(worker->grid);
+        sudoku_free(worker->puzzle);
+        sudoku_free(worker->work);
+        free(worker->cand);
+        free(worker->order);
+        free(worker->rows);
+        free(worker->cols);
+        free(worker->digits);
+        free(worker->perm);
+        free(worker->inrow);
+        free(worker->incol);
+        free(worker->inblock);
+    }
+
+    free(workers);
+    free(block.buf);
+    free(block.lens);
+    pthread_mutex_destroy(&block.lock);
+
+    stats->seconds = generate_time() - start;
+}
@@ -0,0 +1,54 @@
+/* generate.h
+ *
+ * Header for generating sudokus with unique solutions.
+ *
+ */
+
+#ifndef GENERATE_H
+#define GENERATE_H
+
+#include <stdio.h>
+
+/* Number of full grids tried per puzzle before giving up */
+#define GENERATE_MAX_GRIDS 1000
+
+/* Difficulty bands, rated by the logic a puzzle needs to be solved */
+enum generate_band {
+    GENERATE_BAND_ANY,
+    GENERATE_BAND_EASY,     /* Naked and hidden singles suffice */
+    GENERATE_BAND_MEDIUM,   /* Locked candidates are needed as well */
+    GENERATE_BAND_HARD      /* Search is needed */
+};
+
+/* Options for generating sudokus */
+struct generate_options {
+    int size;                   /* Blocks of SIZE x SIZE cells */
+    int nclues;                 /* Stop removing clues at this many, 0 to remove
+                                 * as many as possible */
+    enum generate_band band;
+    unsigned long seed;         /* Same seed, same puzzles, whatever NTHREADS */
+    int nthreads;
+};
+
+/* Aggregate results of generating sudokus */
+struct generate_stats {
+    long npuzzles;      /* Number of puzzles written */
+    long nfailed;       /* Number of puzzles given up on */
+    long ngrids;        /* Number of full grids clues were removed from */
+    long nchecks;       /* Number of uniqueness checks */
+    long nclues;        /* Number of clues of all puzzles written */
+    double seconds;     /* Wall clock time of the run */
+};
+
+/* Generate NPUZZLES sudokus with unique solutions as set in OPTS and write them
+ * to OUT in one-line format, one per line. Each starts from a random full grid
+ * and has clues removed one at a time in random order, keeping a removal only
+ * if the solution stays unique (and the puzzle in its band). Grids which don't
+ * get down to the number of clues or into the band are dropped; after
+ * GENERATE_MAX_GRIDS of them the puzzle is given up on. Results are written to
+ * STATS. */
+void
+generate_puzzles(FILE *out, long npuzzles, const struct generate_options *opts,
+                 struct generate_stats *stats);
+
+#endif /* GENERATE_H */
@@ -0,0 +1,70 @@
+#define _POSIX_C_SOURCE 200809L /* fileno, ftello, mmap, posix_madvise */
+
+#include "input.h"
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Size of the first buffer `input_read' reads into */
+#define INPUT_BUFFER_SIZE 65536
+
+int
+input_map(struct input *input, FILE *in)
+{
+    struct stat st;
+    const int fd = fileno(in);
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return 0;
+    }
+
+    /* Skip what was read through IN already */
+    const off_t offset = ftello(in);
+    if (offset < 0 || st.st_size <= offset) {
+        return 0;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+    posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    input->data = (const char *) map + offset;
+    input->len = st.st_size - offset;
+    input->map = map;
+    input->maplen = st.st_size;
+    return 1;
+}
+
+void
+input_read(struct input *input, FILE *in)
+{
+    size_t cap = INPUT_BUFFER_SIZE;
+    size_t len = 0;
+    char *buf = malloc(cap);
+    size_t n;
+    while ((n = fread(&buf[len], 1, cap - len, in)) > 0) {
+        len += n;
+        if (len == cap) {
+            cap *= 2;
+            buf = realloc(buf, cap);
+        }
+    }
+
+    input->data = buf;
+    input->len = len;
+    input->map = NULL;
+    input->maplen = 0;
+}
+
+void
+input_free(struct input *input)
+{
+    if (input->map) {
+        munmap(input->map, input->maplen);
+    } else {
+        free((void *) input->data);
+    }
+    input->data = NULL;
+    input->len = 0;
+}
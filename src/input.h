@@ -0,0 +1,34 @@
+/* input.h
+ *
+ * Header for getting whole input files into memory.
+ *
+ */
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* Contents of an input file */
+struct input {
+    const char *data;
+    size_t len;
+    void *map;      /* Mapping DATA lies in, NULL if it was read into a buffer */
+    size_t maplen;
+};
+
+/* Map the rest of file IN into memory as INPUT, without copying it. Returns
+ * zero if IN can't be mapped (a pipe, terminal or empty file). */
+int
+input_map(struct input *input, FILE *in);
+
+/* Read the rest of file IN into memory as INPUT */
+void
+input_read(struct input *input, FILE *in);
+
+/* Release contents of INPUT */
+void
+input_free(struct input *input);
+
+#endif /* INPUT_H */
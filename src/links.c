@@ -1,8 +1,58 @@
+#define _POSIX_C_SOURCE 200809L /* clock_gettime */
+
 #include "links.h"
 
-#include <stdio.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+/* Node storage of the matrix. With LINKS_COMPACT set (the default) nodes are
+ * 32-bit indices into one array per field (structure of arrays), with the
+ * column headers next to each other in front of the elements. Otherwise every
+ * node is a struct linked to its neighbours by pointers. Both layouts share
+ * the search code through the DL_* accessors below. */
+#ifndef LINKS_COMPACT
+#define LINKS_COMPACT 1
+#endif
+
+#if LINKS_COMPACT
+
+/* Index of node: 0 is the root, 1 to NCOLS are the column headers and the
+ * elements follow in the order of the sparse matrix */
+typedef int32_t dlref;
+
+struct dlmatrix {
+    int nrows;
+    int ncols;
+    int maxnodes;       /* Capacity of the node arrays */
+    int maxheads;       /* Capacity of SIZE */
+    int32_t *left;
+    int32_t *right;
+    int32_t *up;
+    int32_t *down;
+    int32_t *col;       /* Column header of each node */
+    int32_t *row_id;    /* Row of each element */
+    int32_t *size;      /* Number of rows still linked into each column, for
+                         * the root and the headers only */
+    long nupdates;      /* Nodes unlinked and relinked (with LINKS_STATS) */
+};
+
+#define DL_NONE ((dlref) -1)
+#define DL_ROOT(m) ((dlref) 0)
+#define DL_HEADER(m, i) ((dlref) (i) + 1)
+#define DL_ELEM(m, i) ((dlref) ((m)->ncols + 1 + (i)))
+#define DL_ELEM_INDEX(m, x) ((int) (x) - (m)->ncols - 1)
+#define DL_LEFT(m, x) ((m)->left[x])
+#define DL_RIGHT(m, x) ((m)->right[x])
+#define DL_UP(m, x) ((m)->up[x])
+#define DL_DOWN(m, x) ((m)->down[x])
+#define DL_COL(m, x) ((m)->col[x])
+#define DL_ROW_ID(m, x) ((m)->row_id[x])
+#define DL_SIZE(m, c) ((m)->size[c])
+
+#else
 
 struct dlnode {
     struct dlnode *right;
@@ -10,324 +60,1312 @@ struct dlnode {
     struct dlnode *up;
     struct dlnode *down;
     int row_id;
+    int size;   /* Number of rows still linked into column (headers only) */
     struct dlnode *col;
 };
 
+typedef struct dlnode *dlref;
+
+struct dlmatrix {
+    struct dlnode head;
+    int nrows;
+    int ncols;
+    int maxcols;        /* Capacity of COLS */
+    int maxelems;       /* Capacity of DATA */
+    struct dlnode *cols;
+    struct dlnode *data;
+    long nupdates;      /* Nodes unlinked and relinked (with LINKS_STATS) */
+};
+
+/* Field F of node X; M is not needed but evaluated for symmetry */
+#define DL_FIELD(m, x, f) (*((void) (m), &(x)->f))
+
+#define DL_NONE ((dlref) NULL)
+#define DL_ROOT(m) (&(m)->head)
+#define DL_HEADER(m, i) (&(m)->cols[i])
+#define DL_ELEM(m, i) (&(m)->data[i])
+#define DL_ELEM_INDEX(m, x) ((int) ((x) - (m)->data))
+#define DL_LEFT(m, x) DL_FIELD(m, x, left)
+#define DL_RIGHT(m, x) DL_FIELD(m, x, right)
+#define DL_UP(m, x) DL_FIELD(m, x, up)
+#define DL_DOWN(m, x) DL_FIELD(m, x, down)
+#define DL_COL(m, x) DL_FIELD(m, x, col)
+#define DL_ROW_ID(m, x) DL_FIELD(m, x, row_id)
+#define DL_SIZE(m, c) DL_FIELD(m, c, size)
+
+#endif /* LINKS_COMPACT */
+
+/* The counters of `struct dlstats' other than nodes and solutions sit in the
+ * innermost loops, so they are only compiled in with LINKS_STATS set */
+#ifndef LINKS_STATS
+#define LINKS_STATS 0
+#endif
+
+#if LINKS_STATS
+#define DL_STAT(stmt) do { stmt; } while (0)
+#else
+#define DL_STAT(stmt) ((void) 0)
+#endif
+
+/* Bucket of the depth histogram of `struct dlstats' counting depth D */
+#define DL_STAT_DEPTH(d) (((d) < DLSTATS_DEPTHS) ? (d) : DLSTATS_DEPTHS - 1)
+
+/* Remove column of NODE from the header list of DLMAT and all rows hitting it
+ * from the other columns */
 static void
-dlnode_cover_column(struct dlnode *node)
+dlmatrix_cover_column(struct dlmatrix *dlmat, dlref node)
 {
-    struct dlnode *col = node->col;
+    const dlref col = DL_COL(dlmat, node);
 
-    col->right->left = col->left;
-    col->left->right = col->right;
+    DL_LEFT(dlmat, DL_RIGHT(dlmat, col)) = DL_LEFT(dlmat, col);
+    DL_RIGHT(dlmat, DL_LEFT(dlmat, col)) = DL_RIGHT(dlmat, col);
+    DL_STAT(++dlmat->nupdates);
 
-    for (struct dlnode *row = col->down; row != col; row = row->down) {
-        for (struct dlnode *ptr = row->right; ptr != row; ptr = ptr->right) {
-            ptr->up->down = ptr->down;
-            ptr->down->up = ptr->up;
+    for (dlref row = DL_DOWN(dlmat, col); row != col; row = DL_DOWN(dlmat, row)) {
+        for (dlref ptr = DL_RIGHT(dlmat, row); ptr != row; ptr = DL_RIGHT(dlmat, ptr)) {
+            DL_DOWN(dlmat, DL_UP(dlmat, ptr)) = DL_DOWN(dlmat, ptr);
+            DL_UP(dlmat, DL_DOWN(dlmat, ptr)) = DL_UP(dlmat, ptr);
+            --DL_SIZE(dlmat, DL_COL(dlmat, ptr));
+            DL_STAT(++dlmat->nupdates);
         }
     }
 }
 
+/* Undo `dlmatrix_cover_column' */
 static void
-dlnode_uncover_column(struct dlnode *node)
+dlmatrix_uncover_column(struct dlmatrix *dlmat, dlref node)
 {
-    struct dlnode *col = node->col;
+    const dlref col = DL_COL(dlmat, node);
 
-    for (struct dlnode *row = col->up; row != col; row = row->up) {
-        for (struct dlnode *ptr = row->left; ptr != row; ptr = ptr->left) {
-            ptr->up->down = ptr;
-            ptr->down->up = ptr;
+    for (dlref row = DL_UP(dlmat, col); row != col; row = DL_UP(dlmat, row)) {
+        for (dlref ptr = DL_LEFT(dlmat, row); ptr != row; ptr = DL_LEFT(dlmat, ptr)) {
+            DL_DOWN(dlmat, DL_UP(dlmat, ptr)) = ptr;
+            DL_UP(dlmat, DL_DOWN(dlmat, ptr)) = ptr;
+            ++DL_SIZE(dlmat, DL_COL(dlmat, ptr));
+            DL_STAT(++dlmat->nupdates);
         }
     }
 
-    col->right->left = col;
-    col->left->right = col;
+    DL_LEFT(dlmat, DL_RIGHT(dlmat, col)) = col;
+    DL_RIGHT(dlmat, DL_LEFT(dlmat, col)) = col;
+    DL_STAT(++dlmat->nupdates);
 }
 
-struct dlmatrix {
-    struct dlnode head;
-    int nrows;
-    int ncols;
-    struct dlnode *cols;
-    struct dlnode *data;
-};
-
 static void
 dlmatrix_free(struct dlmatrix *dlmat)
 {
     if (dlmat == NULL) {
         return;
     }
+#if LINKS_COMPACT
+    free(dlmat->left);
+    free(dlmat->right);
+    free(dlmat->up);
+    free(dlmat->down);
+    free(dlmat->col);
+    free(dlmat->row_id);
+    free(dlmat->size);
+#else
     free(dlmat->cols);
     free(dlmat->data);
+#endif
     free(dlmat);
 }
 
+/* Create empty matrix; buffers are allocated by `dlmatrix_load' */
 static struct dlmatrix *
-dlmatrix_create(const struct bmatrix *bmat)
+dlmatrix_create(void)
 {
-    struct dlmatrix *dlmat = malloc(sizeof *dlmat);
+    struct dlmatrix *dlmat = calloc(1, sizeof *dlmat);
+    return dlmat;
+}
 
-    const int nrows = bmat->nrows;
-    const int ncols = bmat->ncols;
+/* Make sure DLMAT has room for NCOLS columns and NELEMS elements */
+static void
+dlmatrix_reserve(struct dlmatrix *dlmat, int ncols, int nelems)
+{
+#if LINKS_COMPACT
+    const int nnodes = 1 + ncols + nelems;
+    if (nnodes > dlmat->maxnodes) {
+        dlmat->maxnodes = nnodes;
+        free(dlmat->left);
+        free(dlmat->right);
+        free(dlmat->up);
+        free(dlmat->down);
+        free(dlmat->col);
+        free(dlmat->row_id);
+        dlmat->left = malloc(nnodes * sizeof *dlmat->left);
+        dlmat->right = malloc(nnodes * sizeof *dlmat->right);
+        dlmat->up = malloc(nnodes * sizeof *dlmat->up);
+        dlmat->down = malloc(nnodes * sizeof *dlmat->down);
+        dlmat->col = malloc(nnodes * sizeof *dlmat->col);
+        dlmat->row_id = malloc(nnodes * sizeof *dlmat->row_id);
+    }
+    /* Only headers have a size, and they come first, so elements (the bulk
+     * of the nodes) cost six ints each */
+    if (1 + ncols > dlmat->maxheads) {
+        dlmat->maxheads = 1 + ncols;
+        free(dlmat->size);
+        dlmat->size = malloc(dlmat->maxheads * sizeof *dlmat->size);
+    }
+#else
+    if (ncols > dlmat->maxcols) {
+        dlmat->maxcols = ncols;
+        free(dlmat->cols);
+        dlmat->cols = malloc(ncols * sizeof *dlmat->cols);
+    }
+    if (nelems > dlmat->maxelems) {
+        dlmat->maxelems = nelems;
+        free(dlmat->data);
+        dlmat->data = malloc(nelems * sizeof *dlmat->data);
+    }
+#endif
+}
+
+/* Link nodes of sparse matrix SMAT into DLMAT. Buffers of DLMAT are reused
+ * and only grow if SMAT is larger than any matrix loaded before. Returns zero
+ * if SMAT has an empty column (and thus no solution). */
+static int
+dlmatrix_load(struct dlmatrix *dlmat, const struct smatrix *smat)
+{
+    const int nrows = smat->nrows;
+    const int ncols = smat->ncols;
     dlmat->nrows = nrows;
     dlmat->ncols = ncols;
+    dlmatrix_reserve(dlmat, ncols, smat->nelems);
 
     /* Initialize headers */
-    dlmat->cols = malloc(ncols * sizeof *dlmat->cols);
-
-    dlmat->head.up = NULL;
-    dlmat->head.down = NULL;
-    dlmat->head.row_id = -1;
-    dlmat->head.col = NULL;
-    dlmat->head.right = &dlmat->cols[0];
-    dlmat->head.left = &dlmat->cols[ncols - 1];
-
-    dlmat->cols[0].left = &dlmat->head;
-    dlmat->cols[0].row_id = -1;
-    for (int i = 1; i < ncols - 1; ++i) {
-        dlmat->cols[i].left = &dlmat->cols[i - 1];
-        dlmat->cols[i - 1].right = &dlmat->cols[i];
-        dlmat->cols[i].right = &dlmat->cols[i + 1];
-        dlmat->cols[i + 1].left = &dlmat->cols[i];
-        dlmat->cols[0].row_id = -1;
-    }
-    dlmat->cols[ncols - 1].right = &dlmat->head;
-    dlmat->cols[ncols - 1].row_id = -1;
+    const dlref head = DL_ROOT(dlmat);
+    DL_UP(dlmat, head) = DL_NONE;
+    DL_DOWN(dlmat, head) = DL_NONE;
+    DL_ROW_ID(dlmat, head) = -1;
+    DL_COL(dlmat, head) = DL_NONE;
+    /* A matrix without columns is solved by the empty set of rows */
+    DL_RIGHT(dlmat, head) = (ncols > 0) ? DL_HEADER(dlmat, 0) : head;
+    DL_LEFT(dlmat, head) = (ncols > 0) ? DL_HEADER(dlmat, ncols - 1) : head;
+
+    for (int i_col = 0; i_col < ncols; ++i_col) {
+        const dlref col = DL_HEADER(dlmat, i_col);
+        DL_LEFT(dlmat, col) = (i_col > 0) ? DL_HEADER(dlmat, i_col - 1) : head;
+        DL_RIGHT(dlmat, col) = (i_col < ncols - 1) ? DL_HEADER(dlmat, i_col + 1) : head;
+        DL_UP(dlmat, col) = col;
+        DL_DOWN(dlmat, col) = col;
+        DL_ROW_ID(dlmat, col) = -1;
+        DL_SIZE(dlmat, col) = 0;
+        DL_COL(dlmat, col) = col;
+    }
 
     /* Initialize elements */
-    /* We don't save the whole binary matrix but only non-zero elements */
-    int *idcs = malloc(nrows * ncols * sizeof *idcs);
-    int num_elems = 0;
-    for (int i = 0; i < nrows * ncols; ++i) {
-        if (bmat->data[i]) {
-            idcs[i] = num_elems;
-            ++num_elems;
-        } else {
-            idcs[i] = -1;
-        }
-    }
-    dlmat->data = malloc(num_elems * sizeof *dlmat->data);
-
-    struct dlnode *first = NULL;
-    struct dlnode *last = NULL;
-    struct dlnode *prev = NULL;
-    struct dlnode *curr = NULL;
-
-    /* Fill rows */
-    for (int i_row = 0; i_row < nrows; ++i_row) {
-        first = NULL;
-        last = NULL;
-        prev = NULL;
-        curr = NULL;
-        for (int i_col = 0; i_col < ncols; ++i_col) {
-            const int idx = idcs[i_row * ncols + i_col];
-            if (idx == -1) {
-                continue;
-            }
-            prev = curr;
-            curr = &dlmat->data[idx];
-            curr->row_id = i_row;
-            if (!first) {
-                first = curr;
-            }
-            if (prev) {
-                prev->right = curr;
-                curr->left = prev;
-            }
-            last = curr;
-        }
-        /* Rows can be empty */
-        if (first) {
-            first->left = last;
-            last->right = first;
+    /* The sparse matrix already holds only the non-zero elements, so every
+     * row is linked in one pass and appended to the bottom of its columns */
+    for (int i_line = 0; i_line < smat->nlines; ++i_line) {
+        const int beg = smat->offsets[i_line];
+        const int end = smat->offsets[i_line + 1];
+        for (int idx = beg; idx < end; ++idx) {
+            const dlref curr = DL_ELEM(dlmat, idx);
+            const dlref col = DL_HEADER(dlmat, smat->cols[idx]);
+            DL_ROW_ID(dlmat, curr) = smat->ids[i_line];
+            DL_COL(dlmat, curr) = col;
+
+            /* Rows are circular, so the first element links to the last */
+            DL_LEFT(dlmat, curr) = DL_ELEM(dlmat, (idx > beg) ? idx - 1 : end - 1);
+            DL_RIGHT(dlmat, curr) = DL_ELEM(dlmat, (idx < end - 1) ? idx + 1 : beg);
+
+            DL_UP(dlmat, curr) = DL_UP(dlmat, col);
+            DL_DOWN(dlmat, curr) = col;
+            DL_DOWN(dlmat, DL_UP(dlmat, col)) = curr;
+            DL_UP(dlmat, col) = curr;
+            ++DL_SIZE(dlmat, col);
         }
     }
 
-    /* Fill cols */
-    struct dlnode *col;
+    /* Cols must not be empty */
     for (int i_col = 0; i_col < ncols; ++i_col) {
-        first = NULL;
-        last = NULL;
-        prev = NULL;
-        curr = NULL;
-        col = &dlmat->cols[i_col];
-        col->col = col;
-        for (int i_row = 0; i_row < nrows; ++i_row) {
-            const int idx = idcs[i_row * ncols + i_col];
-            if (idx == -1) {
-                continue;
-            }
-            prev = curr;
-            curr = &dlmat->data[idx];
-            curr->col = col;
-            if (!first) {
-                first = curr;
-            }
-            if (prev) {
-                prev->down = curr;
-                curr->up = prev;
-            }
-            last = curr;
-        }
-        /* Cols must not be empty */
-        if (first) {
-            first->up = col;
-            col->down = first;
-            last->down = col;
-            col->up = last;
-        } else {
-            dlmatrix_free(dlmat);
-            dlmat = NULL;
-            break;
+        if (DL_SIZE(dlmat, DL_HEADER(dlmat, i_col)) == 0) {
+            return 0;
         }
     }
 
-    free(idcs);
+    return 1;
+}
 
-    return dlmat;
+struct dlcancel {
+    pthread_mutex_t lock;
+    int raised;
+};
+
+struct dlcancel *
+dlcancel_create(void)
+{
+    struct dlcancel *cancel = malloc(sizeof *cancel);
+    pthread_mutex_init(&cancel->lock, NULL);
+    cancel->raised = 0;
+    return cancel;
+}
+
+void
+dlcancel_free(struct dlcancel *cancel)
+{
+    if (!cancel) {
+        return;
+    }
+    pthread_mutex_destroy(&cancel->lock);
+    free(cancel);
+}
+
+void
+dlcancel_set(struct dlcancel *cancel, int raised)
+{
+    pthread_mutex_lock(&cancel->lock);
+    cancel->raised = raised;
+    pthread_mutex_unlock(&cancel->lock);
+}
+
+/* Returns whether flag CANCEL is raised */
+static int
+dlcancel_raised(struct dlcancel *cancel)
+{
+    pthread_mutex_lock(&cancel->lock);
+    const int raised = cancel->raised;
+    pthread_mutex_unlock(&cancel->lock);
+    return raised;
+}
+
+/* Returns time of the monotonic clock in seconds */
+static double
+dlbounds_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+double
+dlbounds_deadline(const struct dlbounds *bounds)
+{
+    return (bounds->timeout > 0) ? dlbounds_clock() + bounds->timeout : 0;
 }
 
+enum dlabort
+dlbounds_check(const struct dlbounds *bounds, double deadline, long nodes, long *next)
+{
+    const long max_nodes = (bounds->max_nodes > 0) ? bounds->max_nodes : LONG_MAX;
+    if (nodes >= max_nodes) {
+        return DLABORT_NODES;
+    }
+    if (bounds->cancel && dlcancel_raised(bounds->cancel)) {
+        return DLABORT_CANCEL;
+    }
+    if (deadline > 0 && dlbounds_clock() >= deadline) {
+        return DLABORT_DEADLINE;
+    }
+
+    /* Without deadline and flag only the budget is left to watch, which is
+     * checked at every node anyway */
+    *next = max_nodes;
+    if ((deadline > 0 || bounds->cancel) && max_nodes - nodes > DLBOUNDS_POLL_INTERVAL) {
+        *next = nodes + DLBOUNDS_POLL_INTERVAL;
+    }
+    return DLABORT_NONE;
+}
+
+/* State shared by the threads of a parallel search */
+struct dlshared {
+    pthread_mutex_t lock;
+    int next;                   /* Next subproblem to be taken */
+    int nsubs;                  /* Number of subproblems */
+    long nsols;                 /* Solutions found by all threads */
+    long limit;                 /* Cancel search after this many solutions */
+    int ordered;                /* Solutions are stored and merged in
+                                 * subproblem order, so LIMIT only counts those
+                                 * of the subproblems done from the first on */
+    int ndone;                  /* Subproblems done from the first on */
+    long ndonesols;             /* Solutions of these */
+    int *count;                 /* Solutions of each subproblem once it is
+                                 * done, else -1 */
+    long nodes;                 /* Nodes reported by all threads */
+    long max_nodes;             /* Node budget of all threads (0 for none) */
+    int cancel;
+    enum dlabort aborted;       /* Why the search was cancelled, unless it was
+                                 * for reaching LIMIT */
+};
+
 struct dlresult {
-    int tot_rows;
-    int *rows;
-    int ctr;
-    int nsols;
-    struct dlsolution *sols;
+    int depth;                  /* Current depth of search */
+    int base;                   /* Depth the search must not backtrack past */
+    int split;                  /* Depth at which partial solutions are stored
+                                 * as subproblems (-1 for normal search) */
+    int maxdepth;               /* Capacity of STACK and ROWBUF */
+    dlref *stack;               /* Chosen row node per depth */
+    int *rowbuf;                /* Row ids of solution handed to VISIT */
+    long limit;                 /* Stop after this many solutions */
+    int store;                  /* Whether solutions are kept */
+    dlvisitor visit;            /* Called for every solution unless NULL */
+    void *ctx;                  /* Context of VISIT */
+    struct dlshared *shared;    /* Set for workers of a parallel search */
+    struct dlbounds bounds;
+    double deadline;            /* Deadline of the search, 0 for none */
+    long checkpoint;            /* Node count of the next check of BOUNDS and
+                                 * SHARED */
+    long reported;              /* Nodes already added to SHARED */
+    enum dlabort aborted;
+    struct dlstats stats;       /* Counters of the search (see LINKS_STATS) */
+    long count;                 /* Number of solutions found */
+    int nsols;                  /* Number of solutions kept in SOLS */
+    int maxsols;                /* Capacity of SOLS */
+    struct dlsolution *sols;    /* ROWS hold offsets into BUF until the end */
+    int bufsize;
+    int bufcap;
+    int *buf;                   /* Row ids of all solutions back to back */
+    enum dlselect select;
+    int nthreads;
+    uint64_t seed;
+    uint64_t rng;
 };
 
 static struct dlresult *
-dlresult_create(int nrows)
+dlresult_create(const struct dloptions *opts)
 {
     struct dlresult *dlres = malloc(sizeof *dlres);
-    dlres->tot_rows = nrows;
-    dlres->rows = malloc(nrows * sizeof *dlres->rows);
-    dlres->ctr = 0;
+    dlres->depth = 0;
+    dlres->base = 0;
+    dlres->split = -1;
+    dlres->maxdepth = 0;
+    dlres->stack = NULL;
+    dlres->rowbuf = NULL;
+    dlres->limit = LONG_MAX;
+    dlres->store = 1;
+    dlres->visit = NULL;
+    dlres->ctx = NULL;
+    dlres->shared = NULL;
+    if (opts) {
+        dlres->bounds = opts->bounds;
+    } else {
+        memset(&dlres->bounds, 0, sizeof dlres->bounds);
+    }
+    dlres->deadline = 0;
+    dlres->checkpoint = 0;
+    dlres->reported = 0;
+    dlres->aborted = DLABORT_NONE;
+    memset(&dlres->stats, 0, sizeof dlres->stats);
+    dlres->count = 0;
     dlres->nsols = 0;
+    dlres->maxsols = 0;
     dlres->sols = NULL;
+    dlres->bufsize = 0;
+    dlres->bufcap = 0;
+    dlres->buf = NULL;
+    dlres->select = opts ? opts->select : DLSELECT_MRV;
+    dlres->nthreads = opts ? opts->nthreads : 1;
+    /* Xorshift state must never be zero */
+    dlres->seed = (opts && opts->seed) ? opts->seed : UINT64_C(88172645463325252);
+    dlres->rng = dlres->seed;
     return dlres;
 }
 
+/* Prepare DLRES for new search on matrix with NCOLS columns, stopping after
+ * LIMIT solutions, which are kept if STORE is set. No visitor is set. Buffers
+ * are kept and the random state is reseeded, so each search behaves the same
+ * regardless of earlier ones. The bounds and the deadline are left alone, so
+ * the phases of a parallel search share them. */
+static void
+dlresult_reset(struct dlresult *dlres, int ncols, long limit, int store)
+{
+    /* Every level covers at least one column, so the depth is bounded */
+    if (ncols + 1 > dlres->maxdepth) {
+        dlres->maxdepth = ncols + 1;
+        free(dlres->stack);
+        free(dlres->rowbuf);
+        dlres->stack = malloc(dlres->maxdepth * sizeof *dlres->stack);
+        dlres->rowbuf = malloc(dlres->maxdepth * sizeof *dlres->rowbuf);
+    }
+    dlres->depth = 0;
+    dlres->base = 0;
+    dlres->split = -1;
+    dlres->limit = limit;
+    dlres->store = store;
+    dlres->visit = NULL;
+    dlres->ctx = NULL;
+    dlres->shared = NULL;
+    dlres->checkpoint = 0;
+    dlres->reported = 0;
+    dlres->aborted = DLABORT_NONE;
+#if LINKS_STATS
+    memset(&dlres->stats, 0, sizeof dlres->stats);
+#else
+    dlres->stats.nodes = 0;
+#endif
+    dlres->count = 0;
+    dlres->nsols = 0;
+    dlres->bufsize = 0;
+    dlres->rng = dlres->seed;
+}
+
 static void
 dlresult_free(struct dlresult *dlres)
 {
     if (dlres == NULL) {
         return;
     }
-    free(dlres->rows);
+    free(dlres->stack);
+    free(dlres->rowbuf);
+    free(dlres->sols);
+    free(dlres->buf);
     free(dlres);
 }
 
-static void
-dlresult_add(struct dlresult *dlres, int row_id)
+/* Append room for new solution of NROWS rows to DLRES. Returns pointer to
+ * the rows to be filled in. */
+static int *
+dlresult_new_solution(struct dlresult *dlres, int nrows)
 {
-    dlres->rows[dlres->ctr] = row_id;
-    ++dlres->ctr;
+    /* Buffers grow geometrically, so storing solutions rarely allocates */
+    if (dlres->nsols == dlres->maxsols) {
+        dlres->maxsols = dlres->maxsols ? 2 * dlres->maxsols : 4;
+        dlres->sols = realloc(dlres->sols, dlres->maxsols * sizeof *dlres->sols);
+    }
+    if (dlres->bufsize + nrows > dlres->bufcap) {
+        while (dlres->bufsize + nrows > dlres->bufcap) {
+            dlres->bufcap = dlres->bufcap ? 2 * dlres->bufcap : 4 * nrows + 4;
+        }
+        dlres->buf = realloc(dlres->buf, dlres->bufcap * sizeof *dlres->buf);
+    }
+
+    int *rows = &dlres->buf[dlres->bufsize];
+    dlres->sols[dlres->nsols].nrows = nrows;
+    dlres->sols[dlres->nsols].rows = NULL;
+    dlres->bufsize += nrows;
+    ++dlres->nsols;
+
+    return rows;
 }
 
-static void
-dlresult_remove(struct dlresult *dlres, int row_id)
+/* Count rows on stack of DLRES as new solution of DLMAT, store them if
+ * solutions are kept and hand them to the visitor. Returns zero if the search
+ * should stop. */
+static int
+dlresult_add_solution(struct dlresult *dlres, const struct dlmatrix *dlmat)
 {
-    int found = 0;
-    --dlres->ctr;
-    for (int i = 0; i < dlres->ctr; ++i) {
-        if (!found && dlres->rows[i] == row_id) {
-            found = 1;
+    const int depth = dlres->depth;
+
+    if (dlres->split >= 0) {
+        /* Subproblems are stored as node indices, which are the same in every
+         * copy of the matrix */
+        int *rows = dlresult_new_solution(dlres, depth);
+        for (int i = 0; i < depth; ++i) {
+            rows[i] = DL_ELEM_INDEX(dlmat, dlres->stack[i]);
         }
-        if (found) {
-            dlres->rows[i] = dlres->rows[i + 1];
+        return 1;
+    }
+
+    /* Threads of a parallel search count and visit one at a time, and drop
+     * solutions found after the search was cancelled */
+    struct dlshared *shared = dlres->shared;
+    if (shared) {
+        pthread_mutex_lock(&shared->lock);
+        if (shared->cancel) {
+            pthread_mutex_unlock(&shared->lock);
+            return 0;
         }
     }
-    if (!found) {
-        if (dlres->rows[dlres->ctr] != row_id) {
-            fprintf(stderr, "Row id not found!");
-            exit(EXIT_FAILURE);
+
+    ++dlres->count;
+    if (dlres->store) {
+        int *rows = dlresult_new_solution(dlres, depth);
+        for (int i = 0; i < depth; ++i) {
+            rows[i] = DL_ROW_ID(dlmat, dlres->stack[i]);
         }
     }
+    int stop = dlres->count >= dlres->limit;
+    if (dlres->visit) {
+        for (int i = 0; i < depth; ++i) {
+            dlres->rowbuf[i] = DL_ROW_ID(dlmat, dlres->stack[i]);
+        }
+        stop |= dlres->visit(dlres->rowbuf, depth, dlres->ctx) != 0;
+    }
+
+    if (shared) {
+        if (!shared->ordered && (++shared->nsols >= shared->limit || stop)) {
+            shared->cancel = 1;
+        }
+        pthread_mutex_unlock(&shared->lock);
+    }
+
+    return !stop;
 }
 
+/* Point rows of solutions in DLRES into the row buffer. Done once the search
+ * has finished since the buffer may move while it grows. */
 static void
-dlresult_add_solution(struct dlresult *dlres)
+dlresult_finish(struct dlresult *dlres)
 {
-    const int nsols = ++dlres->nsols;
-    if (dlres->sols) {
-        /* The reallocs should be okay here */
-        dlres->sols = realloc(dlres->sols, nsols * sizeof *dlres->sols);
-    } else {
-        dlres->sols = malloc(nsols * sizeof *dlres->sols);
+    int offset = 0;
+    for (int i = 0; i < dlres->nsols; ++i) {
+        dlres->sols[i].rows = &dlres->buf[offset];
+        offset += dlres->sols[i].nrows;
     }
-    int *rows = malloc(dlres->ctr * sizeof *rows);
-    rows = memcpy(rows, dlres->rows, dlres->ctr * sizeof *rows);
-    dlres->sols[nsols - 1].nrows = dlres->ctr;
-    dlres->sols[nsols - 1].rows = rows;
 }
 
-/* Knuth's dancing links algorithm */
+/* Advance random state of DLRES and return next pseudo-random number. Each
+ * search keeps its own state, so concurrent searches don't interfere. */
+static uint64_t
+dlresult_random(struct dlresult *dlres)
+{
+    uint64_t x = dlres->rng;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    dlres->rng = x;
+    return x;
+}
+
+/* Choose next column to branch on in DLMAT according to the selection policy
+ * of DLRES. Returns the header if no column is left. */
+static dlref
+dlresult_select_column(struct dlresult *dlres, struct dlmatrix *dlmat)
+{
+    const dlref head = DL_ROOT(dlmat);
+
+    if (dlres->select == DLSELECT_FIRST || DL_RIGHT(dlmat, head) == head) {
+        return DL_RIGHT(dlmat, head);
+    }
+
+    dlref best = DL_RIGHT(dlmat, head);
+    int bsize = DL_SIZE(dlmat, best);
+    int nties = 1;
+    for (dlref col = DL_RIGHT(dlmat, best); col != head; col = DL_RIGHT(dlmat, col)) {
+        if (bsize == 0) {
+            break;
+        }
+        const int size = DL_SIZE(dlmat, col);
+        if (size < bsize) {
+            best = col;
+            bsize = size;
+            nties = 1;
+        } else if (size == bsize && dlres->select == DLSELECT_MRV_RANDOM) {
+            /* Reservoir sampling picks each tied column with equal chance */
+            ++nties;
+            if (dlresult_random(dlres) % nties == 0) {
+                best = col;
+            }
+        }
+    }
+
+    return best;
+}
+
+/* Check search DLRES against its bounds, which is due once its node count
+ * reaches the checkpoint. Workers of a parallel search also add their nodes to
+ * the shared count, which the node budget then applies to, and learn whether
+ * another thread has cancelled the search. Returns non-zero if the search
+ * must stop. */
+static int
+dlresult_check(struct dlresult *dlres)
+{
+    const long nodes = dlres->stats.nodes;
+    enum dlabort aborted = dlbounds_check(&dlres->bounds, dlres->deadline, nodes,
+                                          &dlres->checkpoint);
+
+    struct dlshared *shared = dlres->shared;
+    if (!shared) {
+        dlres->aborted = aborted;
+        return aborted != DLABORT_NONE;
+    }
+
+    if (dlres->checkpoint - nodes > DLBOUNDS_POLL_INTERVAL) {
+        dlres->checkpoint = nodes + DLBOUNDS_POLL_INTERVAL;
+    }
+    pthread_mutex_lock(&shared->lock);
+    shared->nodes += nodes - dlres->reported;
+    dlres->reported = nodes;
+    if (aborted == DLABORT_NONE && shared->max_nodes > 0
+        && shared->nodes >= shared->max_nodes) {
+        aborted = DLABORT_NODES;
+    }
+    if (aborted != DLABORT_NONE && !shared->cancel) {
+        shared->cancel = 1;
+        shared->aborted = aborted;
+    }
+    const int cancel = shared->cancel;
+    pthread_mutex_unlock(&shared->lock);
+    return cancel;
+}
+
+/* Knuth's dancing links algorithm. The recursion is unrolled into a loop over
+ * an explicit stack of chosen rows, so backtracking is a pop and the search
+ * does not allocate (apart from growing the solution buffers). */
 static void
 dlresult_search(struct dlresult *dlres, struct dlmatrix *dlmat)
 {
-    if (dlres->nsols == 1024) {
-        /* Sneaky valgrind easter egg */
-        fprintf(stderr, "More than 1024 solutions found! Go fix your sudoku!\n");
+    dlref *stack = dlres->stack;
+    int stop = 0;
+
+    for (;;) {
+        /* Open new level: choose column and try its first row */
+        dlref row = DL_NONE;
+        ++dlres->stats.nodes;
+        DL_STAT(++dlres->stats.depth_nodes[DL_STAT_DEPTH(dlres->depth)]);
+        DL_STAT(if (dlres->depth > dlres->stats.maxdepth) {
+                    dlres->stats.maxdepth = dlres->depth;
+                });
+
+        if (dlres->stats.nodes >= dlres->checkpoint) {
+            stop = dlresult_check(dlres);
+        }
+
+        if (!stop && dlres->depth == dlres->split) {
+            stop = !dlresult_add_solution(dlres, dlmat);
+        } else if (!stop) {
+            const dlref col = dlresult_select_column(dlres, dlmat);
+            if (col == DL_ROOT(dlmat)) {
+                stop = !dlresult_add_solution(dlres, dlmat);
+            } else if (DL_SIZE(dlmat, col) > 0) {
+                /* Columns of size zero can no longer be satisfied */
+                dlmatrix_cover_column(dlmat, col);
+                row = DL_DOWN(dlmat, col);
+            } else {
+                DL_STAT(++dlres->stats.deadends);
+            }
+        }
+
+        /* Backtrack until some level has a row left to try. Headers are their
+         * own column, so ROW == COL(ROW) marks an exhausted level. */
+        while (row == DL_NONE || row == DL_COL(dlmat, row) || stop) {
+            if (row != DL_NONE) {
+                dlmatrix_uncover_column(dlmat, row);
+            }
+            if (dlres->depth == dlres->base) {
+                return;
+            }
+            row = stack[--dlres->depth];
+            for (dlref ptr = DL_LEFT(dlmat, row); ptr != row; ptr = DL_LEFT(dlmat, ptr)) {
+                dlmatrix_uncover_column(dlmat, ptr);
+            }
+            row = DL_DOWN(dlmat, row);
+        }
+
+        DL_STAT(++dlres->stats.depth_branches[DL_STAT_DEPTH(dlres->depth)]);
+        stack[dlres->depth++] = row;
+        for (dlref ptr = DL_RIGHT(dlmat, row); ptr != row; ptr = DL_RIGHT(dlmat, ptr)) {
+            dlmatrix_cover_column(dlmat, ptr);
+        }
+    }
+}
+
+/* Cover all columns of row ROW of DLMAT, as the search does when it picks
+ * ROW */
+static void
+dlmatrix_cover_row(struct dlmatrix *dlmat, dlref row)
+{
+    dlmatrix_cover_column(dlmat, row);
+    for (dlref ptr = DL_RIGHT(dlmat, row); ptr != row; ptr = DL_RIGHT(dlmat, ptr)) {
+        dlmatrix_cover_column(dlmat, ptr);
+    }
+}
+
+/* Undo `dlmatrix_cover_row' */
+static void
+dlmatrix_uncover_row(struct dlmatrix *dlmat, dlref row)
+{
+    for (dlref ptr = DL_LEFT(dlmat, row); ptr != row; ptr = DL_LEFT(dlmat, ptr)) {
+        dlmatrix_uncover_column(dlmat, ptr);
+    }
+    dlmatrix_uncover_column(dlmat, row);
+}
+
+/* Cover columns of row ROW of DLMAT and push it onto the stack of DLRES */
+static void
+dlresult_push_row(struct dlresult *dlres, struct dlmatrix *dlmat, dlref row)
+{
+    dlmatrix_cover_row(dlmat, row);
+    dlres->stack[dlres->depth++] = row;
+}
+
+/* Pop rows off the stack of DLRES down to depth DEPTH and uncover their
+ * columns of DLMAT in reverse order */
+static void
+dlresult_unwind(struct dlresult *dlres, struct dlmatrix *dlmat, int depth)
+{
+    while (dlres->depth > depth) {
+        dlmatrix_uncover_row(dlmat, dlres->stack[--dlres->depth]);
+    }
+    dlres->base = 0;
+}
+
+/* Parallel search aims at this many subproblems per thread, so threads that
+ * draw easy subtrees can keep taking new ones */
+#define DLSPLIT_TASKS_PER_THREAD 16
+
+/* Deepest level the search tree is split at */
+#define DLSPLIT_MAX_DEPTH 8
+
+/* Worker of a parallel search. Each one owns a copy of the matrix and takes
+ * subproblems from the shared queue until it is empty or cancelled. */
+struct dlworker {
+    pthread_t thread;
+    int id;
+    struct dlshared *shared;
+    const struct dlresult *subs;    /* Subproblems as node index prefixes */
+    struct dlmatrix *dlmat;
+    struct dlresult *dlres;
+    int *owner;                     /* Worker that solved each subproblem */
+    int *first;                     /* Index of its first solution there */
+};
+
+/* Cover rows of subproblem SUB in matrix of WORKER and push them onto its
+ * stack, in the same order the search would have done it */
+static void
+dlworker_apply(struct dlworker *worker, const struct dlsolution *sub)
+{
+    struct dlresult *dlres = worker->dlres;
+    for (int i = 0; i < sub->nrows; ++i) {
+        dlresult_push_row(dlres, worker->dlmat, DL_ELEM(worker->dlmat, sub->rows[i]));
+    }
+    dlres->base = dlres->depth;
+}
+
+static void *
+dlworker_run(void *arg)
+{
+    struct dlworker *worker = arg;
+    struct dlshared *shared = worker->shared;
+
+    for (;;) {
+        pthread_mutex_lock(&shared->lock);
+        const int sub = shared->next++;
+        const int cancel = shared->cancel;
+        pthread_mutex_unlock(&shared->lock);
+        if (sub >= shared->nsubs || cancel) {
+            break;
+        }
+
+        struct dlresult *dlres = worker->dlres;
+        worker->owner[sub] = worker->id;
+        worker->first[sub] = dlres->nsols;
+        if (shared->ordered) {
+            /* No subproblem needs more solutions than all of them together */
+            dlres->limit = (shared->limit < LONG_MAX - dlres->count)
+                ? dlres->count + shared->limit : LONG_MAX;
+        }
+
+        dlworker_apply(worker, &worker->subs->sols[sub]);
+        dlresult_search(dlres, worker->dlmat);
+        dlresult_unwind(dlres, worker->dlmat, 0);
+
+        /* Once the subproblems from the first on have enough solutions, the
+         * later ones are not needed */
+        pthread_mutex_lock(&shared->lock);
+        shared->count[sub] = dlres->nsols - worker->first[sub];
+        while (shared->ndone < shared->nsubs && shared->count[shared->ndone] >= 0) {
+            shared->ndonesols += shared->count[shared->ndone++];
+        }
+        if (shared->ordered && shared->ndonesols >= shared->limit) {
+            shared->cancel = 1;
+        }
+        pthread_mutex_unlock(&shared->lock);
+
+        if (!shared->ordered && dlres->count >= dlres->limit) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/* Search DLMAT on NTHREADS threads for up to LIMIT solutions, which are
+ * stored in DLRES if it keeps them. Rows already on the stack of DLRES stay
+ * chosen, but are popped once the search is over. The top levels of the
+ * search tree are enumerated into independent subproblems, which threads
+ * take from a shared queue. Stored solutions are merged in subproblem order,
+ * and LIMIT only cancels the search once the subproblems from the first on
+ * have that many, so they are the first LIMIT of a serial search in the same
+ * order, unless it was aborted. Solutions that are only counted or visited
+ * stop the search once LIMIT of them are found by any threads. */
+static void
+dlresult_search_parallel(struct dlresult *dlres, struct dlmatrix *dlmat,
+                         const struct smatrix *smat, int nthreads)
+{
+    const long limit = dlres->limit;
+    const int store = dlres->store;
+    const dlvisitor visit = dlres->visit;
+    void *ctx = dlres->ctx;
+
+    /* Split deeper until there are enough subproblems to balance the load.
+     * Every subproblem starts with the rows chosen up front. */
+    const int nfixed = dlres->depth;
+    const struct dlbounds bounds = dlres->bounds;
+    enum dlabort aborted = DLABORT_NONE;
+    struct dlstats stats;
+    memset(&stats, 0, sizeof stats);
+    for (int split = 1; split <= DLSPLIT_MAX_DEPTH; ++split) {
+        dlresult_reset(dlres, dlmat->ncols, LONG_MAX, 1);
+        dlres->depth = nfixed;
+        dlres->base = nfixed;
+        dlres->split = nfixed + split;
+        /* Splitting takes its nodes from the budget too; a phase that does
+         * not abort leaves at least one node */
+        if (bounds.max_nodes > 0) {
+            dlres->bounds.max_nodes = bounds.max_nodes - stats.nodes;
+        }
+        dlresult_search(dlres, dlmat);
+        dlstats_add(&stats, &dlres->stats);
+        aborted = dlres->aborted;
+        if (aborted != DLABORT_NONE || dlres->nsols == 0
+            || dlres->nsols >= DLSPLIT_TASKS_PER_THREAD * nthreads) {
+            break;
+        }
+    }
+    dlres->bounds = bounds;
+    dlresult_finish(dlres);
+    dlresult_unwind(dlres, dlmat, 0);
+
+    if (aborted != DLABORT_NONE) {
+        dlresult_reset(dlres, dlmat->ncols, limit, store);
+        dlres->stats = stats;
+        dlres->aborted = aborted;
         return;
     }
-    
-    struct dlnode *col = dlmat->head.right;
 
-    if (col == &dlmat->head) {
-        dlresult_add_solution(dlres);
+    /* The budget is shared from here on, so workers only watch the deadline
+     * and the cancellation flag on their own */
+    struct dlshared shared;
+    pthread_mutex_init(&shared.lock, NULL);
+    shared.next = 0;
+    shared.nsubs = dlres->nsols;
+    shared.nsols = 0;
+    shared.limit = limit;
+    shared.ordered = store && !visit;
+    shared.ndone = 0;
+    shared.ndonesols = 0;
+    shared.nodes = stats.nodes;
+    shared.max_nodes = bounds.max_nodes;
+    shared.cancel = 0;
+    shared.aborted = DLABORT_NONE;
+
+    int *owner = malloc((shared.nsubs + 1) * sizeof *owner);
+    int *first = malloc((shared.nsubs + 1) * sizeof *first);
+    int *count = malloc((shared.nsubs + 1) * sizeof *count);
+    for (int i = 0; i < shared.nsubs; ++i) {
+        owner[i] = -1;
+        count[i] = -1;
+    }
+    shared.count = count;
+
+    /* The calling thread works as worker 0 on the matrix it already has */
+    struct dlworker *workers = malloc(nthreads * sizeof *workers);
+    for (int i = 0; i < nthreads; ++i) {
+        struct dlworker *worker = &workers[i];
+        worker->id = i;
+        worker->shared = &shared;
+        worker->subs = dlres;
+        worker->owner = owner;
+        worker->first = first;
+        if (i == 0) {
+            worker->dlmat = dlmat;
+        } else {
+            worker->dlmat = dlmatrix_create();
+            dlmatrix_load(worker->dlmat, smat);
+        }
+        worker->dlres = malloc(sizeof *worker->dlres);
+        *worker->dlres = *dlres;
+        worker->dlres->stack = NULL;
+        worker->dlres->rowbuf = NULL;
+        worker->dlres->maxdepth = 0;
+        worker->dlres->sols = NULL;
+        worker->dlres->maxsols = 0;
+        worker->dlres->buf = NULL;
+        worker->dlres->bufcap = 0;
+        dlresult_reset(worker->dlres, dlmat->ncols, limit, store);
+        worker->dlres->visit = visit;
+        worker->dlres->ctx = ctx;
+        worker->dlres->shared = &shared;
+        worker->dlres->bounds.max_nodes = 0;
+    }
+    for (int i = 1; i < nthreads; ++i) {
+        pthread_create(&workers[i].thread, NULL, &dlworker_run, &workers[i]);
+    }
+    dlworker_run(&workers[0]);
+    for (int i = 1; i < nthreads; ++i) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    /* Merge solutions of all workers in subproblem order */
+    const int nsubs = shared.nsubs;
+    long total = 0;
+    for (int i = 0; i < nthreads; ++i) {
+        dlresult_finish(workers[i].dlres);
+        total += workers[i].dlres->count;
+        dlstats_add(&stats, &workers[i].dlres->stats);
+        if (i > 0) {
+            stats.updates += workers[i].dlmat->nupdates;
+        }
+    }
+    dlresult_reset(dlres, dlmat->ncols, limit, store);
+    dlres->count = (total < limit) ? total : limit;
+    dlres->stats = stats;
+    dlres->aborted = shared.aborted;
+    for (int sub = 0; sub < nsubs && store && dlres->nsols < limit; ++sub) {
+        if (owner[sub] < 0) {
+            continue;
+        }
+        const struct dlresult *wres = workers[owner[sub]].dlres;
+        const int end = first[sub] + count[sub];
+        for (int i = first[sub]; i < end && dlres->nsols < limit; ++i) {
+            int *rows = dlresult_new_solution(dlres, wres->sols[i].nrows);
+            memcpy(rows, wres->sols[i].rows, wres->sols[i].nrows * sizeof *rows);
+        }
+    }
+
+    for (int i = 0; i < nthreads; ++i) {
+        if (i > 0) {
+            dlmatrix_free(workers[i].dlmat);
+        }
+        dlresult_free(workers[i].dlres);
+    }
+    free(workers);
+    free(owner);
+    free(first);
+    free(count);
+    pthread_mutex_destroy(&shared.lock);
+}
+
+struct dlsolver {
+    struct dlmatrix *dlmat;
+    struct dlresult *dlres;
+    const struct smatrix *smat;     /* Matrix loaded by `dlsolver_load' */
+    int maxrows;                    /* Capacity of ROWMAP */
+    int *rowmap;                    /* First element of each row id, or -1 */
+    int nkept;                      /* Number of rows fixed by `dlsolver_fix' */
+    int maxkept;                    /* Capacity of KEPT */
+    dlref *kept;                    /* Rows fixed by `dlsolver_fix', covered in
+                                     * DLMAT in this order */
+};
+
+struct dlsolver *
+dlsolver_create(const struct dloptions *opts)
+{
+    struct dlsolver *dls = malloc(sizeof *dls);
+    dls->dlmat = dlmatrix_create();
+    dls->dlres = dlresult_create(opts);
+    dls->smat = NULL;
+    dls->maxrows = 0;
+    dls->rowmap = NULL;
+    dls->nkept = 0;
+    dls->maxkept = 0;
+    dls->kept = NULL;
+    return dls;
+}
+
+void
+dlsolver_free(struct dlsolver *dls)
+{
+    if (!dls) {
         return;
     }
+    dlmatrix_free(dls->dlmat);
+    dlresult_free(dls->dlres);
+    free(dls->rowmap);
+    free(dls->kept);
+    free(dls);
+}
+
+/* Finish search of DLS: point solutions into their buffer and complete the
+ * statistics */
+static void
+dlsolver_finish(struct dlsolver *dls)
+{
+    dlresult_finish(dls->dlres);
+    dls->dlres->stats.solutions = dls->dlres->count;
+    dls->dlres->stats.updates += dls->dlmat->nupdates;
+    dls->dlmat->nupdates = 0;
+}
+
+/* Search SMAT with DLS for up to LIMIT solutions (0 for no limit), keeping
+ * them if STORE is set and calling VISIT with context CTX for each one unless
+ * it is NULL. Returns number of solutions found. */
+static long
+dlsolver_run(struct dlsolver *dls, const struct smatrix *smat, long limit, int store,
+             dlvisitor visit, void *ctx)
+{
+    dlresult_reset(dls->dlres, smat->ncols, (limit > 0) ? limit : LONG_MAX, store);
+    dls->dlres->deadline = dlbounds_deadline(&dls->dlres->bounds);
+    dls->dlres->visit = visit;
+    dls->dlres->ctx = ctx;
+    dls->smat = NULL;
+    dls->nkept = 0;
+    if (!dlmatrix_load(dls->dlmat, smat)) {
+        return 0;
+    }
+
+    if (dls->dlres->nthreads > 1) {
+        dlresult_search_parallel(dls->dlres, dls->dlmat, smat, dls->dlres->nthreads);
+    } else {
+        dlresult_search(dls->dlres, dls->dlmat);
+    }
+    dlsolver_finish(dls);
+
+    return dls->dlres->count;
+}
+
+int
+dlsolver_solve(struct dlsolver *dls, const struct smatrix *smat, int limit)
+{
+    return (int) dlsolver_run(dls, smat, limit, 1, NULL, NULL);
+}
+
+int
+dlsolver_load(struct dlsolver *dls, const struct smatrix *smat)
+{
+    if (smat->nrows > dls->maxrows) {
+        dls->maxrows = smat->nrows;
+        free(dls->rowmap);
+        dls->rowmap = malloc(dls->maxrows * sizeof *dls->rowmap);
+    }
+    for (int i = 0; i < smat->nrows; ++i) {
+        dls->rowmap[i] = -1;
+    }
+    for (int i_line = 0; i_line < smat->nlines; ++i_line) {
+        if (smat->offsets[i_line] < smat->offsets[i_line + 1]) {
+            dls->rowmap[smat->ids[i_line]] = smat->offsets[i_line];
+        }
+    }
+
+    /* Every fixed row covers a column of its own */
+    if (smat->ncols > dls->maxkept) {
+        dls->maxkept = smat->ncols;
+        free(dls->kept);
+        dls->kept = malloc(dls->maxkept * sizeof *dls->kept);
+    }
+    dls->nkept = 0;
 
-    dlnode_cover_column(col);
-      
-    for (struct dlnode *row = col->down; row != col; row = row->down) {
-        dlresult_add(dlres, row->row_id);
+    dls->smat = smat;
+    return dlmatrix_load(dls->dlmat, smat);
+}
 
-        for (struct dlnode *ptr = row->right; ptr != row; ptr = ptr->right) {
-            dlnode_cover_column(ptr);
+/* Returns whether no column of row ROW of DLMAT is covered. A covered header
+ * is skipped by its left neighbour. */
+static int
+dlmatrix_row_free(const struct dlmatrix *dlmat, dlref row)
+{
+    dlref ptr = row;
+    do {
+        const dlref col = DL_COL(dlmat, ptr);
+        if (DL_RIGHT(dlmat, DL_LEFT(dlmat, col)) != col) {
+            return 0;
         }
+        ptr = DL_RIGHT(dlmat, ptr);
+    } while (ptr != row);
+    return 1;
+}
 
-        dlresult_search(dlres, dlmat);
-        dlresult_remove(dlres, row->row_id);
+/* Returns first element of the row with id ID of the matrix loaded into DLS
+ * if it exists and none of its columns is covered, DL_NONE otherwise */
+static dlref
+dlsolver_free_row(const struct dlsolver *dls, int id)
+{
+    const struct dlmatrix *dlmat = dls->dlmat;
+    const int elem = (id >= 0 && id < dlmat->nrows) ? dls->rowmap[id] : -1;
+    if (elem < 0 || !dlmatrix_row_free(dlmat, DL_ELEM(dlmat, elem))) {
+        return DL_NONE;
+    }
+    return DL_ELEM(dlmat, elem);
+}
+
+int
+dlsolver_solve_fixed(struct dlsolver *dls, const int *fixed, int nfixed, int limit)
+{
+    struct dlresult *dlres = dls->dlres;
+    struct dlmatrix *dlmat = dls->dlmat;
 
-        for (struct dlnode *ptr = row->left; ptr != row; ptr = ptr->left) {
-            dlnode_uncover_column(ptr);
+    dlresult_reset(dlres, dlmat->ncols, (limit > 0) ? limit : LONG_MAX, 1);
+    dlres->deadline = dlbounds_deadline(&dlres->bounds);
+    if (dls->smat == NULL) {
+        return 0;
+    }
+
+    /* Rows kept by `dlsolver_fix' are covered already and only go onto the
+     * stack, so they are part of the solutions */
+    const int nkept = dls->nkept;
+    for (int i = 0; i < nkept; ++i) {
+        dlres->stack[dlres->depth++] = dls->kept[i];
+    }
+
+    /* Choose the fixed rows as the search would, which leaves the matrix of
+     * the remaining problem; rows clashing with each other have no solution */
+    for (int i = 0; i < nfixed; ++i) {
+        const dlref row = dlsolver_free_row(dls, fixed[i]);
+        if (row == DL_NONE) {
+            dlresult_unwind(dlres, dlmat, nkept);
+            return 0;
         }
+        dlresult_push_row(dlres, dlmat, row);
+    }
+    dlres->base = dlres->depth;
 
+    if (dlres->nthreads > 1) {
+        /* The parallel search pops all rows, kept ones included */
+        dlresult_search_parallel(dlres, dlmat, dls->smat, dlres->nthreads);
+        for (int i = 0; i < nkept; ++i) {
+            dlmatrix_cover_row(dlmat, dls->kept[i]);
+        }
+    } else {
+        dlresult_search(dlres, dlmat);
+        dlresult_unwind(dlres, dlmat, nkept);
     }
+    dlsolver_finish(dls);
 
-    dlnode_uncover_column(col);
+    return (int) dlres->count;
 }
 
-struct dlsolution *
-dlsolution_find(const struct bmatrix *bmat, int *nsols)
+int
+dlsolver_fix(struct dlsolver *dls, int id)
 {
-    struct dlmatrix *dlmat = dlmatrix_create(bmat);
-    if (!dlmat) {
-        *nsols = 0;
-        return NULL;
+    if (dls->smat == NULL) {
+        return 0;
     }
-    struct dlresult *dlres = dlresult_create(bmat->nrows);
+    const dlref row = dlsolver_free_row(dls, id);
+    if (row == DL_NONE) {
+        return 0;
+    }
+    dlmatrix_cover_row(dls->dlmat, row);
+    dls->kept[dls->nkept++] = row;
+    return 1;
+}
 
-    dlresult_search(dlres, dlmat);
+int
+dlsolver_unfix(struct dlsolver *dls, int id)
+{
+    struct dlmatrix *dlmat = dls->dlmat;
 
-    struct dlsolution *sols = dlres->sols;
-    dlres->sols = NULL;
-    *nsols = dlres->nsols;
-    
-    dlresult_free(dlres);
-    dlmatrix_free(dlmat);
+    int pos = dls->nkept - 1;
+    while (pos >= 0 && DL_ROW_ID(dlmat, dls->kept[pos]) != id) {
+        --pos;
+    }
+    if (pos < 0) {
+        return 0;
+    }
+
+    /* Links are only restored correctly in reverse order of covering, so the
+     * rows fixed later are taken back as well and then covered again */
+    for (int i = dls->nkept - 1; i >= pos; --i) {
+        dlmatrix_uncover_row(dlmat, dls->kept[i]);
+    }
+    --dls->nkept;
+    for (int i = pos; i < dls->nkept; ++i) {
+        dls->kept[i] = dls->kept[i + 1];
+        dlmatrix_cover_row(dlmat, dls->kept[i]);
+    }
+    return 1;
+}
+
+long
+dlsolver_count(struct dlsolver *dls, const struct smatrix *smat, long limit)
+{
+    return dlsolver_run(dls, smat, limit, 0, NULL, NULL);
+}
+
+long
+dlsolver_visit(struct dlsolver *dls, const struct smatrix *smat, dlvisitor visit,
+               void *ctx)
+{
+    return dlsolver_run(dls, smat, 0, 0, visit, ctx);
+}
+
+const struct dlsolution *
+dlsolver_solutions(const struct dlsolver *dls)
+{
+    return dls->dlres->sols;
+}
+
+const struct dlstats *
+dlsolver_stats(const struct dlsolver *dls)
+{
+    return &dls->dlres->stats;
+}
+
+enum dlabort
+dlsolver_aborted(const struct dlsolver *dls)
+{
+    return dls->dlres->aborted;
+}
+
+int
+dlstats_enabled(void)
+{
+    return LINKS_STATS;
+}
+
+void
+dlstats_add(struct dlstats *stats, const struct dlstats *other)
+{
+    stats->nodes += other->nodes;
+    stats->solutions += other->solutions;
+    stats->deadends += other->deadends;
+    stats->updates += other->updates;
+    if (other->maxdepth > stats->maxdepth) {
+        stats->maxdepth = other->maxdepth;
+    }
+    for (int i = 0; i < DLSTATS_DEPTHS; ++i) {
+        stats->depth_nodes[i] += other->depth_nodes[i];
+        stats->depth_branches[i] += other->depth_branches[i];
+    }
+}
+
+long
+dlsolution_visit(const struct smatrix *smat, const struct dloptions *opts,
+                 dlvisitor visit, void *ctx)
+{
+    struct dlsolver *dls = dlsolver_create(opts);
+    const long count = dlsolver_visit(dls, smat, visit, ctx);
+    dlsolver_free(dls);
+    return count;
+}
+
+struct dlsolution *
+dlsolution_find(const struct smatrix *smat, const struct dloptions *opts,
+                int max_solutions, int *nsols)
+{
+    /* Solutions are stored by the search rather than collected by a visitor,
+     * so a split search merges them in subproblem order */
+    struct dlsolver *dls = dlsolver_create(opts);
+    dlsolver_solve(dls, smat, max_solutions);
+    *nsols = dls->dlres->nsols;
+
+    /* All solutions share the single row buffer, which is owned by the first
+     * one (see `dlsolution_free') */
+    struct dlsolution *sols = NULL;
+    if (*nsols > 0) {
+        sols = dls->dlres->sols;
+        dls->dlres->sols = NULL;
+        dls->dlres->buf = NULL;
+    }
+
+    dlsolver_free(dls);
 
     return sols;
 }
 
-/* Integer comparison function for `qsort' */
-static int
-cmpfnc(const void *a, const void *b)
+long
+dlsolution_count(const struct smatrix *smat, const struct dloptions *opts,
+                 long max_solutions)
 {
-    return (*(int *) a - *(int *) b);
+    /* Counting needs no row ids, so the visitor is skipped altogether */
+    struct dlsolver *dls = dlsolver_create(opts);
+    const long count = dlsolver_count(dls, smat, max_solutions);
+    dlsolver_free(dls);
+    return count;
+}
+
+void
+dlsolution_free(struct dlsolution *sols, int nsols)
+{
+    if (!sols) {
+        return;
+    }
+    if (nsols > 0) {
+        free(sols[0].rows);
+    }
+    free(sols);
 }
 
 struct bmatrix *
@@ -335,30 +1373,18 @@ bmatrix_from_dlsolution(const struct dlsolution *dlsol, const struct bmatrix *bm
 {
     struct bmatrix *res = malloc(sizeof *res);
 
-    const int nrows = bmat->nrows;
     const int ncols = bmat->ncols;
 
-    res->nrows = nrows;
+    res->nrows = bmat->nrows;
     res->ncols = ncols;
-    res->data = malloc(nrows * ncols * sizeof *bmat->data);
-    res->data = memcpy(res->data, bmat->data, nrows * ncols * sizeof *res->data);
-
-    /* Eliminate rows */
-    int nsolrows = dlsol->nrows;
-    int *solrows = dlsol->rows;
-    qsort(solrows, nsolrows, sizeof *solrows, &cmpfnc);
-    int ctr = 0;
-    int nextrow = solrows[0];
-    for (int i_row = 0; i_row < nrows; ++i_row) {
-        if (i_row == nextrow) {
-            ++ctr;
-            nextrow = (ctr == nsolrows) ? nrows : solrows[ctr];
-            continue;
-        }
-        for (int i_col = 0; i_col < ncols; ++i_col) {
-            res->data[i_row * ncols + i_col] = 0;
-        }
+    res->data = calloc((size_t) res->nrows * ncols, sizeof *res->data);
+
+    /* Copy solution rows only; all others stay zero */
+    for (int i = 0; i < dlsol->nrows; ++i) {
+        const size_t row = dlsol->rows[i];
+        memcpy(&res->data[row * ncols], &bmat->data[row * ncols],
+               ncols * sizeof *res->data);
     }
 
     return res;
-}
\ No newline at end of file
+}
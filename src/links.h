@@ -8,16 +8,216 @@
 #define LINKS_H
 
 #include "bmatrix.h"
+#include "smatrix.h"
+
+/* Policies to choose the column to branch on during the search */
+enum dlselect {
+    DLSELECT_FIRST,         /* Leftmost uncovered column */
+    DLSELECT_MRV,           /* Column with fewest remaining rows */
+    DLSELECT_MRV_RANDOM     /* As DLSELECT_MRV, but ties are broken at random */
+};
+
+/* Flag another thread can raise to cancel the searches bounded by it */
+struct dlcancel;
+
+/* Bounds of a single search. A search that runs into one of them stops early
+ * and is aborted, with the statistics of the part it searched. */
+struct dlbounds {
+    long max_nodes;             /* Node budget (0 for no limit) */
+    double timeout;             /* Seconds from the start of the search until
+                                 * its deadline (0 for no limit) */
+    struct dlcancel *cancel;    /* Aborts the search once raised, unless NULL */
+};
+
+/* Reasons a search was aborted */
+enum dlabort {
+    DLABORT_NONE,       /* Search was not aborted */
+    DLABORT_NODES,      /* Node budget used up */
+    DLABORT_DEADLINE,   /* Deadline passed */
+    DLABORT_CANCEL      /* Cancellation flag raised */
+};
+
+/* Number of search nodes between two checks of the deadline and the
+ * cancellation flag. The node budget is checked at every node, but threads of
+ * a parallel search only add up their nodes at these checks, so together they
+ * may overshoot the budget by that many nodes each. */
+#define DLBOUNDS_POLL_INTERVAL 256
+
+/* Options for the dancing links search */
+struct dloptions {
+    enum dlselect select;
+    unsigned long seed;     /* Seed for random tie-breaks (0 = fixed default) */
+    int nthreads;           /* Threads to split the search tree of a single
+                             * matrix over (0 or 1 for serial search) */
+    struct dlbounds bounds; /* Bounds of every search */
+};
 
 struct dlsolution {
     int nrows;
     int *rows;
 };
 
-/* Solve binary matrix BMAT with dancing links algorithm. Returns array to found 
- * solutions and stores number in NSOLS */
+/* Number of depths the histograms of `struct dlstats' tell apart; deeper
+ * levels are counted in the last one */
+#define DLSTATS_DEPTHS 128
+
+/* Statistics of a dancing links search. Nodes and solutions are always
+ * counted. The other counters sit in the innermost loops and are only
+ * counted if the solver is compiled with LINKS_STATS set (see
+ * `dlstats_enabled'), otherwise they stay zero. */
+struct dlstats {
+    long nodes;             /* Search nodes visited */
+    long solutions;         /* Solutions found */
+    long deadends;          /* Nodes with a column no row is left for */
+    long updates;           /* Nodes unlinked or relinked by covering and
+                             * uncovering columns */
+    int maxdepth;           /* Deepest level of the search */
+    long depth_nodes[DLSTATS_DEPTHS];       /* Nodes per depth */
+    long depth_branches[DLSTATS_DEPTHS];    /* Rows tried per depth */
+};
+
+/* Returns whether the solver counts all of `struct dlstats' */
+int
+dlstats_enabled(void);
+
+/* Add counters of OTHER to STATS */
+void
+dlstats_add(struct dlstats *stats, const struct dlstats *other);
+
+/* Create lowered cancellation flag */
+struct dlcancel *
+dlcancel_create(void);
+
+/* Free cancellation flag CANCEL */
+void
+dlcancel_free(struct dlcancel *cancel);
+
+/* Raise (RAISED non-zero) or lower flag CANCEL. Searches bounded by it stop
+ * within DLBOUNDS_POLL_INTERVAL nodes once it is raised, and new ones stop
+ * right away until it is lowered again. Safe to call from any thread. */
+void
+dlcancel_set(struct dlcancel *cancel, int raised);
+
+/* Returns deadline of a search bounded by BOUNDS that starts now, as time of
+ * the monotonic clock in seconds, or 0 if it has none */
+double
+dlbounds_deadline(const struct dlbounds *bounds);
+
+/* Check search bounded by BOUNDS with deadline DEADLINE (see
+ * `dlbounds_deadline') after NODES nodes. Returns why it must be aborted, or
+ * DLABORT_NONE if it may go on, and then writes the node count to check it
+ * again at to NEXT. */
+enum dlabort
+dlbounds_check(const struct dlbounds *bounds, double deadline, long nodes, long *next);
+
+/* Called for every solution found with the ids of its NROWS rows in ROWS,
+ * which are only valid during the call. Returning non-zero stops the search. */
+typedef int (*dlvisitor)(const int *rows, int nrows, void *ctx);
+
+/* Solve sparse binary matrix SMAT with dancing links algorithm using options
+ * OPTS (NULL for defaults) and call VISIT with context CTX for every solution
+ * as soon as it is found. Nothing is stored, so memory stays proportional to
+ * the search depth. With several threads calls are serialized, but solutions
+ * come in no particular order. Returns number of solutions visited. */
+long
+dlsolution_visit(const struct smatrix *smat, const struct dloptions *opts,
+                 dlvisitor visit, void *ctx);
+
+/* Solve sparse binary matrix SMAT with dancing links algorithm using options
+ * OPTS (NULL for defaults), stopping after MAX_SOLUTIONS solutions (0 for no
+ * limit). A limit of 1 finds the first solution, 2 is enough to tell whether
+ * it is unique. Returns array to found solutions and stores number in NSOLS.
+ * Unlike `dlsolution_visit', several threads find all solutions in the order
+ * of one, as they are merged once the search is over. */
 struct dlsolution *
-dlsolution_find(const struct bmatrix *bmat, int *nsols);
+dlsolution_find(const struct smatrix *smat, const struct dloptions *opts,
+                int max_solutions, int *nsols);
+
+/* Count solutions of sparse binary matrix SMAT up to MAX_SOLUTIONS (0 for no
+ * limit) using options OPTS (NULL for defaults). No solution is stored, so
+ * memory stays proportional to the search depth. */
+long
+dlsolution_count(const struct smatrix *smat, const struct dloptions *opts,
+                 long max_solutions);
+
+/* Free array of NSOLS solutions SOLS returned by `dlsolution_find' */
+void
+dlsolution_free(struct dlsolution *sols, int nsols);
+
+/* Reusable dancing links solver. It keeps its node, stack and solution buffers
+ * between calls, so solving many matrices of similar size does not allocate. */
+struct dlsolver;
+
+/* Create reusable solver with search options OPTS (NULL for defaults) */
+struct dlsolver *
+dlsolver_create(const struct dloptions *opts);
+
+/* Free memory of solver DLS */
+void
+dlsolver_free(struct dlsolver *dls);
+
+/* Solve sparse binary matrix SMAT with solver DLS, stopping after LIMIT
+ * solutions (0 for no limit). Returns number of solutions found. */
+int
+dlsolver_solve(struct dlsolver *dls, const struct smatrix *smat, int limit);
+
+/* Count solutions of sparse binary matrix SMAT with solver DLS up to LIMIT
+ * (0 for no limit) without storing them */
+long
+dlsolver_count(struct dlsolver *dls, const struct smatrix *smat, long limit);
+
+/* Solve sparse binary matrix SMAT with solver DLS and call VISIT with context
+ * CTX for every solution (see `dlsolution_visit'). Returns number of solutions
+ * visited. */
+long
+dlsolver_visit(struct dlsolver *dls, const struct smatrix *smat, dlvisitor visit,
+               void *ctx);
+
+/* Load sparse binary matrix SMAT into solver DLS as template for
+ * `dlsolver_solve_fixed'. SMAT must stay valid and unchanged as long as it is
+ * used. Returns zero if SMAT has an empty column (and thus no solution). */
+int
+dlsolver_load(struct dlsolver *dls, const struct smatrix *smat);
+
+/* Solve the matrix loaded into DLS by `dlsolver_load' with the NFIXED rows of
+ * ids FIXED chosen up front, besides those of `dlsolver_fix', stopping after
+ * LIMIT solutions (0 for no limit). Only the fixed rows are covered and
+ * uncovered again afterwards, so the setup is proportional to NFIXED and not
+ * to the size of the matrix. Solutions include the fixed rows of both kinds.
+ * Returns number of solutions found, zero if some fixed rows do not exist or
+ * clash with each other. */
+int
+dlsolver_solve_fixed(struct dlsolver *dls, const int *fixed, int nfixed, int limit);
+
+/* Fix row of id ID of the matrix loaded into DLS by `dlsolver_load' for all
+ * following calls of `dlsolver_solve_fixed', until it is taken back by
+ * `dlsolver_unfix' or another matrix is loaded. Its columns are covered right
+ * away, so a search costs nothing extra for it. Returns zero if the row does
+ * not exist or clashes with a fixed row. */
+int
+dlsolver_fix(struct dlsolver *dls, int id);
+
+/* Take back row of id ID fixed by `dlsolver_fix' on DLS. Rows fixed after it
+ * are uncovered and covered again, so taking back the latest one is cheapest.
+ * Returns zero if the row is not fixed. */
+int
+dlsolver_unfix(struct dlsolver *dls, int id);
+
+/* Returns solutions found by last call of `dlsolver_solve' or
+ * `dlsolver_solve_fixed' on DLS. They stay valid until the next call. */
+const struct dlsolution *
+dlsolver_solutions(const struct dlsolver *dls);
+
+/* Returns statistics of the last search of DLS, summed over all threads. They
+ * stay valid until the next call. */
+const struct dlstats *
+dlsolver_stats(const struct dlsolver *dls);
+
+/* Returns why the last search of DLS was aborted, DLABORT_NONE if it ran to
+ * the end or its solution limit. Solutions and statistics of an aborted search
+ * cover the part of the search tree it got through. */
+enum dlabort
+dlsolver_aborted(const struct dlsolver *dls);
 
 /* Returns solved binary matrix based on dancing links solution DLSOL and input
  * binary matrix BMAT */
@@ -1,25 +1,411 @@
+#define _POSIX_C_SOURCE 200809L /* sysconf */
+
+#include <limits.h> /* INT_MAX */
 #include <stdio.h>  /* FILE, fopen, flcose */
-#include <stdlib.h> /* EXIT_SUCCESS, free */
+#include <stdlib.h> /* EXIT_SUCCESS, free, strtoul, strtol, strtod, atoi */
 #include <string.h> /* strcmp */
+#include <unistd.h> /* sysconf */
 
+#include "batch.h"
+#include "cache.h"
+#include "generate.h"
+#include "packed.h"
+#include "server.h"
 #include "sudoku.h"
+#include "writer.h"
+
+/* Number of solutions cached with --cache-file but without --cache */
+#define MAIN_CACHE_SIZE 65536
+
+/* Number of solutions printed without --unique or --max */
+#define MAIN_MAX_SOLUTIONS 1024
+
+/* Returns why a search was aborted for reason ABORTED, as a phrase */
+static const char *
+main_abort_reason(enum dlabort aborted)
+{
+    switch (aborted) {
+    case DLABORT_NODES:
+        return "node budget used up";
+    case DLABORT_DEADLINE:
+        return "timeout";
+    case DLABORT_CANCEL:
+        return "cancelled";
+    default:
+        return "not aborted";
+    }
+}
+
+/* Print statistics of solving: NPROPAGATED cells filled by propagation,
+ * NNODES search nodes and counters SEARCH of the exact cover search */
+static void
+main_print_stats(FILE *out, long npropagated, long nnodes, const struct dlstats *search)
+{
+    fprintf(out, "Cells filled by propagation: %ld\n", npropagated);
+    fprintf(out, "Search nodes: %ld\n", nnodes);
+    if (search->nodes == 0) {
+        return;
+    }
+
+    fprintf(out, "Exact cover solutions: %ld\n", search->solutions);
+    if (!dlstats_enabled()) {
+        fprintf(out, "Build with -DLINKS_STATS=1 for dead ends, link updates and "
+                "branching per depth\n");
+        return;
+    }
+    fprintf(out, "Dead ends: %ld\n", search->deadends);
+    fprintf(out, "Link updates: %ld\n", search->updates);
+    fprintf(out, "Maximum depth: %d\n", search->maxdepth);
+    fprintf(out, "%6s %12s %12s %10s\n", "depth", "nodes", "branches", "branching");
+    for (int depth = 0; depth < DLSTATS_DEPTHS; ++depth) {
+        const long nodes = search->depth_nodes[depth];
+        if (nodes == 0) {
+            continue;
+        }
+        /* The last depth also counts all deeper ones */
+        fprintf(out, "%5d%c %12ld %12ld %10.2f\n", depth,
+                (depth == DLSTATS_DEPTHS - 1) ? '+' : ' ', nodes,
+                search->depth_branches[depth],
+                (double) search->depth_branches[depth] / nodes);
+    }
+}
+
+/* Create cache of CAPACITY solutions and fill it from CACHEFILE unless it is
+ * NULL or does not exist yet */
+static struct cache *
+main_cache_open(long capacity, const char *cachefile)
+{
+    struct cache *cache = cache_create(capacity);
+    FILE *in = cachefile ? fopen(cachefile, "r") : NULL;
+    if (in) {
+        const long n = cache_load(cache, in);
+        fprintf(stderr, "Loaded %ld solutions from cache file '%s'\n", n, cachefile);
+        fclose(in);
+    }
+    return cache;
+}
+
+/* Print hit rate of CACHE, save it to CACHEFILE unless it is NULL and free
+ * it */
+static void
+main_cache_close(struct cache *cache, const char *cachefile)
+{
+    struct cache_stats stats;
+    cache_stats(cache, &stats);
+    fprintf(stderr, "Cache: %ld hits of %ld lookups (%.1f%%), %ld solutions held, "
+            "%ld evicted\n", stats.hits, stats.lookups,
+            stats.lookups ? 100.0 * stats.hits / stats.lookups : 0.0, stats.nentries,
+            stats.evictions);
+
+    if (cachefile) {
+        FILE *out = fopen(cachefile, "w");
+        if (out) {
+            cache_save(cache, out);
+            fclose(out);
+        } else {
+            fprintf(stderr, "Could not write cache file '%s'\n", cachefile);
+        }
+    }
+    cache_free(cache);
+}
+
+/* Solve puzzles in one-line or packed format from INFILE and write solutions
+ * to OUTFILE (or OUT if it is NULL), packed if PACKED is set, looking them up
+ * in CACHE unless it is NULL. With SHOWSTATS set statistics of all searches
+ * are printed as well. */
+static int
+main_batch(const char *infile, const char *outfile, FILE *out,
+           const struct sudoku_options *opts, int nthreads, struct cache *cache,
+           int packed, int showstats)
+{
+    FILE *in = stdin;
+    if (strcmp(infile, "-") != 0) {
+        in = fopen(infile, "r");
+        if (!in) {
+            fprintf(stderr, "Could not read file '%s'!\n", infile);
+            return EXIT_FAILURE;
+        }
+    }
+    if (outfile) {
+        out = fopen(outfile, "w");
+        if (!out) {
+            fprintf(stderr, "Could not open output file '%s'\n", outfile);
+            out = stdout;
+            outfile = NULL;
+        }
+    }
+
+    struct batch_stats stats;
+    batch_solve(in, out, opts, nthreads, cache, packed, &stats);
+
+    fprintf(stderr, "Solved %ld of %ld puzzles in %.3f s (%.0f puzzles/s), "
+            "%ld cells filled by propagation, %ld aborted\n",
+            stats.nsolved, stats.npuzzles, stats.seconds,
+            stats.seconds > 0 ? stats.npuzzles / stats.seconds : 0.0,
+            stats.npropagated, stats.naborted);
+    if (showstats) {
+        main_print_stats(stderr, stats.npropagated, stats.nnodes, &stats.search);
+    }
+
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (outfile) {
+        fclose(out);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/* Generate NPUZZLES puzzles as set in OPTS and write them to OUTFILE (or OUT
+ * if it is NULL) */
+static int
+main_generate(long npuzzles, const char *outfile, FILE *out,
+              const struct generate_options *opts)
+{
+    if (outfile) {
+        out = fopen(outfile, "w");
+        if (!out) {
+            fprintf(stderr, "Could not open output file '%s'\n", outfile);
+            out = stdout;
+            outfile = NULL;
+        }
+    }
+
+    struct generate_stats stats;
+    generate_puzzles(out, npuzzles, opts, &stats);
+
+    fprintf(stderr, "Generated %ld of %ld puzzles in %.3f s (%.0f puzzles/s), "
+            "%.1f clues on average, %ld grids, %ld uniqueness checks\n",
+            stats.npuzzles, npuzzles, stats.seconds,
+            stats.seconds > 0 ? stats.npuzzles / stats.seconds : 0.0,
+            stats.npuzzles > 0 ? (double) stats.nclues / stats.npuzzles : 0.0,
+            stats.ngrids, stats.nchecks);
+
+    if (outfile) {
+        fclose(out);
+    }
+
+    return stats.nfailed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* Convert sudokus of INFILE to a packed file if PACK is set, otherwise a
+ * packed INFILE to text, and write the result to OUTFILE (or OUT if it is
+ * NULL) */
+static int
+main_convert(const char *infile, const char *outfile, FILE *out, int pack)
+{
+    FILE *in = stdin;
+    if (strcmp(infile, "-") != 0) {
+        in = fopen(infile, "r");
+        if (!in) {
+            fprintf(stderr, "Could not read file '%s'!\n", infile);
+            return EXIT_FAILURE;
+        }
+    }
+    if (outfile) {
+        out = fopen(outfile, "w");
+        if (!out) {
+            fprintf(stderr, "Could not open output file '%s'\n", outfile);
+            out = stdout;
+            outfile = NULL;
+        }
+    }
+
+    long nskipped = 0;
+    const long n = pack ? packed_from_text(in, out, &nskipped) : packed_to_text(in, out);
+    if (n < 0) {
+        fprintf(stderr, pack ? "No sudoku found in '%s'!\n"
+                             : "'%s' is no packed file of sudokus of up to 35x35 cells!\n",
+                infile);
+    } else {
+        fprintf(stderr, "Converted %ld sudokus, skipped %ld lines\n", n, nskipped);
+    }
+
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (outfile) {
+        fclose(out);
+    }
+
+    return n < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* Edit SUDOKU with commands read from standard input, one per line, and
+ * answer each on OUTFILE (or OUT if it is NULL). Grids are written in FORMAT,
+ * and checks search as set in OPTS. Rows, columns and digits count from 1. */
+static int
+main_interactive(const struct sudoku *sudoku, const char *outfile, FILE *out,
+                 const struct sudoku_options *opts, enum writer_format format)
+{
+    struct sudoku_session *session = sudoku_session_create(sudoku, opts);
+    if (!session) {
+        fprintf(stderr, "Filled cells of the sudoku clash!\n");
+        return EXIT_FAILURE;
+    }
+    if (outfile) {
+        out = fopen(outfile, "w");
+        if (!out) {
+            fprintf(stderr, "Could not open output file '%s'\n", outfile);
+            out = stdout;
+            outfile = NULL;
+        }
+    }
+    struct sudoku *solution = sudoku_create(sudoku->size);
+    struct writer *writer = writer_create(out, format);
+
+    char line[256];
+    while (fgets(line, sizeof line, stdin)) {
+        char cmd[16];
+        int row, col, elem;
+        if (sscanf(line, "%15s", cmd) != 1) {
+            continue;
+        }
+
+        if (strcmp(cmd, "set") == 0) {
+            const int ok = sscanf(line, "%*s %d %d %d", &row, &col, &elem) == 3
+                           && sudoku_session_set_cell(session, row - 1, col - 1, elem);
+            fputs(ok ? "ok\n" : "invalid or clashing cell\n", out);
+        } else if (strcmp(cmd, "clear") == 0) {
+            const int ok = sscanf(line, "%*s %d %d", &row, &col) == 2
+                           && sudoku_session_clear_cell(session, row - 1, col - 1);
+            fputs(ok ? "ok\n" : "invalid cell\n", out);
+        } else if (strcmp(cmd, "check") == 0) {
+            fputs(sudoku_session_check_solvable(session, NULL) ? "solvable\n"
+                                                               : "unsolvable\n", out);
+        } else if (strcmp(cmd, "unique") == 0) {
+            fputs(sudoku_session_check_unique(session) ? "unique\n"
+                  : sudoku_session_check_solvable(session, NULL) ? "multiple\n"
+                                                                 : "unsolvable\n", out);
+        } else if (strcmp(cmd, "solve") == 0) {
+            if (sudoku_session_check_solvable(session, solution)) {
+                writer_sudoku(writer, solution);
+                writer_flush(writer);
+            } else {
+                fputs("unsolvable\n", out);
+            }
+        } else if (strcmp(cmd, "print") == 0) {
+            writer_sudoku(writer, sudoku_session_grid(session));
+            writer_flush(writer);
+        } else {
+            fputs("unknown command\n", out);
+        }
+        fflush(out);
+    }
+
+    writer_free(writer);
+    sudoku_free(solution);
+    sudoku_session_free(session);
+    if (outfile) {
+        fclose(out);
+    }
+    return EXIT_SUCCESS;
+}
+
+/* Solutions written by `main_write_line' */
+struct main_lines {
+    struct writer *writer;
+    long limit;         /* Stop after this many, 0 for no limit */
+    long nsols;
+};
+
+/* Visitor for `sudoku_visit' writing solution SOL in one-line format with
+ * the writer of CTX */
+static int
+main_write_line(const struct sudoku *sol, void *ctx)
+{
+    struct main_lines *lines = ctx;
+    writer_sudoku(lines->writer, sol);
+    ++lines->nsols;
+    return lines->limit > 0 && lines->nsols >= lines->limit;
+}
 
 int
 main(int argc, char **argv)
 {
     static const char *usage =
       "usage: sudoku [OPTIONS] FILE\n"
-      "Read sudoku from FILE and write solution to file or standard output.\n"
+      "       sudoku [OPTIONS] --generate N\n"
+      "       sudoku [OPTIONS] --serve SOCKET\n"
+      "Read sudoku from FILE (or - for stdin) and write solution to file or\n"
+      "standard output. FILE holds whitespace separated numbers (0 or . for\n"
+      "blanks), or one character per cell (0 or . for blanks, A-Z for 10-35).\n"
       "\n"
       "With no FILE print help.\n"
       "\n"
       "  -o, --output  specify output file (or stdout, stderr)\n"
+      "  -b, --batch   read one puzzle per line from FILE (or - for stdin), or\n"
+      "                the records of a packed file, and write one solution per\n"
+      "                line\n"
+      "      --packed  in batch mode write a packed file with puzzles,\n"
+      "                solutions and their number instead\n"
+      "      --pack    convert FILE, one sudoku or lines of one-line puzzles,\n"
+      "                to a packed file\n"
+      "      --unpack  convert packed FILE to lines of one-line puzzles, with\n"
+      "                the solutions and their number if it has them\n"
+      "  -j, --jobs    number of threads (0 for all cores); batch mode solves\n"
+      "                puzzles in parallel, otherwise the search is split\n"
       "  -f, --fancy   print solution with separators between blocks\n"
+      "  -l, --line    print solutions in one-line format as they are found,\n"
+      "                without the puzzle\n"
+      "  -i, --interactive  edit the sudoku of FILE with commands read from\n"
+      "                standard input: set ROW COL DIGIT, clear ROW COL, check\n"
+      "                (solvable or not), unique, solve and print; rows,\n"
+      "                columns and digits count from 1\n"
+      "      --unique  stop after two solutions, enough to tell whether the\n"
+      "                solution is unique\n"
+      "      --count   only count solutions, without limit unless --max is given\n"
+      "      --max     stop after N solutions (1 for the first, 0 for no limit);\n"
+      "                without it, all solutions up to 1024 are printed\n"
+      "  -e, --engine  solver engine: auto (default), dlx, bitmask, bitset\n"
+      "  -p, --propagate  logic applied before searching: none, singles\n"
+      "                (default), locked\n"
+      "  -s, --select  column selection policy: first, mrv (default), random\n"
+      "      --seed    seed for random tie-breaks of '--select random' and for\n"
+      "                '--generate'\n"
+      "      --max-nodes  abort the search of a puzzle after N nodes\n"
+      "      --timeout  abort the search of a puzzle after SECONDS; searches\n"
+      "                that run into either bound report 'aborted' with the\n"
+      "                statistics of the part searched\n"
+      "  -g, --generate  write N puzzles with unique solutions in one-line format\n"
+      "      --size    block size of generated puzzles, 2 to 5 (default 3)\n"
+      "      --clues   stop removing clues of generated puzzles at N (default 0\n"
+      "                for as few as possible)\n"
+      "      --band    difficulty of generated puzzles: any (default), easy\n"
+      "                (singles), medium (locked candidates), hard (search)\n"
+      "      --serve   answer solve and stats requests on Unix socket SOCKET,\n"
+      "                or with - in frames on standard input and output, with\n"
+      "                as many worker threads as given by --jobs\n"
+      "      --cache   in batch and server mode, keep solutions of up to N\n"
+      "                puzzles and answer puzzles equal to them up to relabeling\n"
+      "                digits, swapping rows, columns, bands and stacks, and\n"
+      "                transposing from there\n"
+      "      --cache-file  load the cache from FILE if it exists and save it\n"
+      "                there when done\n"
+      "      --stats   print search statistics to standard error\n"
       "  -h, --help    display this help and exit\n";
 
-    int fancy = 0;
+    enum writer_format format = WRITER_PLAIN;
+    int batch = 0;
+    int packed = 0;
+    int convert = -1;
+    int count = 0;
+    int interactive = 0;
+    int showstats = 0;
+    long maxsols = -1;
+    int nthreads = 1;
+    struct sudoku_options opts = {
+        SUDOKU_ENGINE_AUTO, SUDOKU_PROPAGATE_SINGLES,
+        { DLSELECT_MRV, 0, 1, { 0, 0, NULL } }
+    };
+    long ngenerate = -1;
+    struct generate_options gopts = { 3, 0, GENERATE_BAND_ANY, 0, 1 };
     char *infile = NULL;
     char *outfile = NULL;
+    char *sockpath = NULL;
+    long cachesize = 0;
+    char *cachefile = NULL;
     FILE *out = stdout;
 
     for (int i = 1; i < argc; ++i) {
@@ -33,10 +419,231 @@ main(int argc, char **argv)
                 continue;
             }
             outfile = argv[i];
+            continue;
         }
-    
+
         if (strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--fancy") == 0) {
-            fancy = 1;
+            format = WRITER_FANCY;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-l") == 0 || strcmp(argv[i], "--line") == 0) {
+            format = WRITER_LINE;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--unique") == 0) {
+            maxsols = 2;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--packed") == 0) {
+            packed = 1;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--pack") == 0 || strcmp(argv[i], "--unpack") == 0) {
+            convert = (strcmp(argv[i], "--pack") == 0);
+            continue;
+        }
+
+        if (strcmp(argv[i], "-i") == 0 || strcmp(argv[i], "--interactive") == 0) {
+            interactive = 1;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--count") == 0) {
+            count = 1;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--stats") == 0) {
+            showstats = 1;
+            continue;
+        }
+
+        if (strcmp(argv[i], "--max") == 0) {
+            ++i;
+            if (i == argc) {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            maxsols = strtol(argv[i], NULL, 10);
+            if (maxsols < 0) {
+                maxsols = 0;
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-b") == 0 || strcmp(argv[i], "--batch") == 0) {
+            batch = 1;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) {
+            ++i;
+            if (i == argc) {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            nthreads = atoi(argv[i]);
+            if (nthreads <= 0) {
+                nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-e") == 0 || strcmp(argv[i], "--engine") == 0) {
+            ++i;
+            if (i < argc && strcmp(argv[i], "auto") == 0) {
+                opts.engine = SUDOKU_ENGINE_AUTO;
+            } else if (i < argc && strcmp(argv[i], "dlx") == 0) {
+                opts.engine = SUDOKU_ENGINE_DLX;
+            } else if (i < argc && strcmp(argv[i], "bitmask") == 0) {
+                opts.engine = SUDOKU_ENGINE_BITMASK;
+            } else if (i < argc && strcmp(argv[i], "bitset") == 0) {
+                opts.engine = SUDOKU_ENGINE_BITSET;
+            } else {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--propagate") == 0) {
+            ++i;
+            if (i < argc && strcmp(argv[i], "none") == 0) {
+                opts.propagate = SUDOKU_PROPAGATE_NONE;
+            } else if (i < argc && strcmp(argv[i], "singles") == 0) {
+                opts.propagate = SUDOKU_PROPAGATE_SINGLES;
+            } else if (i < argc && strcmp(argv[i], "locked") == 0) {
+                opts.propagate = SUDOKU_PROPAGATE_LOCKED;
+            } else {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--select") == 0) {
+            ++i;
+            if (i < argc && strcmp(argv[i], "first") == 0) {
+                opts.search.select = DLSELECT_FIRST;
+            } else if (i < argc && strcmp(argv[i], "mrv") == 0) {
+                opts.search.select = DLSELECT_MRV;
+            } else if (i < argc && strcmp(argv[i], "random") == 0) {
+                opts.search.select = DLSELECT_MRV_RANDOM;
+            } else {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "--seed") == 0) {
+            ++i;
+            if (i == argc) {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            opts.search.seed = strtoul(argv[i], NULL, 10);
+            continue;
+        }
+
+        if (strcmp(argv[i], "--max-nodes") == 0) {
+            ++i;
+            if (i == argc) {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            opts.search.bounds.max_nodes = strtol(argv[i], NULL, 10);
+            continue;
+        }
+
+        if (strcmp(argv[i], "--timeout") == 0) {
+            ++i;
+            if (i == argc) {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            opts.search.bounds.timeout = strtod(argv[i], NULL);
+            continue;
+        }
+
+        if (strcmp(argv[i], "-g") == 0 || strcmp(argv[i], "--generate") == 0) {
+            ++i;
+            if (i == argc) {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            ngenerate = strtol(argv[i], NULL, 10);
+            continue;
+        }
+
+        if (strcmp(argv[i], "--size") == 0) {
+            ++i;
+            if (i == argc || atoi(argv[i]) < 2 || atoi(argv[i]) > 5) {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            gopts.size = atoi(argv[i]);
+            continue;
+        }
+
+        if (strcmp(argv[i], "--clues") == 0) {
+            ++i;
+            if (i == argc) {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            gopts.nclues = atoi(argv[i]);
+            continue;
+        }
+
+        if (strcmp(argv[i], "--serve") == 0) {
+            ++i;
+            if (i == argc) {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            sockpath = argv[i];
+            continue;
+        }
+
+        if (strcmp(argv[i], "--cache") == 0) {
+            ++i;
+            if (i == argc || strtol(argv[i], NULL, 10) <= 0) {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            cachesize = strtol(argv[i], NULL, 10);
+            continue;
+        }
+
+        if (strcmp(argv[i], "--cache-file") == 0) {
+            ++i;
+            if (i == argc) {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
+            cachefile = argv[i];
+            continue;
+        }
+
+        if (strcmp(argv[i], "--band") == 0) {
+            ++i;
+            if (i < argc && strcmp(argv[i], "any") == 0) {
+                gopts.band = GENERATE_BAND_ANY;
+            } else if (i < argc && strcmp(argv[i], "easy") == 0) {
+                gopts.band = GENERATE_BAND_EASY;
+            } else if (i < argc && strcmp(argv[i], "medium") == 0) {
+                gopts.band = GENERATE_BAND_MEDIUM;
+            } else if (i < argc && strcmp(argv[i], "hard") == 0) {
+                gopts.band = GENERATE_BAND_HARD;
+            } else {
+                fprintf(stderr, "%s", usage);
+                return EXIT_FAILURE;
+            }
             continue;
         }
 
@@ -50,16 +657,132 @@ main(int argc, char **argv)
         }
     }
 
+    if (ngenerate >= 0) {
+        gopts.seed = opts.search.seed;
+        gopts.nthreads = nthreads;
+        return main_generate(ngenerate, outfile, out, &gopts);
+    }
+
+    if (cachefile && cachesize == 0) {
+        cachesize = MAIN_CACHE_SIZE;
+    }
+
+    if (sockpath) {
+        struct cache *cache = cachesize ? main_cache_open(cachesize, cachefile) : NULL;
+        const struct server_options sopts = { sockpath, nthreads, opts, cache };
+        const int ok = server_run(&sopts);
+        if (cache) {
+            main_cache_close(cache, cachefile);
+        }
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     if (!infile) {
         fprintf(stderr, "%s", usage);
         return EXIT_FAILURE;
     }
 
+    if (convert >= 0) {
+        return main_convert(infile, outfile, out, convert);
+    }
+
+    if (batch) {
+        struct cache *cache = cachesize ? main_cache_open(cachesize, cachefile) : NULL;
+        const int status = main_batch(infile, outfile, out, &opts, nthreads, cache, packed,
+                                      showstats);
+        if (cache) {
+            main_cache_close(cache, cachefile);
+        }
+        return status;
+    }
+
+    if (interactive && strcmp(infile, "-") == 0) {
+        fprintf(stderr, "Interactive mode reads commands from standard input, "
+                "the sudoku must come from a file!\n");
+        return EXIT_FAILURE;
+    }
+
+    opts.search.nthreads = nthreads;
     struct sudoku *sudoku = sudoku_read(infile);
-    
+    struct sudoku_stats stats;
+
+    if (format == WRITER_LINE && !count && sudoku->nelems > SUDOKU_LINE_MAX_NELEMS) {
+        fprintf(stderr, "One-line format holds sudokus of up to %dx%d cells!\n",
+                SUDOKU_LINE_MAX_NELEMS, SUDOKU_LINE_MAX_NELEMS);
+        sudoku_free(sudoku);
+        return EXIT_FAILURE;
+    }
+
+    if (interactive) {
+        const int status = main_interactive(sudoku, outfile, out, &opts, format);
+        sudoku_free(sudoku);
+        return status;
+    }
+
+    if (count) {
+        const long n = sudoku_count(sudoku, &opts, (maxsols < 0) ? 0 : maxsols, &stats);
+        if (stats.aborted != DLABORT_NONE) {
+            printf("Number of solutions: at least %ld (search aborted: %s)\n", n,
+                   main_abort_reason(stats.aborted));
+        } else {
+            printf("Number of solutions: %ld%s\n", n,
+                   (maxsols > 0 && n >= maxsols) ? " (limit reached)" : "");
+        }
+        if (showstats) {
+            main_print_stats(stderr, stats.npropagated, stats.nnodes, &stats.search);
+        }
+        sudoku_free(sudoku);
+        return EXIT_SUCCESS;
+    }
+
+    const int capped = maxsols < 0;
+    if (capped) {
+        maxsols = MAIN_MAX_SOLUTIONS;
+    }
+    if (maxsols > INT_MAX) {
+        maxsols = INT_MAX;
+    }
+
+    if (format == WRITER_LINE) {
+        if (outfile) {
+            out = fopen(outfile, "w");
+            if (!out) {
+                fprintf(stderr, "Could not open output file '%s'\n", outfile);
+                out = stdout;
+                outfile = NULL;
+            }
+        }
+
+        struct main_lines lines = { writer_create(out, format), maxsols, 0 };
+        sudoku_visit(sudoku, &opts, &main_write_line, &lines, &stats);
+        writer_free(lines.writer);
+        if (capped && lines.nsols >= maxsols) {
+            fprintf(stderr, "Stopped after %ld solutions, use --max to find more!\n",
+                    maxsols);
+        }
+        if (stats.aborted != DLABORT_NONE) {
+            fprintf(stderr, "Search aborted: %s\n", main_abort_reason(stats.aborted));
+        }
+        if (showstats) {
+            main_print_stats(stderr, stats.npropagated, stats.nnodes, &stats.search);
+        }
+
+        if (outfile) {
+            fclose(out);
+        }
+        sudoku_free(sudoku);
+        return EXIT_SUCCESS;
+    }
+
     int nsols;
-    struct sudoku **sols = sudoku_solve(sudoku, &nsols);
+    struct sudoku **sols = sudoku_solve(sudoku, &opts, (int) maxsols, &nsols, &stats);
+    if (showstats) {
+        main_print_stats(stderr, stats.npropagated, stats.nnodes, &stats.search);
+    }
 
+    if (stats.aborted != DLABORT_NONE) {
+        printf("Search aborted: %s!\n", main_abort_reason(stats.aborted));
+    }
     if (nsols == 0) {
         puts("No solution found!");
         outfile = NULL;
@@ -67,6 +790,9 @@ main(int argc, char **argv)
     if (nsols > 1) {
         puts("Multiple solutions found!");
     }
+    if (capped && nsols >= maxsols) {
+        fprintf(stderr, "Stopped after %d solutions, use --max to find more!\n", nsols);
+    }
 
     if (outfile) {
         out = fopen(outfile, "w");
@@ -77,17 +803,21 @@ main(int argc, char **argv)
         }
     }
 
-    fprintf(out, "Puzzle:\n");
-    sudoku_fprint(out, sudoku, fancy);
+    struct writer *writer = writer_create(out, format);
+    writer_puts(writer, "Puzzle:\n");
+    writer_sudoku(writer, sudoku);
     for (int i = 0; i < nsols; ++i) {
         if (nsols == 1) {
-            fprintf(out, "\n\nSolution:\n");
+            writer_puts(writer, "\n\nSolution:\n");
         } else {
-            fprintf(out, "\n\nSolution %i:\n", i + 1);
+            char header[32];
+            sprintf(header, "\n\nSolution %i:\n", i + 1);
+            writer_puts(writer, header);
         }
-        sudoku_fprint(out, sols[i], fancy);
+        writer_sudoku(writer, sols[i]);
         sudoku_free(sols[i]);
     }
+    writer_free(writer);
 
     if (outfile) {
         fclose(out);
@@ -0,0 +1,478 @@
+#include "packed.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "input.h"
+
+/* Number of records the writer and reader buffer at a time */
+#define PACKED_BUFFER_RECORDS 4096
+
+/* Stored numbers of solutions of aborted and invalid records */
+#define PACKED_STORED_ABORTED UINT32_C(0xffffffff)
+#define PACKED_STORED_INVALID UINT32_C(0xfffffffe)
+
+static const unsigned char packed_magic[4] = { 'S', 'D', 'K', 'P' };
+
+struct packed_writer {
+    FILE *out;
+    long start;                 /* Offset of the header, -1 if unknown */
+    struct packed_header hdr;
+    unsigned char *buf;         /* PACKED_BUFFER_RECORDS records */
+    int nbuf;                   /* Records in BUF */
+    uint64_t count;             /* Records written */
+};
+
+struct packed_reader {
+    FILE *in;
+    struct packed_header hdr;
+    unsigned char *buf;         /* PACKED_BUFFER_RECORDS records */
+    int nbuf;                   /* Records in BUF */
+    int pos;                    /* Next record of BUF */
+    uint64_t nleft;             /* Records still to read as the header says */
+};
+
+void
+packed_header_init(struct packed_header *hdr, int size, int flags)
+{
+    const int nelems = size * size;
+    hdr->size = size;
+    hdr->flags = flags;
+    hdr->bits = 1;
+    while ((1 << hdr->bits) <= nelems) {
+        ++hdr->bits;
+    }
+    hdr->gridsize = ((size_t) nelems * nelems * hdr->bits + 7) / 8;
+    hdr->recsize = hdr->gridsize;
+    if (flags & PACKED_SOLUTION) {
+        hdr->recsize += hdr->gridsize;
+    }
+    if (flags & PACKED_COUNT) {
+        hdr->recsize += 4;
+    }
+    hdr->count = PACKED_COUNT_UNKNOWN;
+}
+
+void
+packed_header_put(const struct packed_header *hdr, unsigned char *buf)
+{
+    memcpy(buf, packed_magic, sizeof packed_magic);
+    buf[4] = PACKED_VERSION;
+    buf[5] = (unsigned char) hdr->size;
+    buf[6] = (unsigned char) hdr->flags;
+    buf[7] = (unsigned char) hdr->bits;
+    for (int i = 0; i < 8; ++i) {
+        buf[8 + i] = (unsigned char) (hdr->count >> (56 - 8 * i));
+    }
+}
+
+int
+packed_header_get(struct packed_header *hdr, const unsigned char *buf, size_t len)
+{
+    if (len < PACKED_HEADER_SIZE || memcmp(buf, packed_magic, sizeof packed_magic) != 0
+        || buf[4] != PACKED_VERSION || buf[5] < 1 || buf[5] > 15
+        || (buf[6] & ~(PACKED_SOLUTION | PACKED_COUNT)) != 0) {
+        return 0;
+    }
+    packed_header_init(hdr, buf[5], buf[6]);
+    if (buf[7] != hdr->bits) {
+        return 0;
+    }
+    hdr->count = 0;
+    for (int i = 0; i < 8; ++i) {
+        hdr->count = (hdr->count << 8) | buf[8 + i];
+    }
+    return 1;
+}
+
+/* Pack the cells of GRID (all blanks if NULL) with BITS bits each to the
+ * bytes at OUT. Returns the end of the bytes written. */
+static unsigned char *
+packed_put_grid(unsigned char *out, const struct sudoku *grid, int ncells, int bits)
+{
+    uint64_t acc = 0;
+    int nacc = 0;
+    for (int i = 0; i < ncells; ++i) {
+        acc |= (uint64_t) (grid ? grid->data[i] : 0) << nacc;
+        nacc += bits;
+        while (nacc >= 8) {
+            *out++ = (unsigned char) acc;
+            acc >>= 8;
+            nacc -= 8;
+        }
+    }
+    if (nacc > 0) {
+        *out++ = (unsigned char) acc;
+    }
+    return out;
+}
+
+/* Unpack the cells of GRID with BITS bits each from the bytes at IN. Returns
+ * zero if a cell is out of range. */
+static int
+packed_get_grid(const unsigned char *in, struct sudoku *grid, int bits)
+{
+    const int ncells = grid->nelems * grid->nelems;
+    const uint64_t mask = (UINT64_C(1) << bits) - 1;
+    uint64_t acc = 0;
+    int nacc = 0;
+    int valid = 1;
+    for (int i = 0; i < ncells; ++i) {
+        while (nacc < bits) {
+            acc |= (uint64_t) *in++ << nacc;
+            nacc += 8;
+        }
+        const int elem = (int) (acc & mask);
+        acc >>= bits;
+        nacc -= bits;
+        valid &= (elem <= grid->nelems);
+        grid->data[i] = (uint8_t) elem;
+    }
+    return valid;
+}
+
+void
+packed_encode(const struct packed_header *hdr, unsigned char *rec,
+              const struct sudoku *puzzle, const struct sudoku *solution, long nsols)
+{
+    const int ncells = hdr->size * hdr->size * hdr->size * hdr->size;
+    rec = packed_put_grid(rec, puzzle, ncells, hdr->bits);
+    if (hdr->flags & PACKED_SOLUTION) {
+        rec = packed_put_grid(rec, solution, ncells, hdr->bits);
+    }
+    if (hdr->flags & PACKED_COUNT) {
+        const uint32_t stored = (nsols == PACKED_COUNT_ABORTED) ? PACKED_STORED_ABORTED
+                              : (nsols == PACKED_COUNT_INVALID) ? PACKED_STORED_INVALID
+                              : (nsols >= (long) PACKED_STORED_INVALID) ? PACKED_STORED_INVALID - 1
+                              : (uint32_t) nsols;
+        for (int i = 0; i < 4; ++i) {
+            rec[i] = (unsigned char) (stored >> (24 - 8 * i));
+        }
+    }
+}
+
+int
+packed_decode(const struct packed_header *hdr, const unsigned char *rec,
+              struct sudoku *puzzle, struct sudoku *solution, long *nsols)
+{
+    int valid = 1;
+    if (puzzle) {
+        valid &= packed_get_grid(rec, puzzle, hdr->bits);
+    }
+    rec += hdr->gridsize;
+    if (hdr->flags & PACKED_SOLUTION) {
+        if (solution) {
+            valid &= packed_get_grid(rec, solution, hdr->bits);
+        }
+        rec += hdr->gridsize;
+    }
+    if ((hdr->flags & PACKED_COUNT) && nsols) {
+        const uint32_t stored = ((uint32_t) rec[0] << 24) | ((uint32_t) rec[1] << 16)
+                                | ((uint32_t) rec[2] << 8) | (uint32_t) rec[3];
+        *nsols = (stored == PACKED_STORED_ABORTED) ? PACKED_COUNT_ABORTED
+               : (stored == PACKED_STORED_INVALID) ? PACKED_COUNT_INVALID
+               : (long) stored;
+    }
+    return valid;
+}
+
+struct packed_writer *
+packed_writer_create(FILE *out, int size, int flags)
+{
+    struct packed_writer *writer = malloc(sizeof *writer);
+    writer->out = out;
+    writer->start = ftell(out);
+    packed_header_init(&writer->hdr, size, flags);
+    writer->buf = malloc(PACKED_BUFFER_RECORDS * writer->hdr.recsize);
+    writer->nbuf = 0;
+    writer->count = 0;
+
+    unsigned char header[PACKED_HEADER_SIZE];
+    packed_header_put(&writer->hdr, header);
+    fwrite(header, 1, sizeof header, out);
+    return writer;
+}
+
+/* Hand records buffered by WRITER to its file */
+static void
+packed_writer_flush(struct packed_writer *writer)
+{
+    fwrite(writer->buf, writer->hdr.recsize, writer->nbuf, writer->out);
+    writer->nbuf = 0;
+}
+
+void
+packed_writer_put(struct packed_writer *writer, const struct sudoku *puzzle,
+                  const struct sudoku *solution, long nsols)
+{
+    if (writer->nbuf == PACKED_BUFFER_RECORDS) {
+        packed_writer_flush(writer);
+    }
+    packed_encode(&writer->hdr, &writer->buf[writer->nbuf * writer->hdr.recsize], puzzle,
+                  solution, nsols);
+    ++writer->nbuf;
+    ++writer->count;
+}
+
+uint64_t
+packed_writer_free(struct packed_writer *writer)
+{
+    packed_writer_flush(writer);
+    if (writer->start >= 0) {
+        packed_write_count(writer->out, writer->start, writer->count);
+    }
+    const uint64_t count = writer->count;
+    free(writer->buf);
+    free(writer);
+    return count;
+}
+
+int
+packed_write_count(FILE *out, long start, uint64_t count)
+{
+    unsigned char buf[8];
+    for (int i = 0; i < 8; ++i) {
+        buf[i] = (unsigned char) (count >> (56 - 8 * i));
+    }
+    fflush(out);
+    if (fseek(out, start + 8, SEEK_SET) != 0) {
+        return 0;
+    }
+    fwrite(buf, 1, sizeof buf, out);
+    return fseek(out, 0, SEEK_END) == 0;
+}
+
+struct packed_reader *
+packed_reader_create(FILE *in)
+{
+    unsigned char header[PACKED_HEADER_SIZE];
+    struct packed_header hdr;
+    if (fread(header, 1, sizeof header, in) != sizeof header
+        || !packed_header_get(&hdr, header, sizeof header)) {
+        return NULL;
+    }
+
+    struct packed_reader *reader = malloc(sizeof *reader);
+    reader->in = in;
+    reader->hdr = hdr;
+    reader->buf = malloc(PACKED_BUFFER_RECORDS * hdr.recsize);
+    reader->nbuf = 0;
+    reader->pos = 0;
+    reader->nleft = hdr.count;
+    return reader;
+}
+
+void
+packed_reader_free(struct packed_reader *reader)
+{
+    if (!reader) {
+        return;
+    }
+    free(reader->buf);
+    free(reader);
+}
+
+const struct packed_header *
+packed_reader_header(const struct packed_reader *reader)
+{
+    return &reader->hdr;
+}
+
+int
+packed_reader_next(struct packed_reader *reader, struct sudoku *puzzle,
+                   struct sudoku *solution, long *nsols)
+{
+    if (reader->nleft == 0) {
+        return 0;
+    }
+    if (reader->pos == reader->nbuf) {
+        /* A record cut short at the end of the file is dropped */
+        reader->nbuf = (int) fread(reader->buf, reader->hdr.recsize, PACKED_BUFFER_RECORDS,
+                                   reader->in);
+        reader->pos = 0;
+        if (reader->nbuf == 0) {
+            return 0;
+        }
+    }
+
+    if (reader->nleft != PACKED_COUNT_UNKNOWN) {
+        --reader->nleft;
+    }
+    const unsigned char *rec = &reader->buf[reader->pos++ * reader->hdr.recsize];
+    return packed_decode(&reader->hdr, rec, puzzle, solution, nsols) ? 1 : -1;
+}
+
+/* Parse number of solutions from the LEN characters of WORD into NSOLS.
+ * Returns zero if WORD is none. */
+static int
+packed_parse_count(const char *word, size_t len, long *nsols)
+{
+    if (len == 7 && memcmp(word, "aborted", 7) == 0) {
+        *nsols = PACKED_COUNT_ABORTED;
+        return 1;
+    }
+    if (len == 7 && memcmp(word, "invalid", 7) == 0) {
+        *nsols = PACKED_COUNT_INVALID;
+        return 1;
+    }
+    *nsols = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (word[i] < '0' || word[i] > '9' || *nsols > 100000000) {
+            return 0;
+        }
+        *nsols = 10 * *nsols + (word[i] - '0');
+    }
+    return len > 0;
+}
+
+/* Split the LEN characters of LINE at spaces into up to 3 words, written to
+ * WORDS and LENS. Returns number of words, or 4 if there are more. */
+static int
+packed_split(const char *line, size_t len, const char **words, size_t *lens)
+{
+    int nwords = 0;
+    size_t pos = 0;
+    while (pos < len) {
+        while (pos < len && line[pos] == ' ') {
+            ++pos;
+        }
+        if (pos == len) {
+            break;
+        }
+        if (nwords == 3) {
+            return 4;
+        }
+        words[nwords] = &line[pos];
+        while (pos < len && line[pos] != ' ') {
+            ++pos;
+        }
+        lens[nwords] = &line[pos] - words[nwords];
+        ++nwords;
+    }
+    return nwords;
+}
+
+long
+packed_from_text(FILE *in, FILE *out, long *nskipped)
+{
+    struct input input;
+    if (!input_map(&input, in)) {
+        input_read(&input, in);
+    }
+
+    struct packed_writer *writer = NULL;
+    struct sudoku *puzzle = sudoku_create(3);
+    struct sudoku *solution = sudoku_create(3);
+    int nwords = 0;
+    long nrecords = 0;
+    *nskipped = 0;
+
+    size_t pos = 0;
+    while (pos < input.len) {
+        const char *line = &input.data[pos];
+        const char *nl = memchr(line, '\n', input.len - pos);
+        size_t len = nl ? (size_t) (nl - line) : input.len - pos;
+        pos += len + 1;
+        while (len > 0 && line[len - 1] == '\r') {
+            --len;
+        }
+        if (len == 0 || line[0] == '#') {
+            continue;
+        }
+
+        const char *words[3];
+        size_t lens[3];
+        const int n = packed_split(line, len, words, lens);
+        long nsols = 0;
+        int valid = n >= 1 && n <= 3 && (!writer || n == nwords)
+                    && sudoku_parse_line(puzzle, words[0], (int) lens[0])
+                    && (!writer || puzzle->size == writer->hdr.size);
+        if (valid && n >= 2) {
+            valid = sudoku_parse_line(solution, words[1], (int) lens[1])
+                    && solution->size == puzzle->size;
+        }
+        if (valid && n == 3) {
+            valid = packed_parse_count(words[2], lens[2], &nsols);
+        }
+
+        if (!writer && !valid && nrecords == 0 && *nskipped == 0) {
+            /* Not the one-line format, so the input is a single sudoku */
+            struct sudoku *sudoku = sudoku_parse(input.data, input.len);
+            if (sudoku) {
+                writer = packed_writer_create(out, sudoku->size, 0);
+                packed_writer_put(writer, sudoku, NULL, 0);
+                sudoku_free(sudoku);
+                nrecords = 1;
+                break;
+            }
+        }
+        if (!valid) {
+            ++*nskipped;
+            continue;
+        }
+
+        if (!writer) {
+            nwords = n;
+            writer = packed_writer_create(out, puzzle->size,
+                                          ((n >= 2) ? PACKED_SOLUTION : 0)
+                                          | ((n == 3) ? PACKED_COUNT : 0));
+        }
+        packed_writer_put(writer, puzzle, solution, nsols);
+        ++nrecords;
+    }
+
+    if (writer) {
+        packed_writer_free(writer);
+    }
+    sudoku_free(puzzle);
+    sudoku_free(solution);
+    input_free(&input);
+    return writer ? nrecords : -1;
+}
+
+long
+packed_to_text(FILE *in, FILE *out)
+{
+    struct packed_reader *reader = packed_reader_create(in);
+    if (!reader) {
+        return -1;
+    }
+    const struct packed_header *hdr = packed_reader_header(reader);
+    if (hdr->size * hdr->size > SUDOKU_LINE_MAX_NELEMS) {
+        packed_reader_free(reader);
+        return -1;
+    }
+
+    struct sudoku *puzzle = sudoku_create(hdr->size);
+    struct sudoku *solution = sudoku_create(hdr->size);
+    char *buf = malloc(2 * (puzzle->nelems * puzzle->nelems + 1) + 16);
+    long nrecords = 0;
+    long nsols;
+    int status;
+    while ((status = packed_reader_next(reader, puzzle, solution, &nsols)) != 0) {
+        ++nrecords;
+        if (status < 0) {
+            fputs("invalid\n", out);
+            continue;
+        }
+
+        int len = sudoku_sprint_line(buf, puzzle);
+        if (hdr->flags & PACKED_SOLUTION) {
+            buf[len - 1] = ' ';
+            len += sudoku_sprint_line(&buf[len], solution);
+        }
+        if (hdr->flags & PACKED_COUNT) {
+            buf[len - 1] = ' ';
+            len += (nsols == PACKED_COUNT_ABORTED) ? sprintf(&buf[len], "aborted\n")
+                 : (nsols == PACKED_COUNT_INVALID) ? sprintf(&buf[len], "invalid\n")
+                 : sprintf(&buf[len], "%ld\n", nsols);
+        }
+        fwrite(buf, 1, len, out);
+    }
+
+    free(buf);
+    sudoku_free(puzzle);
+    sudoku_free(solution);
+    packed_reader_free(reader);
+    return nrecords;
+}
@@ -0,0 +1,155 @@
+/* packed.h
+ *
+ * Header for storing sudokus in a packed binary format.
+ *
+ */
+
+#ifndef PACKED_H
+#define PACKED_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "sudoku.h"
+
+/* A packed file is a header of PACKED_HEADER_SIZE bytes followed by records
+ * of the same width, so record I starts at `packed_offset(HDR, I)' and a file
+ * can be mapped and split by offset. The header holds the magic "SDKP", the
+ * version, the block size, the flags, the bits per cell and the number of
+ * records as big-endian 8-byte integer. A record holds the cells of the
+ * puzzle, then those of its solution with PACKED_SOLUTION and the number of
+ * solutions as big-endian 4-byte integer with PACKED_COUNT. Cells take the
+ * fewest bits that hold NELEMS, 4 for 9x9 sudokus, and are packed least
+ * significant bit first. */
+#define PACKED_HEADER_SIZE 16
+
+#define PACKED_VERSION 1
+
+/* Optional fields of records */
+enum packed_flags {
+    PACKED_SOLUTION = 1,    /* Solution, all blanks if there is none */
+    PACKED_COUNT = 2        /* Number of solutions found, batch mode counts
+                             * up to 2 so 1 means unique, or one of the
+                             * PACKED_COUNT_* values below */
+};
+
+/* Numbers of solutions of records whose search was aborted resp. whose puzzle
+ * was no valid sudoku */
+#define PACKED_COUNT_ABORTED (-1)
+#define PACKED_COUNT_INVALID (-2)
+
+/* Number of records of files written to a stream that can't seek back to the
+ * header; they are read up to their end */
+#define PACKED_COUNT_UNKNOWN UINT64_MAX
+
+/* Header of a packed file and the layout of its records */
+struct packed_header {
+    int size;           /* Block size of all sudokus */
+    int flags;          /* Fields of the records (see `enum packed_flags') */
+    int bits;           /* Bits per cell */
+    size_t gridsize;    /* Bytes per grid */
+    size_t recsize;     /* Bytes per record */
+    uint64_t count;     /* Number of records, or PACKED_COUNT_UNKNOWN */
+};
+
+/* Set up HDR for records of sudokus with blocks of SIZE x SIZE cells (1 to 15)
+ * and the fields FLAGS, with unknown number of records */
+void
+packed_header_init(struct packed_header *hdr, int size, int flags);
+
+/* Write HDR to BUF, which must hold PACKED_HEADER_SIZE bytes */
+void
+packed_header_put(const struct packed_header *hdr, unsigned char *buf);
+
+/* Read header from the LEN bytes of BUF into HDR. Returns zero if BUF does not
+ * start with a valid header. */
+int
+packed_header_get(struct packed_header *hdr, const unsigned char *buf, size_t len);
+
+/* Returns offset of record I in files with header HDR */
+static inline uint64_t
+packed_offset(const struct packed_header *hdr, uint64_t i)
+{
+    return PACKED_HEADER_SIZE + i * hdr->recsize;
+}
+
+/* Write record of PUZZLE, its solution SOLUTION and number of solutions NSOLS
+ * to REC, which must hold HDR->RECSIZE bytes. Fields HDR has no flag for are
+ * left out. PUZZLE and SOLUTION must have the size of HDR, or be NULL for all
+ * blanks. */
+void
+packed_encode(const struct packed_header *hdr, unsigned char *rec,
+              const struct sudoku *puzzle, const struct sudoku *solution, long nsols);
+
+/* Read record REC into PUZZLE, SOLUTION and NSOLS, which may each be NULL if
+ * not wanted, and are left alone if HDR has no field for them. Sudokus must
+ * have the size of HDR. Returns zero if a cell is out of range. */
+int
+packed_decode(const struct packed_header *hdr, const unsigned char *rec,
+              struct sudoku *puzzle, struct sudoku *solution, long *nsols);
+
+/* Writer of packed records to a stream through an output buffer */
+struct packed_writer;
+
+/* Create writer of records with fields FLAGS of sudokus of block size SIZE to
+ * OUT, and write the header */
+struct packed_writer *
+packed_writer_create(FILE *out, int size, int flags);
+
+/* Write record of PUZZLE, SOLUTION and NSOLS with WRITER (see
+ * `packed_encode') */
+void
+packed_writer_put(struct packed_writer *writer, const struct sudoku *puzzle,
+                  const struct sudoku *solution, long nsols);
+
+/* Flush and free writer WRITER and enter the number of records in the header
+ * if the file can seek back to it; its file is left open. Returns number of
+ * records written. */
+uint64_t
+packed_writer_free(struct packed_writer *writer);
+
+/* Enter number of records COUNT in the header written at offset START of OUT
+ * and go back to the end. Returns zero if OUT can't seek. */
+int
+packed_write_count(FILE *out, long start, uint64_t count);
+
+/* Reader of packed records from a stream */
+struct packed_reader;
+
+/* Create reader of packed file IN and read its header. Returns NULL if IN does
+ * not start with one. */
+struct packed_reader *
+packed_reader_create(FILE *in);
+
+/* Free reader READER; its file is left open */
+void
+packed_reader_free(struct packed_reader *reader);
+
+/* Returns header of the file of READER */
+const struct packed_header *
+packed_reader_header(const struct packed_reader *reader);
+
+/* Read next record with READER as with `packed_decode'. Returns 1 if it was
+ * read, -1 if it holds cells out of range and 0 at the end of the file. */
+int
+packed_reader_next(struct packed_reader *reader, struct sudoku *puzzle,
+                   struct sudoku *solution, long *nsols);
+
+/* Convert sudokus from IN to a packed file OUT. IN holds a sudoku in any format
+ * `sudoku_parse' reads, or lines of "puzzle [solution [count]]" in one-line
+ * format as written by `packed_to_text', with count a number, "aborted" or
+ * "invalid". The first line sets the size and fields of the records; lines
+ * that don't match it are skipped, and their number is written to NSKIPPED.
+ * Returns number of records written, or -1 if IN holds no sudoku. */
+long
+packed_from_text(FILE *in, FILE *out, long *nskipped);
+
+/* Convert packed file IN to lines of "puzzle [solution [count]]" in one-line
+ * format on OUT, with the fields the records have, or "invalid" for records
+ * with cells out of range. Returns number of records converted, or -1 if IN is
+ * no packed file or its sudokus are too large for the one-line format. */
+long
+packed_to_text(FILE *in, FILE *out);
+
+#endif /* PACKED_H */
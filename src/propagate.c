@@ -0,0 +1,239 @@
+#include "propagate.h"
+
+#include "bits.h"
+
+/* Returns index of cell I of unit UNIT of sudoku with blocks of SIZE x SIZE
+ * cells. Units are numbered rows first, then columns, then blocks. */
+static int
+propagate_unit_cell(int size, int unit, int i)
+{
+    const int nelems = size * size;
+    const int k = unit % nelems;
+
+    if (unit < nelems) {
+        return k * nelems + i;
+    }
+    if (unit < 2 * nelems) {
+        return i * nelems + k;
+    }
+    return ((k / size) * size + i / size) * nelems + (k % size) * size + i % size;
+}
+
+/* Put ELEM into empty cell CELL of SUDOKU and remove it from the candidates
+ * CAND of all cells sharing a unit with CELL */
+static void
+propagate_place(struct sudoku *sudoku, uint64_t *cand, int cell, int elem)
+{
+    const int size = sudoku->size;
+    const int nelems = sudoku->nelems;
+    const int row = cell / nelems;
+    const int col = cell % nelems;
+    const int orow = (row / size) * size;
+    const int ocol = (col / size) * size;
+    const uint64_t mask = ~(UINT64_C(1) << (elem - 1));
+
+    sudoku->data[cell] = elem;
+    cand[cell] = 0;
+    for (int i = 0; i < nelems; ++i) {
+        cand[row * nelems + i] &= mask;
+        cand[i * nelems + col] &= mask;
+        cand[(orow + i / size) * nelems + ocol + i % size] &= mask;
+    }
+}
+
+/* Fill naked singles of SUDOKU with candidates CAND. Returns number of cells
+ * filled, or -1 if some empty cell has no candidate left. */
+static int
+propagate_naked(struct sudoku *sudoku, uint64_t *cand)
+{
+    const int ncells = sudoku->nelems * sudoku->nelems;
+    int nfilled = 0;
+
+    for (int cell = 0; cell < ncells; ++cell) {
+        if (sudoku->data[cell] != 0) {
+            continue;
+        }
+        if (cand[cell] == 0) {
+            return -1;
+        }
+        if (bits_popcount(cand[cell]) == 1) {
+            propagate_place(sudoku, cand, cell, bits_ctz(cand[cell]) + 1);
+            ++nfilled;
+        }
+    }
+
+    return nfilled;
+}
+
+/* Fill hidden singles of SUDOKU with candidates CAND, i.e. digits with only
+ * one place left in some unit. Returns number of cells filled, or -1 if some
+ * digit has no place left in some unit. */
+static int
+propagate_hidden(struct sudoku *sudoku, uint64_t *cand, uint64_t all)
+{
+    const int size = sudoku->size;
+    const int nelems = sudoku->nelems;
+    int nfilled = 0;
+
+    for (int unit = 0; unit < 3 * nelems; ++unit) {
+        uint64_t used = 0;
+        uint64_t once = 0;
+        uint64_t twice = 0;
+        for (int i = 0; i < nelems; ++i) {
+            const int cell = propagate_unit_cell(size, unit, i);
+            if (sudoku->data[cell] != 0) {
+                used |= UINT64_C(1) << (sudoku->data[cell] - 1);
+            }
+            twice |= once & cand[cell];
+            once |= cand[cell];
+        }
+        if ((once | used) != all) {
+            return -1;
+        }
+
+        for (uint64_t single = once & ~twice; single; single &= single - 1) {
+            const uint64_t bit = single & -single;
+            int i = 0;
+            while (i < nelems && !(cand[propagate_unit_cell(size, unit, i)] & bit)) {
+                ++i;
+            }
+            /* An earlier single of this unit took the only place */
+            if (i == nelems) {
+                return -1;
+            }
+            propagate_place(sudoku, cand, propagate_unit_cell(size, unit, i),
+                            bits_ctz(bit) + 1);
+            ++nfilled;
+        }
+    }
+
+    return nfilled;
+}
+
+/* Remove candidates CAND of sudoku SUDOKU by locked candidates: a digit that
+ * lies on one line within a block is removed from the rest of that line, and
+ * a digit that lies in one block within a line is removed from the rest of
+ * that block. Returns whether any candidate was removed. */
+static int
+propagate_locked(const struct sudoku *sudoku, uint64_t *cand)
+{
+    const int size = sudoku->size;
+    const int nelems = sudoku->nelems;
+    int changed = 0;
+
+    /* Columns are handled as the rows of the transposed grid */
+    for (int trans = 0; trans < 2; ++trans) {
+        const int rstep = trans ? 1 : nelems;
+        const int cstep = trans ? nelems : 1;
+
+        for (int band = 0; band < size; ++band) {
+            /* Candidates of line I of the band within block J */
+            uint64_t segs[PROPAGATE_MAX_NELEMS];
+            for (int i = 0; i < size; ++i) {
+                for (int j = 0; j < size; ++j) {
+                    uint64_t seg = 0;
+                    for (int k = 0; k < size; ++k) {
+                        seg |= cand[(band * size + i) * rstep + (j * size + k) * cstep];
+                    }
+                    segs[i * size + j] = seg;
+                }
+            }
+
+            for (int i = 0; i < size; ++i) {
+                for (int j = 0; j < size; ++j) {
+                    uint64_t inblock = 0;
+                    uint64_t inline_ = 0;
+                    for (int k = 0; k < size; ++k) {
+                        if (k != i) {
+                            inblock |= segs[k * size + j];
+                        }
+                        if (k != j) {
+                            inline_ |= segs[i * size + k];
+                        }
+                    }
+                    const uint64_t pointing = segs[i * size + j] & ~inblock;
+                    const uint64_t claiming = segs[i * size + j] & ~inline_;
+
+                    for (int k = 0; k < nelems; ++k) {
+                        /* Rest of the line */
+                        int cell = (band * size + i) * rstep + k * cstep;
+                        if (k / size != j && (cand[cell] & pointing)) {
+                            cand[cell] &= ~pointing;
+                            changed = 1;
+                        }
+                        /* Rest of the block */
+                        cell = (band * size + k / size) * rstep
+                               + (j * size + k % size) * cstep;
+                        if (k / size != i && (cand[cell] & claiming)) {
+                            cand[cell] &= ~claiming;
+                            changed = 1;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return changed;
+}
+
+int
+sudoku_propagate(struct sudoku *sudoku, uint64_t *cand, enum sudoku_propagate level)
+{
+    const int size = sudoku->size;
+    const int nelems = sudoku->nelems;
+    const int ncells = nelems * nelems;
+    const uint64_t all = (nelems == 64) ? ~UINT64_C(0) : (UINT64_C(1) << nelems) - 1;
+
+    /* Digits used per row, column and block */
+    uint64_t used[3 * PROPAGATE_MAX_NELEMS] = { 0 };
+    for (int cell = 0; cell < ncells; ++cell) {
+        const int elem = sudoku->data[cell];
+        if (elem == 0) {
+            continue;
+        }
+        const uint64_t bit = UINT64_C(1) << (elem - 1);
+        const int row = cell / nelems;
+        const int col = cell % nelems;
+        const int block = (row / size) * size + col / size;
+        /* Givens contradicting each other leave no solution */
+        if ((used[row] | used[nelems + col] | used[2 * nelems + block]) & bit) {
+            return -1;
+        }
+        used[row] |= bit;
+        used[nelems + col] |= bit;
+        used[2 * nelems + block] |= bit;
+    }
+    for (int cell = 0; cell < ncells; ++cell) {
+        const int row = cell / nelems;
+        const int col = cell % nelems;
+        const int block = (row / size) * size + col / size;
+        cand[cell] = (sudoku->data[cell] != 0) ? 0
+                   : all & ~(used[row] | used[nelems + col] | used[2 * nelems + block]);
+    }
+
+    if (level == SUDOKU_PROPAGATE_NONE) {
+        return 0;
+    }
+
+    int nfilled = 0;
+    for (;;) {
+        const int nnaked = propagate_naked(sudoku, cand);
+        if (nnaked < 0) {
+            return -1;
+        }
+        const int nhidden = propagate_hidden(sudoku, cand, all);
+        if (nhidden < 0) {
+            return -1;
+        }
+        nfilled += nnaked + nhidden;
+
+        /* Locked candidates are only looked for once singles ran dry */
+        if (nnaked + nhidden == 0
+            && (level != SUDOKU_PROPAGATE_LOCKED || !propagate_locked(sudoku, cand))) {
+            break;
+        }
+    }
+
+    return nfilled;
+}
@@ -0,0 +1,27 @@
+/* propagate.h
+ *
+ * Header for constraint propagation on sudokus before searching.
+ *
+ */
+
+#ifndef PROPAGATE_H
+#define PROPAGATE_H
+
+#include <inttypes.h>
+
+#include "sudoku.h"
+
+/* Largest number of elements propagation handles (one bit per digit) */
+#define PROPAGATE_MAX_NELEMS 64
+
+/* Fill cells of SUDOKU that are forced by naked and hidden singles until none
+ * is left. With LEVEL SUDOKU_PROPAGATE_LOCKED locked candidates are used to
+ * remove candidates as well; with SUDOKU_PROPAGATE_NONE no cell is filled.
+ * Candidates of all cells are written to CAND (NELEMS * NELEMS masks, bit
+ * ELEM - 1 for ELEM, zero for filled cells). SUDOKU must have at most
+ * PROPAGATE_MAX_NELEMS elements. Returns number of cells filled, or -1 if
+ * SUDOKU has no solution. */
+int
+sudoku_propagate(struct sudoku *sudoku, uint64_t *cand, enum sudoku_propagate level);
+
+#endif /* PROPAGATE_H */
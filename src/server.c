@@ -0,0 +1,726 @@
+#define _POSIX_C_SOURCE 200809L /* clock_gettime, sigaction, pthread_sigmask */
+
+#include "server.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Size of the buffer requests of a connection are read into; it holds many
+ * frames, so pipelined requests take few reads */
+#define SERVER_READ_SIZE 65536
+
+/* Initial size of the buffers responses of a connection are gathered in while
+ * it is being written to; they grow as needed */
+#define SERVER_OUT_SIZE 16384
+
+/* Largest response payload: a solution, or the text of a stats response */
+#define SERVER_MAX_RESPONSE 2048
+
+struct server;
+
+/* Connection of a client, or standard input and output */
+struct server_conn {
+    struct server *server;
+    int in;
+    int out;
+    int owned;                  /* Whether IN (= OUT) is closed with it */
+    pthread_mutex_t lock;       /* Guards all below */
+    pthread_cond_t idle;        /* Signalled when NJOBS drops to zero */
+    pthread_cond_t room;        /* Signalled when NJOBS drops below
+                                 * SERVER_MAX_INFLIGHT */
+    int njobs;                  /* Requests read whose response is not written
+                                 * yet */
+    int nqueued;                /* Answered requests of OUTBUF */
+    int reading;                /* Whether requests are still read */
+    int writing;                /* Whether a worker is writing responses */
+    int broken;                 /* Whether writing failed; responses are then
+                                 * dropped */
+    size_t outlen;
+    size_t outcap;
+    unsigned char *outbuf;      /* Responses not written yet */
+    size_t sparecap;
+    unsigned char *spare;       /* Buffer swapped with OUTBUF when written */
+    struct server_conn *next;   /* Next open connection of the server */
+};
+
+/* Request waiting for or being answered by a worker */
+struct server_job {
+    struct server_conn *conn;
+    uint32_t id;
+    int type;
+    double start;               /* Time the request was read */
+    int len;
+    char payload[SERVER_MAX_PAYLOAD];
+    struct server_job *next;
+};
+
+/* State shared by all threads */
+struct server {
+    pthread_mutex_t lock;       /* Guards the queue, the jobs to be reused, the
+                                 * connections and STOP */
+    pthread_cond_t ready;       /* Signalled when a job is queued or STOP set */
+    pthread_cond_t closed;      /* Signalled when a connection is closed */
+    struct server_job *head;    /* Queue of requests, oldest first */
+    struct server_job *tail;
+    struct server_job *spare;   /* Answered jobs to be reused */
+    struct server_conn *conns;  /* Open connections */
+    int stop;
+    struct dlcancel *cancel;    /* Raised to abort searches when stopping */
+    struct cache *cache;        /* NULL if there is none */
+    pthread_mutex_t stats_lock; /* Guards all below */
+    double start;               /* Time the server started */
+    long nrequests;             /* Solve requests answered */
+    long nsolved;
+    long nunsolvable;
+    long ninvalid;
+    long naborted;
+    double last_time;           /* Time and NREQUESTS of last stats request */
+    long last_requests;
+    long nlatencies;            /* Latencies recorded, the last ones are kept */
+    double *latencies;          /* Ring of SERVER_LATENCY_SAMPLES latencies in
+                                 * microseconds */
+};
+
+/* Worker thread. Its solver and grids are set up once and reused for all
+ * requests it answers. */
+struct server_worker {
+    pthread_t thread;
+    struct server *server;
+    struct sudoku_solver *solver;
+    struct canon *canon;        /* NULL if the server has no cache */
+    struct sudoku *puzzle;
+    struct sudoku *solution;
+    double *sorted;             /* Latencies sorted for stats requests */
+    unsigned char response[SERVER_HEADER_SIZE + SERVER_MAX_RESPONSE];
+};
+
+/* Set by SIGINT and SIGTERM to stop a socket server */
+static volatile sig_atomic_t server_stopped;
+
+static void
+server_handle_signal(int sig)
+{
+    (void) sig;
+    server_stopped = 1;
+}
+
+/* Returns wall clock time in seconds */
+static double
+server_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/* Write the LEN bytes of BUF to FD. Returns zero on error. */
+static int
+server_write_all(int fd, const unsigned char *buf, size_t len)
+{
+    while (len > 0) {
+        const ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 0;
+        }
+        buf += n;
+        len -= (size_t) n;
+    }
+    return 1;
+}
+
+/* Create connection of SERVER reading from IN and writing to OUT, closed with
+ * the connection if OWNED is set */
+static struct server_conn *
+server_conn_create(struct server *server, int in, int out, int owned)
+{
+    struct server_conn *conn = malloc(sizeof *conn);
+    conn->server = server;
+    conn->in = in;
+    conn->out = out;
+    conn->owned = owned;
+    pthread_mutex_init(&conn->lock, NULL);
+    pthread_cond_init(&conn->idle, NULL);
+    pthread_cond_init(&conn->room, NULL);
+    conn->njobs = 0;
+    conn->nqueued = 0;
+    conn->reading = 1;
+    conn->writing = 0;
+    conn->broken = 0;
+    conn->outlen = 0;
+    conn->outcap = SERVER_OUT_SIZE;
+    conn->outbuf = malloc(conn->outcap);
+    conn->sparecap = SERVER_OUT_SIZE;
+    conn->spare = malloc(conn->sparecap);
+    return conn;
+}
+
+static void
+server_conn_free(struct server_conn *conn)
+{
+    if (conn->owned) {
+        close(conn->in);
+    }
+    pthread_mutex_destroy(&conn->lock);
+    pthread_cond_destroy(&conn->idle);
+    pthread_cond_destroy(&conn->room);
+    free(conn->outbuf);
+    free(conn->spare);
+    free(conn);
+}
+
+/* Queue request of type TYPE with id ID and the LEN bytes of PAYLOAD read from
+ * connection CONN. Waits while CONN has SERVER_MAX_INFLIGHT requests whose
+ * responses are not written, so a client that does not read its responses
+ * only holds up itself, and neither fills the queue shared by all
+ * connections nor the memory of the server. */
+static void
+server_submit(struct server_conn *conn, uint32_t id, int type,
+              const unsigned char *payload, int len)
+{
+    struct server *server = conn->server;
+
+    pthread_mutex_lock(&conn->lock);
+    while (conn->njobs >= SERVER_MAX_INFLIGHT) {
+        pthread_cond_wait(&conn->room, &conn->lock);
+    }
+    ++conn->njobs;
+    pthread_mutex_unlock(&conn->lock);
+
+    pthread_mutex_lock(&server->lock);
+    struct server_job *job = server->spare;
+    if (job) {
+        server->spare = job->next;
+    } else {
+        job = malloc(sizeof *job);
+    }
+    job->conn = conn;
+    job->id = id;
+    job->type = type;
+    job->start = server_time();
+    job->len = len;
+    memcpy(job->payload, payload, len);
+    job->next = NULL;
+    if (server->tail) {
+        server->tail->next = job;
+    } else {
+        server->head = job;
+    }
+    server->tail = job;
+    pthread_cond_signal(&server->ready);
+    pthread_mutex_unlock(&server->lock);
+}
+
+/* Read requests from connection CONN and queue them until it ends or breaks
+ * the protocol */
+static void
+server_conn_read(struct server_conn *conn)
+{
+    unsigned char *buf = malloc(SERVER_READ_SIZE);
+    size_t len = 0;
+    int ok = 1;
+
+    while (ok) {
+        const ssize_t n = read(conn->in, buf + len, SERVER_READ_SIZE - len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        len += (size_t) n;
+
+        /* Queue all complete frames, and keep the rest for the next read */
+        size_t pos = 0;
+        while (ok && len - pos >= 4) {
+            const uint32_t flen = server_get_u32(buf + pos);
+            if (flen < SERVER_HEADER_SIZE - 4
+                || flen > SERVER_HEADER_SIZE - 4 + SERVER_MAX_PAYLOAD) {
+                ok = 0;
+            } else if (len - pos >= 4 + flen) {
+                server_submit(conn, server_get_u32(buf + pos + 4), buf[pos + 8],
+                              buf + pos + SERVER_HEADER_SIZE,
+                              (int) (flen + 4 - SERVER_HEADER_SIZE));
+                pos += 4 + flen;
+            } else {
+                break;
+            }
+        }
+        memmove(buf, buf + pos, len - pos);
+        len -= pos;
+    }
+
+    free(buf);
+}
+
+/* Remove connection CONN from the open connections of its server and free
+ * it */
+static void
+server_conn_close(struct server_conn *conn)
+{
+    struct server *server = conn->server;
+    pthread_mutex_lock(&server->lock);
+    for (struct server_conn **link = &server->conns; *link; link = &(*link)->next) {
+        if (*link == conn) {
+            *link = conn->next;
+            break;
+        }
+    }
+    pthread_cond_broadcast(&server->closed);
+    pthread_mutex_unlock(&server->lock);
+    server_conn_free(conn);
+}
+
+/* Hand response of LEN bytes in BUF to connection CONN, whose request is
+ * answered with it. The response is written right away unless another worker
+ * is writing to CONN; that worker then writes it with all others answered in
+ * the meantime once its write is done. The connection is closed once it is
+ * read to the end and its last response is written. */
+static void
+server_conn_respond(struct server_conn *conn, const unsigned char *buf, size_t len)
+{
+    pthread_mutex_lock(&conn->lock);
+    if (!conn->broken) {
+        if (conn->outlen + len > conn->outcap) {
+            conn->outcap = 2 * (conn->outlen + len);
+            conn->outbuf = realloc(conn->outbuf, conn->outcap);
+        }
+        memcpy(conn->outbuf + conn->outlen, buf, len);
+        conn->outlen += len;
+    }
+    ++conn->nqueued;
+    if (conn->writing) {
+        pthread_mutex_unlock(&conn->lock);
+        return;
+    }
+
+    /* Write what is queued without holding the lock, so that other workers
+     * can queue their responses meanwhile */
+    conn->writing = 1;
+    while (conn->nqueued > 0) {
+        unsigned char *out = conn->outbuf;
+        const size_t outlen = conn->outlen;
+        const size_t outcap = conn->outcap;
+        const int nwritten = conn->nqueued;
+        const int intact = !conn->broken;
+        conn->outbuf = conn->spare;
+        conn->outcap = conn->sparecap;
+        conn->outlen = 0;
+        conn->nqueued = 0;
+        pthread_mutex_unlock(&conn->lock);
+
+        const int ok = !intact || server_write_all(conn->out, out, outlen);
+
+        pthread_mutex_lock(&conn->lock);
+        conn->spare = out;
+        conn->sparecap = outcap;
+        if (!ok) {
+            conn->broken = 1;
+        }
+        conn->njobs -= nwritten;
+        pthread_cond_signal(&conn->room);
+    }
+    conn->writing = 0;
+    if (conn->njobs == 0) {
+        pthread_cond_broadcast(&conn->idle);
+    }
+    const int done = conn->njobs == 0 && !conn->reading;
+    pthread_mutex_unlock(&conn->lock);
+
+    if (done) {
+        server_conn_close(conn);
+    }
+}
+
+/* Thread reading requests of a client connection ARG */
+static void *
+server_conn_run(void *arg)
+{
+    struct server_conn *conn = arg;
+    server_conn_read(conn);
+
+    pthread_mutex_lock(&conn->lock);
+    conn->reading = 0;
+    const int done = conn->njobs == 0;
+    pthread_mutex_unlock(&conn->lock);
+
+    if (done) {
+        server_conn_close(conn);
+    }
+    return NULL;
+}
+
+/* Take oldest request off the queue of SERVER, waiting for one if it is empty.
+ * Returns NULL once the server is stopped. */
+static struct server_job *
+server_pop(struct server *server)
+{
+    pthread_mutex_lock(&server->lock);
+    while (!server->head && !server->stop) {
+        pthread_cond_wait(&server->ready, &server->lock);
+    }
+    struct server_job *job = server->head;
+    if (job) {
+        server->head = job->next;
+        if (!server->head) {
+            server->tail = NULL;
+        }
+    }
+    pthread_mutex_unlock(&server->lock);
+    return job;
+}
+
+/* Keep answered job JOB of SERVER for reuse */
+static void
+server_recycle(struct server *server, struct server_job *job)
+{
+    pthread_mutex_lock(&server->lock);
+    job->next = server->spare;
+    server->spare = job;
+    pthread_mutex_unlock(&server->lock);
+}
+
+/* Count solve request answered with status STATUS after LATENCY seconds */
+static void
+server_record(struct server *server, int status, double latency)
+{
+    pthread_mutex_lock(&server->stats_lock);
+    ++server->nrequests;
+    server->nsolved += status == SERVER_STATUS_SOLVED;
+    server->nunsolvable += status == SERVER_STATUS_UNSOLVABLE;
+    server->ninvalid += status == SERVER_STATUS_INVALID;
+    server->naborted += status == SERVER_STATUS_ABORTED;
+    server->latencies[server->nlatencies++ % SERVER_LATENCY_SAMPLES] = 1e6 * latency;
+    pthread_mutex_unlock(&server->stats_lock);
+}
+
+static int
+server_compare(const void *a, const void *b)
+{
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/* Returns the P-quantile of the N ascending values VALUES (nearest rank) */
+static double
+server_quantile(const double *values, long n, double p)
+{
+    long rank = (long) (p * n + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+    return values[rank - 1];
+}
+
+/* Write statistics of the server of WORKER to BUF as text. Returns its
+ * length. */
+static int
+server_worker_stats(struct server_worker *worker, char *buf)
+{
+    struct server *server = worker->server;
+    const double now = server_time();
+
+    pthread_mutex_lock(&server->stats_lock);
+    const long n = (server->nlatencies < SERVER_LATENCY_SAMPLES) ? server->nlatencies
+                                                                 : SERVER_LATENCY_SAMPLES;
+    memcpy(worker->sorted, server->latencies, n * sizeof *worker->sorted);
+    const long nrequests = server->nrequests;
+    const long nsolved = server->nsolved;
+    const long nunsolvable = server->nunsolvable;
+    const long ninvalid = server->ninvalid;
+    const long naborted = server->naborted;
+    const double seconds = now - server->last_time;
+    const double rate = seconds > 0 ? (nrequests - server->last_requests) / seconds : 0;
+    server->last_time = now;
+    server->last_requests = nrequests;
+    pthread_mutex_unlock(&server->stats_lock);
+
+    struct cache_stats cstats;
+    memset(&cstats, 0, sizeof cstats);
+    if (server->cache) {
+        cache_stats(server->cache, &cstats);
+    }
+
+    qsort(worker->sorted, n, sizeof *worker->sorted, &server_compare);
+    return sprintf(buf, "requests %ld\nsolved %ld\nunsolvable %ld\ninvalid %ld\n"
+                   "aborted %ld\nuptime_s %.3f\nrate_per_s %.1f\np50_us %.1f\n"
+                   "p99_us %.1f\ncache_hits %ld\ncache_hit_rate %.3f\n",
+                   nrequests, nsolved, nunsolvable, ninvalid, naborted, now - server->start,
+                   rate, n ? server_quantile(worker->sorted, n, 0.5) : 0.0,
+                   n ? server_quantile(worker->sorted, n, 0.99) : 0.0, cstats.hits,
+                   cstats.lookups ? (double) cstats.hits / cstats.lookups : 0.0);
+}
+
+/* Answer request JOB with WORKER into the response buffer of WORKER and
+ * return the status */
+static int
+server_worker_answer(struct server_worker *worker, const struct server_job *job,
+                     size_t *len)
+{
+    char *payload = (char *) worker->response + SERVER_HEADER_SIZE;
+    int status = SERVER_STATUS_INVALID;
+    int plen = 0;
+
+    if (job->type == SERVER_REQUEST_STATS) {
+        status = SERVER_STATUS_STATS;
+        plen = server_worker_stats(worker, payload);
+    } else if (job->type == SERVER_REQUEST_SOLVE
+               && sudoku_parse_line(worker->puzzle, job->payload, job->len)) {
+        if (worker->solution->size != worker->puzzle->size) {
+            sudoku_free(worker->solution);
+            worker->solution = sudoku_create(worker->puzzle->size);
+        }
+        struct cache *cache = worker->server->cache;
+        if (cache && cache_lookup(cache, worker->canon, worker->puzzle, worker->solution)) {
+            status = SERVER_STATUS_SOLVED;
+        } else if (sudoku_solver_solve(worker->solver, worker->puzzle, worker->solution)) {
+            status = SERVER_STATUS_SOLVED;
+            if (cache) {
+                cache_store(cache, worker->canon, worker->solution);
+            }
+        } else if (sudoku_solver_stats(worker->solver)->aborted != DLABORT_NONE) {
+            status = SERVER_STATUS_ABORTED;
+        } else {
+            status = SERVER_STATUS_UNSOLVABLE;
+        }
+        if (status == SERVER_STATUS_SOLVED) {
+            /* Without the newline */
+            plen = sudoku_sprint_line(payload, worker->solution) - 1;
+        }
+    }
+
+    server_put_header(worker->response, (uint32_t) plen, job->id, status);
+    *len = SERVER_HEADER_SIZE + (size_t) plen;
+    return status;
+}
+
+static void *
+server_worker_run(void *arg)
+{
+    struct server_worker *worker = arg;
+    struct server *server = worker->server;
+
+    struct server_job *job;
+    while ((job = server_pop(server)) != NULL) {
+        size_t len;
+        const int status = server_worker_answer(worker, job, &len);
+        if (job->type != SERVER_REQUEST_STATS) {
+            server_record(server, status, server_time() - job->start);
+        }
+        server_conn_respond(job->conn, worker->response, len);
+        server_recycle(server, job);
+    }
+
+    return NULL;
+}
+
+/* Serve requests from standard input on SERVER until it ends */
+static void
+server_serve_stdio(struct server *server)
+{
+    /* Standard input and output are not closed, and the connection is never
+     * done reading, so it stays with this function */
+    struct server_conn *conn = server_conn_create(server, STDIN_FILENO, STDOUT_FILENO, 0);
+    server_conn_read(conn);
+
+    pthread_mutex_lock(&conn->lock);
+    while (conn->njobs > 0) {
+        pthread_cond_wait(&conn->idle, &conn->lock);
+    }
+    pthread_mutex_unlock(&conn->lock);
+    server_conn_free(conn);
+}
+
+/* Serve clients connecting to socket PATH on SERVER until SIGINT or SIGTERM.
+ * Signals are blocked by the caller while threads are created; MASK is the
+ * signal mask to restore. Returns zero if the socket could not be set up. */
+static int
+server_serve_socket(struct server *server, const char *path, const sigset_t *mask)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof addr.sun_path) {
+        fprintf(stderr, "Socket path '%s' is too long!\n", path);
+        return 0;
+    }
+    strcpy(addr.sun_path, path);
+
+    /* A socket left behind by an earlier server is replaced, anything else
+     * is not touched */
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof addr) != 0
+        || listen(fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "Could not listen on socket '%s'!\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 0;
+    }
+
+    /* Signals only interrupt this thread, and stop it between connections */
+    struct sigaction sa, oldint, oldterm;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = &server_handle_signal;
+    sigemptyset(&sa.sa_mask);
+    server_stopped = 0;
+    sigaction(SIGINT, &sa, &oldint);
+    sigaction(SIGTERM, &sa, &oldterm);
+    sigset_t blocked;
+    pthread_sigmask(SIG_SETMASK, mask, &blocked);
+
+    while (!server_stopped) {
+        const int client = accept(fd, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+        struct server_conn *conn = server_conn_create(server, client, client, 1);
+        pthread_mutex_lock(&server->lock);
+        conn->next = server->conns;
+        server->conns = conn;
+        pthread_mutex_unlock(&server->lock);
+
+        pthread_t thread;
+        pthread_sigmask(SIG_SETMASK, &blocked, NULL);
+        if (pthread_create(&thread, NULL, &server_conn_run, conn) == 0) {
+            pthread_detach(thread);
+        } else {
+            server_conn_close(conn);
+        }
+        pthread_sigmask(SIG_SETMASK, mask, NULL);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &blocked, NULL);
+    sigaction(SIGINT, &oldint, NULL);
+    sigaction(SIGTERM, &oldterm, NULL);
+    close(fd);
+    unlink(path);
+
+    /* End reading of all clients, so their connections close once their
+     * requests are answered, which those still to be solved are right away */
+    dlcancel_set(server->cancel, 1);
+    pthread_mutex_lock(&server->lock);
+    for (struct server_conn *conn = server->conns; conn; conn = conn->next) {
+        shutdown(conn->in, SHUT_RD);
+    }
+    while (server->conns) {
+        pthread_cond_wait(&server->closed, &server->lock);
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    return 1;
+}
+
+int
+server_run(const struct server_options *opts)
+{
+    struct server server;
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.ready, NULL);
+    pthread_cond_init(&server.closed, NULL);
+    server.head = NULL;
+    server.tail = NULL;
+    server.spare = NULL;
+    server.conns = NULL;
+    server.stop = 0;
+    server.cancel = dlcancel_create();
+    server.cache = opts->cache;
+    pthread_mutex_init(&server.stats_lock, NULL);
+    server.start = server_time();
+    server.nrequests = 0;
+    server.nsolved = 0;
+    server.nunsolvable = 0;
+    server.ninvalid = 0;
+    server.naborted = 0;
+    server.last_time = server.start;
+    server.last_requests = 0;
+    server.nlatencies = 0;
+    server.latencies = malloc(SERVER_LATENCY_SAMPLES * sizeof *server.latencies);
+
+    /* Workers solve one puzzle at a time each, so the search is not split.
+     * Writing to a client that went away must not kill the server, and
+     * signals are left to the thread serving the socket. */
+    struct sudoku_options wopts = opts->solve;
+    wopts.search.nthreads = 1;
+    if (!wopts.search.bounds.cancel) {
+        wopts.search.bounds.cancel = server.cancel;
+    }
+    struct sigaction sa, oldpipe;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = SIG_IGN;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPIPE, &sa, &oldpipe);
+    sigset_t stop, mask;
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop, &mask);
+
+    const int nthreads = (opts->nthreads > 0) ? opts->nthreads : 1;
+    struct server_worker *workers = malloc(nthreads * sizeof *workers);
+    for (int i = 0; i < nthreads; ++i) {
+        struct server_worker *worker = &workers[i];
+        worker->server = &server;
+        worker->solver = sudoku_solver_create(&wopts);
+        worker->canon = opts->cache ? canon_create() : NULL;
+        worker->puzzle = sudoku_create(3);
+        worker->solution = sudoku_create(3);
+        worker->sorted = malloc(SERVER_LATENCY_SAMPLES * sizeof *worker->sorted);
+        pthread_create(&worker->thread, NULL, &server_worker_run, worker);
+    }
+
+    int ok = 1;
+    if (strcmp(opts->path, "-") == 0) {
+        pthread_sigmask(SIG_SETMASK, &mask, NULL);
+        server_serve_stdio(&server);
+    } else {
+        ok = server_serve_socket(&server, opts->path, &mask);
+        pthread_sigmask(SIG_SETMASK, &mask, NULL);
+    }
+
+    pthread_mutex_lock(&server.lock);
+    server.stop = 1;
+    pthread_cond_broadcast(&server.ready);
+    pthread_mutex_unlock(&server.lock);
+    for (int i = 0; i < nthreads; ++i) {
+        struct server_worker *worker = &workers[i];
+        pthread_join(worker->thread, NULL);
+        sudoku_solver_free(worker->solver);
+        canon_free(worker->canon);
+        sudoku_free(worker->puzzle);
+        sudoku_free(worker->solution);
+        free(worker->sorted);
+    }
+    free(workers);
+    sigaction(SIGPIPE, &oldpipe, NULL);
+
+    while (server.spare) {
+        struct server_job *job = server.spare;
+        server.spare = job->next;
+        free(job);
+    }
+    free(server.latencies);
+    dlcancel_free(server.cancel);
+    pthread_mutex_destroy(&server.stats_lock);
+    pthread_cond_destroy(&server.closed);
+    pthread_cond_destroy(&server.ready);
+    pthread_mutex_destroy(&server.lock);
+
+    return ok;
+}
@@ -0,0 +1,98 @@
+/* server.h
+ *
+ * Header for serving sudoku requests over a Unix domain socket or standard
+ * input and output.
+ *
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <inttypes.h>
+
+#include "cache.h"
+#include "sudoku.h"
+
+/* Requests and responses are frames: a 4-byte length L, then L bytes holding a
+ * 4-byte request id, a 1-byte type (requests) resp. status (responses) and the
+ * payload. Integers are big-endian. Responses carry the id of their request,
+ * and as requests are solved in parallel they may come in any order. */
+#define SERVER_HEADER_SIZE 9
+
+/* Largest payload of a request; a puzzle in one-line format of up to 35x35
+ * cells fits. Longer frames close the connection. */
+#define SERVER_MAX_PAYLOAD 2048
+
+/* Requests of a connection the server reads ahead of their responses being
+ * written. Beyond that it stops reading from the connection, so a client that
+ * keeps more requests in flight must read responses while it sends. */
+#define SERVER_MAX_INFLIGHT 256
+
+/* Number of latencies kept for the percentiles of stats requests */
+#define SERVER_LATENCY_SAMPLES 65536
+
+/* Types of requests */
+enum server_request {
+    SERVER_REQUEST_SOLVE,   /* Payload is a puzzle in one-line format */
+    SERVER_REQUEST_STATS    /* No payload */
+};
+
+/* Status of responses */
+enum server_status {
+    SERVER_STATUS_SOLVED,       /* Payload is the solution in one-line format */
+    SERVER_STATUS_UNSOLVABLE,   /* No payload */
+    SERVER_STATUS_INVALID,      /* Payload was no valid puzzle, or the request
+                                 * type is unknown; no payload */
+    SERVER_STATUS_STATS,        /* Payload is text, one "name value" line per
+                                 * figure (see `server_run') */
+    SERVER_STATUS_ABORTED       /* Search ran into the bounds of the options,
+                                 * or the server is stopping; no payload */
+};
+
+/* Options of the server */
+struct server_options {
+    const char *path;       /* Socket to listen on, "-" to read requests from
+                             * standard input and answer on standard output */
+    int nthreads;           /* Number of worker threads */
+    struct sudoku_options solve;
+    struct cache *cache;    /* Cache of solutions shared by the workers, NULL
+                             * for none */
+};
+
+/* Write header of a frame with payload of LEN bytes, request id ID and type or
+ * status TYPE to BUF, which must hold SERVER_HEADER_SIZE bytes */
+static inline void
+server_put_header(unsigned char *buf, uint32_t len, uint32_t id, int type)
+{
+    const uint32_t flen = len + SERVER_HEADER_SIZE - 4;
+    for (int i = 0; i < 4; ++i) {
+        buf[i] = (unsigned char) (flen >> (24 - 8 * i));
+        buf[4 + i] = (unsigned char) (id >> (24 - 8 * i));
+    }
+    buf[8] = (unsigned char) type;
+}
+
+/* Returns big-endian 4-byte integer at BUF */
+static inline uint32_t
+server_get_u32(const unsigned char *buf)
+{
+    return ((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16)
+           | ((uint32_t) buf[2] << 8) | (uint32_t) buf[3];
+}
+
+/* Serve requests as set in OPTS until standard input ends, or the server is
+ * stopped by SIGINT or SIGTERM when listening on a socket. Then searches still
+ * running or queued are cancelled, unless OPTS has a cancellation flag of its
+ * own. Every worker thread keeps its own solver, and every connection may have
+ * up to SERVER_MAX_INFLIGHT requests in flight, each searched within the
+ * bounds of OPTS.
+ * A stats request is answered with the number of requests, the
+ * request rate since the previous stats request, the 50th and 99th
+ * percentile of the latency from reading a request to its response being
+ * ready, over the last SERVER_LATENCY_SAMPLES requests, and the hits and hit
+ * rate of the cache. Returns zero if the
+ * socket could not be set up. */
+int
+server_run(const struct server_options *opts);
+
+#endif /* SERVER_H */
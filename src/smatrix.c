@@ -0,0 +1,139 @@
+#include "smatrix.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Initial capacities; both grow by doubling unless reserved up front */
+#define SMATRIX_INIT_LINES 64
+#define SMATRIX_INIT_ELEMS 256
+
+struct smatrix *
+smatrix_create(int nrows, int ncols)
+{
+    struct smatrix *smat = malloc(sizeof *smat);
+
+    smat->nrows = nrows;
+    smat->ncols = ncols;
+    smat->nlines = 0;
+    smat->nelems = 0;
+    smat->maxlines = SMATRIX_INIT_LINES;
+    smat->maxelems = SMATRIX_INIT_ELEMS;
+    smat->ids = malloc(smat->maxlines * sizeof *smat->ids);
+    smat->offsets = malloc((smat->maxlines + 1) * sizeof *smat->offsets);
+    smat->cols = malloc(smat->maxelems * sizeof *smat->cols);
+    smat->offsets[0] = 0;
+
+    return smat;
+}
+
+void
+smatrix_free(struct smatrix *smat)
+{
+    if (!smat) {
+        return;
+    }
+    free(smat->ids);
+    free(smat->offsets);
+    free(smat->cols);
+    free(smat);
+}
+
+void
+smatrix_reset(struct smatrix *smat, int nrows, int ncols)
+{
+    smat->nrows = nrows;
+    smat->ncols = ncols;
+    smat->nlines = 0;
+    smat->nelems = 0;
+}
+
+void
+smatrix_reserve(struct smatrix *smat, int nlines, int nelems)
+{
+    if (nlines > smat->maxlines) {
+        smat->maxlines = nlines;
+        smat->ids = realloc(smat->ids, smat->maxlines * sizeof *smat->ids);
+        smat->offsets = realloc(smat->offsets,
+                                (smat->maxlines + 1) * sizeof *smat->offsets);
+    }
+    if (nelems > smat->maxelems) {
+        smat->maxelems = nelems;
+        smat->cols = realloc(smat->cols, smat->maxelems * sizeof *smat->cols);
+    }
+}
+
+void
+smatrix_add_row(struct smatrix *smat, int row_id, const int *cols, int ncols)
+{
+    if (smat->nlines == smat->maxlines) {
+        smat->maxlines *= 2;
+        smat->ids = realloc(smat->ids, smat->maxlines * sizeof *smat->ids);
+        smat->offsets = realloc(smat->offsets,
+                                (smat->maxlines + 1) * sizeof *smat->offsets);
+    }
+    while (smat->nelems + ncols > smat->maxelems) {
+        smat->maxelems *= 2;
+        smat->cols = realloc(smat->cols, smat->maxelems * sizeof *smat->cols);
+    }
+
+    memcpy(&smat->cols[smat->nelems], cols, ncols * sizeof *cols);
+    smat->nelems += ncols;
+    smat->ids[smat->nlines] = row_id;
+    ++smat->nlines;
+    smat->offsets[smat->nlines] = smat->nelems;
+}
+
+struct smatrix *
+smatrix_from_bmatrix(const struct bmatrix *bmat)
+{
+    const int nrows = bmat->nrows;
+    const int ncols = bmat->ncols;
+
+    struct smatrix *smat = smatrix_create(nrows, ncols);
+    int *cols = malloc(ncols * sizeof *cols);
+
+    for (int i_row = 0; i_row < nrows; ++i_row) {
+        int n = 0;
+        for (int i_col = 0; i_col < ncols; ++i_col) {
+            if (bmat->data[(size_t) i_row * ncols + i_col]) {
+                cols[n++] = i_col;
+            }
+        }
+        /* Empty rows need not be stored */
+        if (n > 0) {
+            smatrix_add_row(smat, i_row, cols, n);
+        }
+    }
+
+    free(cols);
+    return smat;
+}
+
+struct bmatrix *
+bmatrix_from_smatrix(const struct smatrix *smat)
+{
+    struct bmatrix *bmat = malloc(sizeof *bmat);
+
+    bmat->nrows = smat->nrows;
+    bmat->ncols = smat->ncols;
+    bmat->data = calloc((size_t) bmat->nrows * bmat->ncols, sizeof *bmat->data);
+
+    for (int i = 0; i < smat->nlines; ++i) {
+        const size_t row = smat->ids[i];
+        for (int j = smat->offsets[i]; j < smat->offsets[i + 1]; ++j) {
+            bmat->data[row * bmat->ncols + smat->cols[j]] = 1;
+        }
+    }
+
+    return bmat;
+}
+
+void
+bmatrix_free(struct bmatrix *bmat)
+{
+    if (!bmat) {
+        return;
+    }
+    free(bmat->data);
+    free(bmat);
+}
@@ -0,0 +1,62 @@
+/* smatrix.h
+ *
+ * Header for sparse binary matrix struct to be solved by dancing links
+ * algorithm.
+ *
+ */
+
+#ifndef SMATRIX_H
+#define SMATRIX_H
+
+#include "bmatrix.h"
+
+/* Sparse binary matrix. Only non-empty rows are stored, each one as the list
+ * of columns it has a 1 in (compressed sparse row format). Memory is
+ * proportional to the number of non-zero elements and not to NROWS * NCOLS. */
+struct smatrix {
+    int nrows;      /* Number of rows of the full matrix (bound for row ids) */
+    int ncols;      /* Number of columns */
+    int nlines;     /* Number of stored rows */
+    int nelems;     /* Number of stored non-zero elements */
+    int maxlines;   /* Capacity of IDS */
+    int maxelems;   /* Capacity of COLS */
+    int *ids;       /* Row id of each stored row */
+    int *offsets;   /* Start of each stored row in COLS (NLINES + 1 entries) */
+    int *cols;      /* Column indices of all non-zero elements */
+};
+
+/* Create empty sparse matrix with NROWS rows and NCOLS columns */
+struct smatrix *
+smatrix_create(int nrows, int ncols);
+
+/* Free memory of sparse matrix SMAT */
+void
+smatrix_free(struct smatrix *smat);
+
+/* Remove all rows of SMAT and set its dimensions to NROWS and NCOLS. The
+ * buffers are kept for reuse. */
+void
+smatrix_reset(struct smatrix *smat, int nrows, int ncols);
+
+/* Make room in SMAT for NLINES rows with NELEMS non-zero elements in total, so
+ * adding them allocates nothing. Buffers never shrink. */
+void
+smatrix_reserve(struct smatrix *smat, int nlines, int nelems);
+
+/* Append row ROW_ID with non-zero elements in the NCOLS columns COLS to SMAT */
+void
+smatrix_add_row(struct smatrix *smat, int row_id, const int *cols, int ncols);
+
+/* Convert dense binary matrix BMAT to sparse matrix */
+struct smatrix *
+smatrix_from_bmatrix(const struct bmatrix *bmat);
+
+/* Convert sparse matrix SMAT to dense binary matrix (for debugging) */
+struct bmatrix *
+bmatrix_from_smatrix(const struct smatrix *smat);
+
+/* Free memory of dense binary matrix BMAT */
+void
+bmatrix_free(struct bmatrix *bmat);
+
+#endif /* SMATRIX_H */
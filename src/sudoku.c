@@ -1,33 +1,44 @@
 #include "sudoku.h"
 
-#include <math.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
-#include "bmatrix.h"
+#include "bitmask.h"
+#include "bits.h"
+#include "bitx.h"
+#include "input.h"
 #include "links.h"
+#include "propagate.h"
+#include "smatrix.h"
+#include "writer.h"
+
+/* Options used if none are given */
+static const struct sudoku_options sudoku_defaults = {
+    SUDOKU_ENGINE_AUTO, SUDOKU_PROPAGATE_SINGLES,
+    { DLSELECT_MRV, 0, 1, { 0, 0, NULL } }
+};
 
 /* Insert ELEM into sudoku of size SSIZE at sudoku row SROW and sudoku column 
- * SCOL into binary matrix BMAT such that it can by solved by dancing links. */
+ * SCOL into sparse matrix SMAT such that it can by solved by dancing links.
+ * Every candidate hits exactly four constraints: its cell, and the digit in its
+ * row, column and block. COLMAP maps constraints to the columns of SMAT. */
 static void
-bmatrix_insert(struct bmatrix *bmat, int ssize, int srow, int scol, int elem)
+smatrix_insert(struct smatrix *smat, const int *colmap, int ssize, int srow, int scol,
+               int elem)
 {
     const int nelems = ssize * ssize;
     const int sblock = (srow / ssize) * ssize + (scol / ssize);
 
-    int brow = (srow * nelems + scol) * nelems + (elem - 1);
-
-    int bcol = srow * nelems + scol;
-    bmat->data[brow * bmat->ncols + bcol] = 1;
+    const int brow = (srow * nelems + scol) * nelems + (elem - 1);
 
-    bcol = 1 * nelems * nelems + srow * nelems + (elem - 1);
-    bmat->data[brow * bmat->ncols + bcol] = 1;
+    int bcols[4];
+    bcols[0] = colmap[srow * nelems + scol];
+    bcols[1] = colmap[1 * nelems * nelems + srow * nelems + (elem - 1)];
+    bcols[2] = colmap[2 * nelems * nelems + scol * nelems + (elem - 1)];
+    bcols[3] = colmap[3 * nelems * nelems + sblock * nelems + (elem - 1)];
 
-    bcol = 2 * nelems * nelems + scol * nelems + (elem - 1);
-    bmat->data[brow * bmat->ncols + bcol] = 1;
-    
-    bcol = 3 * nelems * nelems + sblock * nelems + (elem - 1);
-    bmat->data[brow * bmat->ncols + bcol] = 1;
+    smatrix_add_row(smat, brow, bcols, 4);
 }
 
 /* Check if ELEM is in row ROW of sudoku SUDOKU */
@@ -74,25 +85,74 @@ sudoku_inblock(const struct sudoku *sudoku, int row, int col, int elem)
     return 0;
 }
 
-/* Convert data of sudoku SUDOKU to binary matrix */
-static struct bmatrix *
-bmatrix_from_sudoku(const struct sudoku *sudoku)
+/* Fill sparse binary matrix SMAT with the residual problem of sudoku SUDOKU:
+ * one row per candidate of an empty cell, and one column per constraint not
+ * yet satisfied by a filled cell. Candidates are taken from CAND, or derived
+ * from the filled cells if it is NULL. COLMAP must hold 4 * NELEMS * NELEMS
+ * ints. Returns zero if filled cells contradict each other. */
+static int
+smatrix_fill_sudoku(struct smatrix *smat, const struct sudoku *sudoku,
+                    const uint64_t *cand, int *colmap)
 {
-    struct bmatrix *bmat = malloc(sizeof *bmat);
+    const int ssize = sudoku->size;
+    const int nelems = sudoku->nelems;
+    const int ncells = nelems * nelems;
 
-    bmat->nrows = sudoku->nelems * sudoku->nelems * sudoku->nelems;
-    bmat->ncols = 4 * sudoku->nelems * sudoku->nelems;
-    bmat->data = calloc(bmat->nrows * bmat->ncols, sizeof *bmat->data);
+    /* Drop constraints of filled cells, each must be hit only once */
+    for (int i = 0; i < 4 * ncells; ++i) {
+        colmap[i] = 0;
+    }
+    for (int cell = 0; cell < ncells; ++cell) {
+        const int elem = sudoku->data[cell];
+        if (elem == 0) {
+            continue;
+        }
+        const int row = cell / nelems;
+        const int col = cell % nelems;
+        const int block = (row / ssize) * ssize + col / ssize;
+        const int cons[4] = {
+            cell,
+            1 * ncells + row * nelems + (elem - 1),
+            2 * ncells + col * nelems + (elem - 1),
+            3 * ncells + block * nelems + (elem - 1)
+        };
+        for (int i = 0; i < 4; ++i) {
+            if (colmap[cons[i]] < 0) {
+                return 0;
+            }
+            colmap[cons[i]] = -1;
+        }
+    }
+    int ncols = 0;
+    for (int i = 0; i < 4 * ncells; ++i) {
+        if (colmap[i] == 0) {
+            colmap[i] = ncols++;
+        }
+    }
 
-    const int ssize = sudoku->size;
-    for (int row = 0; row < sudoku->nelems; ++row) {
-        for (int col = 0; col < sudoku->nelems; ++col) {
-            int elem = sudoku->data[row * sudoku->nelems + col];
-            if (elem != 0) {
-                bmatrix_insert(bmat, ssize, row, col, elem);
+    /* Reserve exactly one row of four per candidate; without CAND all digits
+     * of the empty cells, which is exact for the empty grid of the template */
+    int nlines = 0;
+    for (int cell = 0; cell < ncells; ++cell) {
+        if (sudoku->data[cell] == 0) {
+            nlines += cand ? bits_popcount(cand[cell]) : nelems;
+        }
+    }
+    smatrix_reset(smat, ncells * nelems, ncols);
+    smatrix_reserve(smat, nlines, 4 * nlines);
+    for (int row = 0; row < nelems; ++row) {
+        for (int col = 0; col < nelems; ++col) {
+            const int cell = row * nelems + col;
+            if (sudoku->data[cell] != 0) {
                 continue;
             }
-            for (elem = 1; elem <= sudoku->nelems; ++elem) {
+            if (cand) {
+                for (uint64_t mask = cand[cell]; mask; mask &= mask - 1) {
+                    smatrix_insert(smat, colmap, ssize, row, col, bits_ctz(mask) + 1);
+                }
+                continue;
+            }
+            for (int elem = 1; elem <= nelems; ++elem) {
                 if (sudoku_inrow(sudoku, row, col, elem)) {
                     continue;
                 }
@@ -102,110 +162,234 @@ bmatrix_from_sudoku(const struct sudoku *sudoku)
                 if (sudoku_inblock(sudoku, row, col, elem)) {
                     continue;
                 }
-                bmatrix_insert(bmat, ssize, row, col, elem);
+                smatrix_insert(smat, colmap, ssize, row, col, elem);
             }
         }
     }
 
-    return bmat;
+    return 1;
 }
 
-/* Free memory of BMAT */
+/* Write cells chosen by the NROWS exact cover rows ROWS to SUDOKU. Row ids
+ * encode cell and digit (see `smatrix_insert'), so this takes one division
+ * per row. */
 static void
-bmatrix_free(struct bmatrix *bmat)
+sudoku_decode_rows(struct sudoku *sudoku, const int *rows, int nrows)
 {
-    if (!bmat) {
-        return;
+    const int nelems = sudoku->nelems;
+    for (int i = 0; i < nrows; ++i) {
+        sudoku->data[rows[i] / nelems] = (rows[i] % nelems) + 1;
     }
-    free(bmat->data);
-    free(bmat);
 }
 
-/* Convert data of binary matrix BMAT to sudoku */
-static struct sudoku *
-sudoku_from_bmatrix(const struct bmatrix *bmat)
+/* Returns whether SUDOKU has no empty cell left */
+static int
+sudoku_complete(const struct sudoku *sudoku)
 {
-    struct sudoku *sudoku = malloc(sizeof *sudoku);
-
-    sudoku->nelems = (int) cbrt(bmat->nrows);
-    sudoku->size = (int) sqrt(sudoku->nelems);
-
     const int totnum = sudoku->nelems * sudoku->nelems;
-    sudoku->data = malloc(totnum * sizeof *sudoku->data);
     for (int i = 0; i < totnum; ++i) {
-        int j;
-        for (j = 0; bmat->data[j * bmat->ncols + i] != 1; ++j);
-        sudoku->data[i] = (j % sudoku->nelems) + 1;
+        if (sudoku->data[i] == 0) {
+            return 0;
+        }
     }
+    return 1;
+}
 
+struct sudoku *
+sudoku_create(int size)
+{
+    struct sudoku *sudoku = malloc(sizeof *sudoku);
+    sudoku->size = size;
+    sudoku->nelems = size * size;
+    sudoku->data = calloc(sudoku->nelems * sudoku->nelems, sizeof *sudoku->data);
     return sudoku;
 }
 
-/* Longer lines (and larger sudokus) are INSANITY!!1 */
-#define LINE_BUFFER_SIZE 1024
+/* Returns value of cell character C in one-line format, 0 for blanks and -1
+ * for invalid characters */
+static int
+sudoku_parse_char(char c)
+{
+    if (c == '.') {
+        return 0;
+    }
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+int
+sudoku_parse_line(struct sudoku *sudoku, const char *line, int len)
+{
+    /* Line holds one character per cell (square of squares) */
+    int size = 1;
+    while (size * size * size * size < len) {
+        ++size;
+    }
+    const int nelems = size * size;
+    if (nelems * nelems != len || nelems > SUDOKU_LINE_MAX_NELEMS) {
+        return 0;
+    }
 
-struct sudoku *
-sudoku_read(const char *file)
+    if (sudoku->nelems != nelems) {
+        sudoku->size = size;
+        sudoku->nelems = nelems;
+        sudoku->data = realloc(sudoku->data, len * sizeof *sudoku->data);
+    }
+
+    for (int i = 0; i < len; ++i) {
+        const int elem = sudoku_parse_char(line[i]);
+        if (elem < 0 || elem > nelems) {
+            return 0;
+        }
+        sudoku->data[i] = elem;
+    }
+
+    return 1;
+}
+
+/* Returns whether C is whitespace between the numbers of the matrix format */
+static int
+sudoku_isspace(char c)
 {
-    struct sudoku *sudoku = malloc(sizeof *sudoku);
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
 
-    FILE *in = fopen(file, "r");
-    if (!in) {
-        fprintf(stderr, "Could not read file '%s'!\n", file);
-        exit(EXIT_FAILURE);
+/* Returns whether token TOK of LEN characters is a puzzle in one-line format:
+ * it holds a character other than a digit, as blanks and elements above 9 do
+ * there, or it has as many digits as a sudoku of block size 2 or more has
+ * cells. Numbers of the matrix format, even above 99, are shorter. */
+static int
+sudoku_isline(const char *tok, size_t len)
+{
+    if (len == 1) {
+        return 0;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        if (tok[i] < '0' || tok[i] > '9') {
+            return 1;
+        }
+    }
+    size_t size = 2;
+    while (size * size * size * size < len) {
+        ++size;
+    }
+    return size * size * size * size == len;
+}
+
+struct sudoku *
+sudoku_parse(const char *text, size_t len)
+{
+    const char *pos = text;
+    const char *end = text + len;
+    while (pos < end && sudoku_isspace(*pos)) {
+        ++pos;
     }
 
-    /* Read input file line by line */
-    char linebuf[LINE_BUFFER_SIZE];
-    int ctr = 0;
-    char *endptr;
-    do {
-        char *str = fgets(linebuf, LINE_BUFFER_SIZE, in);
-        if (str == NULL) {
-            break;
+    /* A first token that is no number of the matrix format is a puzzle in
+     * one-line format */
+    const char *tok = pos;
+    while (tok < end && !sudoku_isspace(*tok)) {
+        ++tok;
+    }
+    if (sudoku_isline(pos, (size_t) (tok - pos))) {
+        const char *rest = tok;
+        while (rest < end && sudoku_isspace(*rest)) {
+            ++rest;
         }
-        do {
-            int i = strtol(str, &endptr, 10);
-            if ((i == 0 && endptr == NULL) || str == endptr) {
-                fprintf(stderr, "Invalid character in '%s'!\n", file);
-                exit(EXIT_FAILURE);
-            } else {
-                ++ctr;
-                str = endptr;
+        struct sudoku *sudoku = sudoku_create(1);
+        if (rest != end || tok - pos > INT_MAX
+            || !sudoku_parse_line(sudoku, pos, (int) (tok - pos))) {
+            sudoku_free(sudoku);
+            return NULL;
+        }
+        return sudoku;
+    }
+
+    /* Every number takes at least one character and a separator, which bounds
+     * the number of cells before they are counted */
+    uint8_t *data = malloc(len / 2 + 1);
+    size_t ncells = 0;
+    int maxelem = 0;
+    while (pos < end) {
+        int elem = 0;
+        if (*pos == '.') {
+            ++pos;
+        } else if (*pos >= '0' && *pos <= '9') {
+            for (; pos < end && *pos >= '0' && *pos <= '9' && elem <= UINT8_MAX; ++pos) {
+                elem = 10 * elem + (*pos - '0');
             }
-        } while (*endptr != '\0' && *endptr != '\n' && *endptr != EOF);
-    } while (*endptr != '\0' && *endptr != EOF);
+        } else {
+            elem = -1;
+        }
+        if (elem < 0 || elem > UINT8_MAX || (pos < end && !sudoku_isspace(*pos))) {
+            free(data);
+            return NULL;
+        }
+        data[ncells++] = (uint8_t) elem;
+        if (elem > maxelem) {
+            maxelem = elem;
+        }
 
-    /* Check if sudoku is valid (square of squares) */
-    const int nelems = (int) sqrt(ctr);
-    const int size = (int) sqrt(nelems);
-    if (size * size != nelems || nelems * nelems != ctr) {
-        fprintf(stderr, "Sudoku in file '%s' is invalid!\n", file);
-        exit(EXIT_FAILURE);
+        while (pos < end && sudoku_isspace(*pos)) {
+            ++pos;
+        }
+    }
+
+    /* Check if sudoku is valid (square of squares). Cells are bytes, so there
+     * are at most 225 elements, and the 4 * 225^3 nodes of the exact cover
+     * matrix still fit into int. */
+    int size = 1;
+    while ((size_t) size * size * size * size < ncells) {
+        ++size;
+    }
+    const int nelems = size * size;
+    if ((size_t) nelems * nelems != ncells || maxelem > nelems || nelems > UINT8_MAX) {
+        free(data);
+        return NULL;
     }
+
+    struct sudoku *sudoku = malloc(sizeof *sudoku);
     sudoku->size = size;
     sudoku->nelems = nelems;
-    sudoku->data = malloc(ctr * sizeof *sudoku->data);
-
-    rewind(in);
-    ctr = 0;
-    do {
-        char *str = fgets(linebuf, LINE_BUFFER_SIZE, in);
-        if (str == NULL) {
-            break;
+    sudoku->data = realloc(data, ncells);
+    return sudoku;
+}
+
+struct sudoku *
+sudoku_read(const char *file)
+{
+    FILE *in = stdin;
+    if (strcmp(file, "-") != 0) {
+        in = fopen(file, "r");
+        if (!in) {
+            fprintf(stderr, "Could not read file '%s'!\n", file);
+            exit(EXIT_FAILURE);
         }
-        do {
-            int i = strtol(str, &endptr, 10);
-            if (i > sudoku->nelems || i < 0) {
-                fprintf(stderr, "Invalid number in '%s'!\n", file);
-                exit(EXIT_FAILURE);
-            }
-            sudoku->data[ctr++] = i;
-            str = endptr;
-        } while (*endptr != '\0' && *endptr != '\n' && *endptr != EOF);
-    } while (*endptr != '\0' && *endptr != EOF);
+    }
+
+    /* Files are parsed where they are mapped, pipes are read in one go */
+    struct input input;
+    if (!input_map(&input, in)) {
+        input_read(&input, in);
+    }
+    struct sudoku *sudoku = sudoku_parse(input.data, input.len);
+    input_free(&input);
+    if (in != stdin) {
+        fclose(in);
+    }
 
-    fclose(in);
+    if (!sudoku) {
+        fprintf(stderr, "Sudoku in file '%s' is invalid!\n", file);
+        exit(EXIT_FAILURE);
+    }
     return sudoku;
 }
 
@@ -219,99 +403,596 @@ sudoku_free(struct sudoku *sudoku)
     free(sudoku);
 }
 
-struct sudoku **
-sudoku_solve(const struct sudoku *sudoku, int *nsols)
+/* Returns whether the bitmask engine is to be used for SUDOKU with OPTS */
+static int
+sudoku_use_bitmask(const struct sudoku *sudoku, const struct sudoku_options *opts)
 {
-    struct bmatrix *bmat = bmatrix_from_sudoku(sudoku);
-    struct dlsolution *dlsol = dlsolution_find(bmat, nsols);
-    if (*nsols == 0) {
-        bmatrix_free(bmat);
-        return NULL;
+    return (opts->engine == SUDOKU_ENGINE_AUTO || opts->engine == SUDOKU_ENGINE_BITMASK)
+           && bitmask_supports(sudoku->size);
+}
+
+/* Copy SUDOKU to WORK of the same size and fill cells by propagation as set
+ * in OPTS. Candidates are written to CAND, unless SUDOKU is too large for
+ * propagation and CAND is left alone. Returns number of cells filled, or -1 if
+ * SUDOKU has no solution. */
+static int
+sudoku_prepare(const struct sudoku *sudoku, const struct sudoku_options *opts,
+               struct sudoku *work, uint64_t *cand)
+{
+    const int totnum = sudoku->nelems * sudoku->nelems;
+    memcpy(work->data, sudoku->data, totnum * sizeof *work->data);
+    if (sudoku->nelems > PROPAGATE_MAX_NELEMS) {
+        return 0;
+    }
+    return sudoku_propagate(work, cand, opts->propagate);
+}
+
+/* Visitor of a sudoku search and the puzzle it runs on */
+struct sudoku_adapter {
+    sudoku_visitor visit;
+    void *ctx;
+    const struct sudoku *work;      /* Puzzle after propagation */
+    struct sudoku *sol;             /* Copy of WORK solutions are decoded into */
+};
+
+/* Visitor for `bitmask_solve' handing solution GRID to the sudoku visitor of
+ * adapter CTX */
+static int
+sudoku_adapt_grid(const uint8_t *grid, void *ctx)
+{
+    const struct sudoku_adapter *adapter = ctx;
+    const struct sudoku sol = {
+        adapter->work->size, adapter->work->nelems, (uint8_t *) grid
+    };
+    return adapter->visit(&sol, adapter->ctx);
+}
+
+/* Visitor for `dlsolution_visit' handing solution of NROWS rows ROWS to the
+ * sudoku visitor of adapter CTX */
+static int
+sudoku_adapt_rows(const int *rows, int nrows, void *ctx)
+{
+    const struct sudoku_adapter *adapter = ctx;
+    /* Every solution fills all empty cells of the copy, so no reset is needed
+     * in between */
+    sudoku_decode_rows(adapter->sol, rows, nrows);
+    return adapter->visit(adapter->sol, adapter->ctx);
+}
+
+/* Solve SUDOKU using options OPTS and call VISIT with context CTX for every
+ * solution. If VISIT is NULL solutions are only counted up to MAX_SOLUTIONS
+ * (0 for no limit). With ORDERED set, a search split over threads stores up to
+ * MAX_SOLUTIONS solutions and visits them once it is over, in the order of a
+ * serial search. Statistics are written to STATS unless it is NULL. Returns
+ * number of solutions found. */
+static long
+sudoku_search(const struct sudoku *sudoku, const struct sudoku_options *opts,
+              sudoku_visitor visit, void *ctx, long max_solutions, int ordered,
+              struct sudoku_stats *stats)
+{
+    if (!opts) {
+        opts = &sudoku_defaults;
+    }
+
+    const int totnum = sudoku->nelems * sudoku->nelems;
+    const int propagate = sudoku->nelems <= PROPAGATE_MAX_NELEMS;
+    struct sudoku *work = sudoku_create(sudoku->size);
+    uint64_t *cand = propagate ? malloc(totnum * sizeof *cand) : NULL;
+    const int npropagated = sudoku_prepare(sudoku, opts, work, cand);
+    if (stats) {
+        memset(stats, 0, sizeof *stats);
     }
 
-    struct sudoku **sols = malloc(*nsols * sizeof *sols);
+    struct sudoku_adapter adapter = { visit, ctx, work, NULL };
+    long nsols = 0;
+    long nnodes = 0;
+    enum dlabort aborted = DLABORT_NONE;
+    if (npropagated < 0) {
+        /* Propagation ran into a contradiction */
+    } else if (propagate && sudoku_complete(work)) {
+        /* Propagation only fills forced cells, so this is the only solution */
+        if (visit) {
+            visit(work, ctx);
+        }
+        nsols = 1;
+    } else if (sudoku_use_bitmask(sudoku, opts)) {
+        if (visit) {
+            nsols = bitmask_solve(work, LONG_MAX, &opts->search.bounds, &sudoku_adapt_grid,
+                                  &adapter, &nnodes, &aborted);
+        } else {
+            nsols = bitmask_solve(work, (max_solutions > 0) ? max_solutions : LONG_MAX,
+                                  &opts->search.bounds, NULL, NULL, &nnodes, &aborted);
+        }
+    } else {
+        /* Both exact cover engines search the same matrix */
+        const int bitset = opts->engine == SUDOKU_ENGINE_BITSET;
+        struct smatrix *smat = smatrix_create(0, 0);
+        struct dlsolver *dls = bitset ? NULL : dlsolver_create(&opts->search);
+        struct bitx_solver *bxs = bitset ? bitx_solver_create(&opts->search) : NULL;
+        int *colmap = malloc(4 * totnum * sizeof *colmap);
+        if (!smatrix_fill_sudoku(smat, work, cand, colmap)) {
+            /* Givens contradict each other */
+        } else if (visit && ordered && !bitset && opts->search.nthreads > 1) {
+            /* Solutions visited during the search would come in the order the
+             * threads find them, stored ones are merged in subproblem order */
+            adapter.sol = sudoku_create(sudoku->size);
+            memcpy(adapter.sol->data, work->data, totnum * sizeof *work->data);
+            const int nfound = dlsolver_solve(dls, smat, (int) max_solutions);
+            const struct dlsolution *sols = dlsolver_solutions(dls);
+            while (nsols < nfound) {
+                const struct dlsolution *sol = &sols[nsols++];
+                if (sudoku_adapt_rows(sol->rows, sol->nrows, &adapter)) {
+                    break;
+                }
+            }
+            sudoku_free(adapter.sol);
+        } else if (visit) {
+            adapter.sol = sudoku_create(sudoku->size);
+            memcpy(adapter.sol->data, work->data, totnum * sizeof *work->data);
+            nsols = bitset ? bitx_solver_visit(bxs, smat, &sudoku_adapt_rows, &adapter)
+                           : dlsolver_visit(dls, smat, &sudoku_adapt_rows, &adapter);
+            sudoku_free(adapter.sol);
+        } else {
+            nsols = bitset ? bitx_solver_count(bxs, smat, max_solutions)
+                           : dlsolver_count(dls, smat, max_solutions);
+        }
+        const struct dlstats *search = bitset ? bitx_solver_stats(bxs) : dlsolver_stats(dls);
+        nnodes = search->nodes;
+        aborted = bitset ? bitx_solver_aborted(bxs) : dlsolver_aborted(dls);
+        if (stats) {
+            stats->search = *search;
+        }
+        free(colmap);
+        dlsolver_free(dls);
+        bitx_solver_free(bxs);
+        smatrix_free(smat);
+    }
 
-    for (int i = 0; i < *nsols; ++i) {
-        struct bmatrix *solmat = bmatrix_from_dlsolution(&dlsol[i], bmat);
-        sols[i] = sudoku_from_bmatrix(solmat);
-        bmatrix_free(solmat);
-        free(dlsol[i].rows);
+    if (stats) {
+        stats->npropagated = (npropagated > 0) ? npropagated : 0;
+        stats->nnodes = nnodes;
+        stats->aborted = aborted;
     }
 
-    free(dlsol);
-    bmatrix_free(bmat);
+    free(cand);
+    sudoku_free(work);
 
-    return sols;
+    return nsols;
+}
+
+long
+sudoku_visit(const struct sudoku *sudoku, const struct sudoku_options *opts,
+             sudoku_visitor visit, void *ctx, struct sudoku_stats *stats)
+{
+    return sudoku_search(sudoku, opts, visit, ctx, 0, 0, stats);
+}
+
+/* Solutions collected by `sudoku_solve' */
+struct sudoku_collect {
+    int limit;
+    int nsols;
+    int maxsols;
+    struct sudoku **sols;
+};
+
+/* Visitor for `sudoku_visit' appending copy of solution SOL to collection
+ * CTX. Stops once its limit is reached. */
+static int
+sudoku_collect(const struct sudoku *sol, void *ctx)
+{
+    struct sudoku_collect *coll = ctx;
+    if (coll->nsols == coll->maxsols) {
+        coll->maxsols = coll->maxsols ? 2 * coll->maxsols : 4;
+        coll->sols = realloc(coll->sols, coll->maxsols * sizeof *coll->sols);
+    }
+    struct sudoku *copy = sudoku_create(sol->size);
+    memcpy(copy->data, sol->data, sol->nelems * sol->nelems * sizeof *copy->data);
+    coll->sols[coll->nsols++] = copy;
+    return coll->limit > 0 && coll->nsols >= coll->limit;
+}
+
+struct sudoku **
+sudoku_solve(const struct sudoku *sudoku, const struct sudoku_options *opts,
+             int max_solutions, int *nsols, struct sudoku_stats *stats)
+{
+    struct sudoku_collect coll = { max_solutions, 0, 0, NULL };
+    sudoku_search(sudoku, opts, &sudoku_collect, &coll, max_solutions, 1, stats);
+    *nsols = coll.nsols;
+    return coll.sols;
+}
+
+long
+sudoku_count(const struct sudoku *sudoku, const struct sudoku_options *opts,
+             long max_solutions, struct sudoku_stats *stats)
+{
+    return sudoku_search(sudoku, opts, NULL, NULL, max_solutions, 0, stats);
+}
+
+/* Visitor for `bitmask_solve' copying solution GRID into sudoku CTX */
+static int
+sudoku_copy_grid(const uint8_t *grid, void *ctx)
+{
+    struct sudoku *sol = ctx;
+    memcpy(sol->data, grid, sol->nelems * sol->nelems * sizeof *sol->data);
+    return 0;
+}
+
+/* Puzzles with at most one in this many cells filled are solved on the
+ * template of `struct sudoku_solver' */
+#define SUDOKU_TEMPLATE_SHARE 4
+
+/* Reusable solver. Puzzles with few filled cells are solved on a template:
+ * the exact cover matrix of the empty grid (all candidates of all cells),
+ * built once per size, with the filled cells chosen as fixed rows. Setting it
+ * up costs O(filled cells) instead of a matrix of its own, but the template
+ * is larger than the residual matrix of a puzzle, which is why the latter is
+ * used as soon as a fair share of the cells is filled. */
+struct sudoku_solver {
+    struct sudoku_options opts;
+    struct dlsolver *dls;
+    struct bitx_solver *bxs;    /* Searches residual matrices instead of DLS
+                                 * with the bitset engine, else NULL */
+    struct smatrix *smat;   /* Residual matrix of the current puzzle */
+    struct smatrix *tmpl;   /* Template, loaded into DLS if TSIZE is set */
+    int tsize;              /* Size of sudokus TMPL is built for, 0 if none */
+    struct sudoku *work;    /* Puzzle after propagation */
+    int maxcells;           /* Capacity of CAND and FIXED, and of COLMAP / 4 */
+    uint64_t *cand;
+    int *colmap;
+    int *fixed;             /* Row ids of the filled cells of WORK */
+    struct sudoku_stats stats;
+};
+
+struct sudoku_solver *
+sudoku_solver_create(const struct sudoku_options *opts)
+{
+    struct sudoku_solver *solver = malloc(sizeof *solver);
+    solver->opts = opts ? *opts : sudoku_defaults;
+    solver->dls = dlsolver_create(&solver->opts.search);
+    solver->bxs = (solver->opts.engine == SUDOKU_ENGINE_BITSET)
+                  ? bitx_solver_create(&solver->opts.search) : NULL;
+    solver->smat = smatrix_create(0, 0);
+    solver->tmpl = smatrix_create(0, 0);
+    solver->tsize = 0;
+    solver->work = sudoku_create(3);
+    solver->maxcells = 0;
+    solver->cand = NULL;
+    solver->colmap = NULL;
+    solver->fixed = NULL;
+    memset(&solver->stats, 0, sizeof solver->stats);
+    return solver;
 }
 
 void
-sudoku_fprint(FILE *out, const struct sudoku *sudoku, int fancy)
+sudoku_solver_free(struct sudoku_solver *solver)
 {
-    if (!out || !sudoku) {
+    if (!solver) {
         return;
     }
+    dlsolver_free(solver->dls);
+    bitx_solver_free(solver->bxs);
+    smatrix_free(solver->smat);
+    smatrix_free(solver->tmpl);
+    sudoku_free(solver->work);
+    free(solver->cand);
+    free(solver->colmap);
+    free(solver->fixed);
+    free(solver);
+}
+
+/* Build the template matrix of SOLVER for sudokus of size SIZE and load it
+ * into its dancing links solver. COLMAP of SOLVER must be large enough. */
+static void
+sudoku_solver_load(struct sudoku_solver *solver, int size)
+{
+    struct sudoku *empty = sudoku_create(size);
+    smatrix_fill_sudoku(solver->tmpl, empty, NULL, solver->colmap);
+    dlsolver_load(solver->dls, solver->tmpl);
+    solver->tsize = size;
+    sudoku_free(empty);
+}
 
-    const int size = sudoku->size;
+/* Copy statistics of the last exact cover search of SOLVER, or clear them
+ * if SEARCHED is zero. Counters that are not kept (see `dlstats_enabled') are
+ * left alone, they stay zero anyway. */
+static void
+sudoku_solver_copy_stats(struct sudoku_solver *solver, int searched)
+{
+    struct dlstats *search = &solver->stats.search;
+    const struct dlstats *last = solver->bxs ? bitx_solver_stats(solver->bxs)
+                                             : dlsolver_stats(solver->dls);
+    if (!searched) {
+        if (dlstats_enabled()) {
+            memset(search, 0, sizeof *search);
+        }
+        search->nodes = 0;
+        search->solutions = 0;
+    } else if (dlstats_enabled()) {
+        *search = *last;
+    } else {
+        search->nodes = last->nodes;
+        search->solutions = last->solutions;
+    }
+    solver->stats.nnodes = search->nodes;
+    if (!searched) {
+        solver->stats.aborted = DLABORT_NONE;
+    } else {
+        solver->stats.aborted = solver->bxs ? bitx_solver_aborted(solver->bxs)
+                                            : dlsolver_aborted(solver->dls);
+    }
+}
+
+/* Solve WORK with the template of SOLVER, stopping after LIMIT solutions,
+ * and write the first one to SOLUTION unless it is NULL. Returns number of
+ * solutions found. */
+static int
+sudoku_solver_solve_template(struct sudoku_solver *solver, const struct sudoku *work,
+                             int nfixed, int limit, struct sudoku *solution)
+{
+    if (solver->tsize != work->size) {
+        sudoku_solver_load(solver, work->size);
+    }
+    const int nsols = dlsolver_solve_fixed(solver->dls, solver->fixed, nfixed, limit);
+    sudoku_solver_copy_stats(solver, 1);
+    if (nsols == 0 || !solution) {
+        return nsols;
+    }
+
+    /* Solutions include the fixed rows, so every cell is decoded */
+    const struct dlsolution *dlsol = dlsolver_solutions(solver->dls);
+    sudoku_decode_rows(solution, dlsol->rows, dlsol->nrows);
+    return nsols;
+}
+
+/* Solve WORK with a residual matrix holding only the candidates CAND (NULL to
+ * derive them from the filled cells) of its empty cells, stopping after LIMIT
+ * solutions, and write the first one to SOLUTION unless it is NULL. Returns
+ * number of solutions found. */
+static int
+sudoku_solver_solve_residual(struct sudoku_solver *solver, const struct sudoku *work,
+                             const uint64_t *cand, int limit, struct sudoku *solution)
+{
+    /* Loading another matrix drops the template */
+    solver->tsize = 0;
+    if (!smatrix_fill_sudoku(solver->smat, work, cand, solver->colmap)) {
+        return 0;
+    }
+    const int nsols = solver->bxs ? bitx_solver_solve(solver->bxs, solver->smat, limit)
+                                  : dlsolver_solve(solver->dls, solver->smat, limit);
+    sudoku_solver_copy_stats(solver, 1);
+    if (nsols == 0 || !solution) {
+        return nsols;
+    }
+
+    const struct dlsolution *dlsol = solver->bxs ? bitx_solver_solutions(solver->bxs)
+                                                 : dlsolver_solutions(solver->dls);
+    memcpy(solution->data, work->data,
+           work->nelems * work->nelems * sizeof *solution->data);
+    sudoku_decode_rows(solution, dlsol->rows, dlsol->nrows);
+    return nsols;
+}
+
+/* Solve SUDOKU with SOLVER, stopping after LIMIT solutions, and write one of
+ * them to SOLUTION unless it is NULL. Returns number of solutions found. */
+static int
+sudoku_solver_search(struct sudoku_solver *solver, const struct sudoku *sudoku,
+                     int limit, struct sudoku *solution)
+{
     const int nelems = sudoku->nelems;
-    const int width = (int) ceil(log10(nelems));
-
-    char *clrline = NULL;
-    char *sepline = NULL;
-
-    if (fancy) {
-        const int buflen = width + 2;
-        char *clrbuf = calloc(buflen + 1, sizeof *clrbuf);
-        char *sepbuf = calloc(buflen + 1, sizeof *sepbuf);
-        clrbuf = memset(clrbuf, ' ', buflen);
-        sepbuf = memset(sepbuf, '-', buflen);
-
-        const int linelen = nelems * buflen + 3 * (size - 1);
-        clrline = calloc(linelen + 1, sizeof *clrline);
-        sepline = calloc(linelen + 1, sizeof *sepline);
-        for (int i = 0; i < size; ++i) {
-            for (int j = 0; j < size; ++j) {
-                clrline = strncat(clrline, clrbuf, linelen);
-                sepline = strncat(sepline, sepbuf, linelen);
-            }
-            if (i < size - 1) {
-                clrline = strncat(clrline, " | ", linelen);
-                sepline = strncat(sepline, "-+-", linelen);
-            }
+    const int totnum = nelems * nelems;
+
+    if (solver->work->size != sudoku->size) {
+        sudoku_free(solver->work);
+        solver->work = sudoku_create(sudoku->size);
+    }
+    if (totnum > solver->maxcells) {
+        solver->maxcells = totnum;
+        solver->cand = realloc(solver->cand, totnum * sizeof *solver->cand);
+        solver->colmap = realloc(solver->colmap, 4 * totnum * sizeof *solver->colmap);
+        solver->fixed = realloc(solver->fixed, totnum * sizeof *solver->fixed);
+    }
+
+    const int propagate = nelems <= PROPAGATE_MAX_NELEMS;
+    struct sudoku *work = solver->work;
+    const int npropagated = sudoku_prepare(sudoku, &solver->opts, work, solver->cand);
+    solver->stats.npropagated = (npropagated > 0) ? npropagated : 0;
+    sudoku_solver_copy_stats(solver, 0);
+    if (npropagated < 0) {
+        return 0;
+    }
+    if (propagate && sudoku_complete(work)) {
+        if (solution) {
+            memcpy(solution->data, work->data, totnum * sizeof *solution->data);
         }
-        clrline[linelen] = '\0';
-        sepline[linelen] = '\0';
+        return 1;
+    }
 
-        free(clrbuf);
-        free(sepbuf);
+    if (sudoku_use_bitmask(sudoku, &solver->opts)) {
+        return (int) bitmask_solve(work, limit, &solver->opts.search.bounds,
+                                   solution ? &sudoku_copy_grid : NULL, solution,
+                                   &solver->stats.nnodes, &solver->stats.aborted);
+    }
 
-        fprintf(out, "%s\n", clrline);
+    int nfixed = 0;
+    for (int cell = 0; cell < totnum; ++cell) {
+        if (work->data[cell] != 0) {
+            solver->fixed[nfixed++] = cell * nelems + work->data[cell] - 1;
+        }
     }
 
-    for (int i = 0; i < nelems; ++i) {
-        for (int j = 0; j < nelems; ++j) {
-            const int elem = sudoku->data[i * nelems + j];
-            if (fancy && (j > 0) && (j % size == 0)) {
-                fprintf(out, " %c ", '|');
-            }
-            if (elem) {
-                fprintf(out, " %*i ", width, elem);
-            } else {
-                fprintf(out, " %*c ", width, ' ');
-            }
+    /* Covering a filled cell in the template touches about as many links as
+     * its empty cells add to a residual matrix, and the template is searched
+     * with worse locality, so it only pays off for sparse grids. Candidates
+     * removed by locked candidates are not carried over to the template.
+     * The bitset engine has no template and always takes the residual. */
+    if (!solver->bxs && SUDOKU_TEMPLATE_SHARE * nfixed <= totnum) {
+        return sudoku_solver_solve_template(solver, work, nfixed, limit, solution);
+    }
+    return sudoku_solver_solve_residual(solver, work, propagate ? solver->cand : NULL,
+                                        limit, solution);
+}
+
+int
+sudoku_solver_solve(struct sudoku_solver *solver, const struct sudoku *sudoku,
+                    struct sudoku *solution)
+{
+    return sudoku_solver_search(solver, sudoku, 1, solution) > 0;
+}
+
+int
+sudoku_solver_count(struct sudoku_solver *solver, const struct sudoku *sudoku,
+                    int max_solutions)
+{
+    return sudoku_solver_search(solver, sudoku, max_solutions, NULL);
+}
+
+int
+sudoku_solver_solve_max(struct sudoku_solver *solver, const struct sudoku *sudoku,
+                        int max_solutions, struct sudoku *solution)
+{
+    return sudoku_solver_search(solver, sudoku, max_solutions, solution);
+}
+
+const struct sudoku_stats *
+sudoku_solver_stats(const struct sudoku_solver *solver)
+{
+    return &solver->stats;
+}
+
+/* Session on the template matrix of one sudoku size. Every filled cell of
+ * GRID is a row fixed in DLS, so its columns stay covered between queries. */
+struct sudoku_session {
+    struct dlsolver *dls;
+    struct smatrix *tmpl;   /* Template loaded into DLS */
+    struct sudoku *grid;
+};
+
+struct sudoku_session *
+sudoku_session_create(const struct sudoku *sudoku, const struct sudoku_options *opts)
+{
+    const int totnum = sudoku->nelems * sudoku->nelems;
+
+    struct sudoku_session *session = malloc(sizeof *session);
+    session->grid = sudoku_create(sudoku->size);
+    session->tmpl = smatrix_create(0, 0);
+    session->dls = dlsolver_create(opts ? &opts->search : &sudoku_defaults.search);
+
+    int *colmap = malloc(4 * totnum * sizeof *colmap);
+    smatrix_fill_sudoku(session->tmpl, session->grid, NULL, colmap);
+    free(colmap);
+    dlsolver_load(session->dls, session->tmpl);
+
+    for (int cell = 0; cell < totnum; ++cell) {
+        const int elem = sudoku->data[cell];
+        if (elem != 0 && !sudoku_session_set_cell(session, cell / sudoku->nelems,
+                                                  cell % sudoku->nelems, elem)) {
+            sudoku_session_free(session);
+            return NULL;
         }
-        if (fancy) {
-            fprintf(out, "\n%s\n", clrline);
-            if ((i < nelems - 1) && (i + 1) % size == 0) {
-                fprintf(out, "%s\n", sepline);
-                fprintf(out, "%s\n", clrline);
-            }
-        } else {
-            fprintf(out, "\n");
+    }
+    return session;
+}
+
+void
+sudoku_session_free(struct sudoku_session *session)
+{
+    if (!session) {
+        return;
+    }
+    dlsolver_free(session->dls);
+    smatrix_free(session->tmpl);
+    sudoku_free(session->grid);
+    free(session);
+}
+
+int
+sudoku_session_set_cell(struct sudoku_session *session, int row, int col, int elem)
+{
+    const int nelems = session->grid->nelems;
+    if (row < 0 || row >= nelems || col < 0 || col >= nelems || elem < 1 || elem > nelems) {
+        return 0;
+    }
+
+    const int cell = row * nelems + col;
+    const int prev = session->grid->data[cell];
+    if (prev == elem) {
+        return 1;
+    }
+    if (prev != 0) {
+        dlsolver_unfix(session->dls, cell * nelems + prev - 1);
+    }
+    if (!dlsolver_fix(session->dls, cell * nelems + elem - 1)) {
+        /* Clashes with another filled cell; the previous digit fits again */
+        if (prev != 0) {
+            dlsolver_fix(session->dls, cell * nelems + prev - 1);
         }
+        return 0;
+    }
+    session->grid->data[cell] = elem;
+    return 1;
+}
+
+int
+sudoku_session_clear_cell(struct sudoku_session *session, int row, int col)
+{
+    const int nelems = session->grid->nelems;
+    if (row < 0 || row >= nelems || col < 0 || col >= nelems) {
+        return 0;
+    }
+
+    const int cell = row * nelems + col;
+    const int prev = session->grid->data[cell];
+    if (prev != 0) {
+        dlsolver_unfix(session->dls, cell * nelems + prev - 1);
+        session->grid->data[cell] = 0;
+    }
+    return 1;
+}
+
+int
+sudoku_session_check_solvable(struct sudoku_session *session, struct sudoku *solution)
+{
+    const int nsols = dlsolver_solve_fixed(session->dls, NULL, 0, 1);
+    if (nsols > 0 && solution) {
+        /* Solutions include the filled cells, so every cell is decoded */
+        const struct dlsolution *dlsol = dlsolver_solutions(session->dls);
+        sudoku_decode_rows(solution, dlsol->rows, dlsol->nrows);
+    }
+    return nsols > 0;
+}
+
+int
+sudoku_session_check_unique(struct sudoku_session *session)
+{
+    return dlsolver_solve_fixed(session->dls, NULL, 0, 2) == 1;
+}
+
+const struct sudoku *
+sudoku_session_grid(const struct sudoku_session *session)
+{
+    return session->grid;
+}
+
+void
+sudoku_fprint(FILE *out, const struct sudoku *sudoku, int fancy)
+{
+    if (!out || !sudoku) {
+        return;
     }
 
-    if (fancy) {
-        free(clrline);
-        free(sepline);
+    struct writer *writer = writer_create(out, fancy ? WRITER_FANCY : WRITER_PLAIN);
+    writer_sudoku(writer, sudoku);
+    writer_free(writer);
+}
+
+int
+sudoku_sprint_line(char *buf, const struct sudoku *sudoku)
+{
+    const int totnum = sudoku->nelems * sudoku->nelems;
+    for (int i = 0; i < totnum; ++i) {
+        const int elem = sudoku->data[i];
+        buf[i] = (elem == 0) ? '.' : (elem < 10) ? '0' + elem : 'A' + elem - 10;
     }
-}
\ No newline at end of file
+    buf[totnum] = '\n';
+    return totnum + 1;
+}
@@ -7,31 +7,206 @@
 #ifndef SUDOKU_H
 #define SUDOKU_H
 
+#include <inttypes.h>
+#include <stddef.h>
 #include <stdio.h>
 
-/* Structure to hold necessary data of sudoku puzzle */
+#include "links.h"
+
+/* Structure to hold necessary data of sudoku puzzle. Cells hold 0 for blanks
+ * and 1 to NELEMS for elements, one byte each. */
 struct sudoku {
     int size;
     int nelems;
-    int *data;
+    uint8_t *data;
+};
+
+/* Engines to solve sudokus with */
+enum sudoku_engine {
+    SUDOKU_ENGINE_AUTO,     /* Bitmask engine if it supports the size, else
+                             * dancing links */
+    SUDOKU_ENGINE_DLX,      /* Dancing links */
+    SUDOKU_ENGINE_BITMASK,  /* Bitmask engine (block sizes 2 to 4 only) */
+    SUDOKU_ENGINE_BITSET    /* Algorithm X over bitsets of rows, finding the
+                             * same solutions as dancing links (see
+                             * `struct bitx_solver') */
+};
+
+/* Logic applied to a sudoku before it is handed to the engine */
+enum sudoku_propagate {
+    SUDOKU_PROPAGATE_NONE,      /* Search right away */
+    SUDOKU_PROPAGATE_SINGLES,   /* Fill naked and hidden singles */
+    SUDOKU_PROPAGATE_LOCKED     /* Singles and locked candidates */
+};
+
+/* Options for solving sudokus */
+struct sudoku_options {
+    enum sudoku_engine engine;
+    enum sudoku_propagate propagate;
+    struct dloptions search;    /* Options of the dancing links and bitset
+                                 * engines; its bounds apply to the bitmask
+                                 * engine too */
+};
+
+/* Statistics of solving one sudoku */
+struct sudoku_stats {
+    int npropagated;        /* Number of cells filled by propagation */
+    long nnodes;            /* Number of search nodes visited */
+    enum dlabort aborted;   /* Why the search ran into its bounds, or
+                             * DLABORT_NONE (see `struct dlbounds') */
+    struct dlstats search;  /* Counters of the exact cover search, zero if
+                             * the bitmask engine or propagation alone solved
+                             * the sudoku (see `struct dlstats') */
 };
 
-/* Create sudoku from data read from input file FILE */
+/* Create empty sudoku with blocks of SIZE x SIZE cells */
+struct sudoku *
+sudoku_create(int size);
+
+/* Create sudoku from data read from input file FILE ("-" for standard input)
+ * as with `sudoku_parse'. Exits with an error message if FILE can't be read or
+ * holds no valid sudoku. */
 struct sudoku *
 sudoku_read(const char *file);
 
+/* Create sudoku from the LEN characters of TEXT in a single pass. TEXT holds
+ * either the matrix format, whitespace separated numbers with 0 or '.' for
+ * blanks, or the one-line format (see `sudoku_parse_line'). Returns NULL if
+ * TEXT is no valid sudoku. */
+struct sudoku *
+sudoku_parse(const char *text, size_t len);
+
+/* Largest number of elements of sudokus in one-line format, whose letters
+ * end at 'Z' for 35 */
+#define SUDOKU_LINE_MAX_NELEMS 35
+
+/* Parse sudoku in one-line format (one character per cell, '.' or '0' for
+ * blanks, letters 'A' to 'Z' for 10 to 35) from the LEN characters of LINE
+ * into SUDOKU, whose data is resized if necessary. Returns zero if LINE is no
+ * valid sudoku. */
+int
+sudoku_parse_line(struct sudoku *sudoku, const char *line, int len);
+
 /* Free memory of sudoku SUDOKU */
 void
 sudoku_free(struct sudoku *sudoku);
 
-/* Solve sudoku SUDOKU with dancing links algorithm. Returns array of solutions 
- * and writes number to NSOLS */
+/* Called for every solution SOLUTION found, which is only valid during the
+ * call. Returning non-zero stops the search. */
+typedef int (*sudoku_visitor)(const struct sudoku *solution, void *ctx);
+
+/* Solve sudoku SUDOKU using options OPTS (NULL for defaults) and call VISIT
+ * with context CTX for every solution as soon as it is found. With several
+ * threads solutions come in no particular order. Statistics are written to
+ * STATS unless it is NULL. Returns number of solutions visited. */
+long
+sudoku_visit(const struct sudoku *sudoku, const struct sudoku_options *opts,
+             sudoku_visitor visit, void *ctx, struct sudoku_stats *stats);
+
+/* Solve sudoku SUDOKU using options OPTS (NULL for defaults), stopping after
+ * MAX_SOLUTIONS solutions (0 for no limit; 1 finds the first solution, 2 tells
+ * whether it is unique). Returns array of solutions and writes number to
+ * NSOLS. Statistics are written to STATS unless it is NULL. Unlike
+ * `sudoku_visit', several threads find all solutions in the order of one, as
+ * they are merged once the search is over. */
 struct sudoku **
-sudoku_solve(const struct sudoku *sudoku, int *nsols);
+sudoku_solve(const struct sudoku *sudoku, const struct sudoku_options *opts,
+             int max_solutions, int *nsols, struct sudoku_stats *stats);
+
+/* Count solutions of sudoku SUDOKU up to MAX_SOLUTIONS (0 for no limit) using
+ * options OPTS (NULL for defaults) without storing them. Statistics are written
+ * to STATS unless it is NULL. */
+long
+sudoku_count(const struct sudoku *sudoku, const struct sudoku_options *opts,
+             long max_solutions, struct sudoku_stats *stats);
+
+/* Reusable sudoku solver which keeps its buffers between puzzles */
+struct sudoku_solver;
+
+/* Create reusable solver with options OPTS (NULL for defaults) */
+struct sudoku_solver *
+sudoku_solver_create(const struct sudoku_options *opts);
+
+/* Free memory of solver SOLVER */
+void
+sudoku_solver_free(struct sudoku_solver *solver);
+
+/* Solve SUDOKU with SOLVER and write first solution found to SOLUTION, which
+ * must have the same size. Returns 1 if a solution was found, 0 otherwise,
+ * which means there is none unless the search was aborted (see
+ * `sudoku_solver_stats'). */
+int
+sudoku_solver_solve(struct sudoku_solver *solver, const struct sudoku *sudoku,
+                    struct sudoku *solution);
+
+/* Count solutions of SUDOKU with SOLVER up to MAX_SOLUTIONS (at least 1), so
+ * 2 tells whether the solution is unique. Returns number of solutions found. */
+int
+sudoku_solver_count(struct sudoku_solver *solver, const struct sudoku *sudoku,
+                    int max_solutions);
+
+/* Count solutions of SUDOKU with SOLVER up to MAX_SOLUTIONS (at least 1) as
+ * `sudoku_solver_count' does, and write one of them to SOLUTION, which must
+ * have the same size. Returns number of solutions found. */
+int
+sudoku_solver_solve_max(struct sudoku_solver *solver, const struct sudoku *sudoku,
+                        int max_solutions, struct sudoku *solution);
+
+/* Returns statistics of the last sudoku solved by SOLVER */
+const struct sudoku_stats *
+sudoku_solver_stats(const struct sudoku_solver *solver);
+
+/* Incremental solver for a sudoku that changes one cell at a time. Placing a
+ * digit covers its row of the exact cover matrix and clearing it uncovers the
+ * row again, so nothing is rebuilt and each check is a search from the
+ * current state. Checks use dancing links on all candidates, without
+ * propagation. */
+struct sudoku_session;
+
+/* Create session starting with the filled cells of SUDOKU, searching with the
+ * dancing links options of OPTS (NULL for defaults). Returns NULL if filled
+ * cells of SUDOKU clash with each other. */
+struct sudoku_session *
+sudoku_session_create(const struct sudoku *sudoku, const struct sudoku_options *opts);
+
+/* Free memory of session SESSION */
+void
+sudoku_session_free(struct sudoku_session *session);
+
+/* Place ELEM at row ROW and column COL of the sudoku of SESSION, replacing the
+ * digit there. Returns zero, and leaves the cell as it was, if ELEM is out of
+ * range or already in the row, column or block. */
+int
+sudoku_session_set_cell(struct sudoku_session *session, int row, int col, int elem);
+
+/* Clear cell at row ROW and column COL of the sudoku of SESSION. Clearing the
+ * cell filled last is cheapest. Returns zero if the cell is out of range. */
+int
+sudoku_session_clear_cell(struct sudoku_session *session, int row, int col);
+
+/* Returns whether the sudoku of SESSION has a solution, and writes it to
+ * SOLUTION unless it is NULL */
+int
+sudoku_session_check_solvable(struct sudoku_session *session, struct sudoku *solution);
+
+/* Returns whether the sudoku of SESSION has exactly one solution */
+int
+sudoku_session_check_unique(struct sudoku_session *session);
+
+/* Returns the current sudoku of SESSION, valid until it is changed */
+const struct sudoku *
+sudoku_session_grid(const struct sudoku_session *session);
 
 /* Print data in SUDOKU to OUT. FANCY toggles between plain matrix (= false) and 
- * separators between blocks (= true). */
+ * separators between blocks (= true). Use a `struct writer' to print many. */
 void
 sudoku_fprint(FILE *out, const struct sudoku *sudoku, int fancy);
 
+/* Write data in SUDOKU to BUF in one-line format ('.' for blanks, letters from
+ * 'A' for elements above 9) followed by a newline. SUDOKU must have at most
+ * SUDOKU_LINE_MAX_NELEMS elements. BUF must hold NELEMS * NELEMS + 1
+ * characters; returns number of characters written. */
+int
+sudoku_sprint_line(char *buf, const struct sudoku *sudoku);
+
 #endif /* SUDOKU_H */
\ No newline at end of file
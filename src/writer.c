@@ -0,0 +1,185 @@
+#include "writer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Initial size of the output buffer */
+#define WRITER_BUFFER_SIZE (1 << 20)
+
+struct writer {
+    FILE *out;
+    enum writer_format format;
+    size_t len;
+    size_t cap;
+    char *buf;
+    int size;           /* Size the texts below are built for, 0 if none */
+    int celllen;        /* Length of a cell, an element with a space each side */
+    char *cells;        /* Text of element I (blank for 0) at I * CELLLEN */
+    int linelen;        /* Length of a line of the fancy format */
+    char *clrline;      /* Empty line of the fancy format */
+    char *sepline;      /* Line between bands of the fancy format */
+};
+
+struct writer *
+writer_create(FILE *out, enum writer_format format)
+{
+    struct writer *writer = malloc(sizeof *writer);
+    writer->out = out;
+    writer->format = format;
+    writer->len = 0;
+    writer->cap = WRITER_BUFFER_SIZE;
+    writer->buf = malloc(writer->cap);
+    writer->size = 0;
+    writer->cells = NULL;
+    writer->clrline = NULL;
+    writer->sepline = NULL;
+    return writer;
+}
+
+void
+writer_free(struct writer *writer)
+{
+    if (!writer) {
+        return;
+    }
+    writer_flush(writer);
+    free(writer->buf);
+    free(writer->cells);
+    free(writer->clrline);
+    free(writer->sepline);
+    free(writer);
+}
+
+void
+writer_flush(struct writer *writer)
+{
+    fwrite(writer->buf, 1, writer->len, writer->out);
+    writer->len = 0;
+}
+
+/* Make room for LEN more characters in buffer of WRITER and return where they
+ * go */
+static char *
+writer_reserve(struct writer *writer, size_t len)
+{
+    if (writer->len + len > writer->cap) {
+        writer_flush(writer);
+    }
+    if (len > writer->cap) {
+        while (len > writer->cap) {
+            writer->cap *= 2;
+        }
+        free(writer->buf);
+        writer->buf = malloc(writer->cap);
+    }
+    return &writer->buf[writer->len];
+}
+
+/* Build cell texts and lines of WRITER for sudokus of size SIZE */
+static void
+writer_build(struct writer *writer, int size)
+{
+    const int nelems = size * size;
+    /* Digits of the largest element */
+    int width = 1;
+    for (int n = nelems; n >= 10; n /= 10) {
+        ++width;
+    }
+
+    writer->size = size;
+    writer->celllen = width + 2;
+    writer->cells = realloc(writer->cells, (nelems + 1) * writer->celllen);
+    /* Cells are the element right-aligned between two spaces, the blank one
+     * only spaces */
+    memset(writer->cells, ' ', (nelems + 1) * writer->celllen);
+    for (int elem = 1; elem <= nelems; ++elem) {
+        char *pos = &writer->cells[(elem + 1) * writer->celllen - 1];
+        for (int n = elem; n > 0; n /= 10) {
+            *--pos = (char) ('0' + n % 10);
+        }
+    }
+
+    writer->linelen = nelems * writer->celllen + 3 * (size - 1);
+    writer->clrline = realloc(writer->clrline, writer->linelen);
+    writer->sepline = realloc(writer->sepline, writer->linelen);
+    char *clr = writer->clrline;
+    char *sep = writer->sepline;
+    for (int i = 0; i < size; ++i) {
+        memset(clr, ' ', size * writer->celllen);
+        memset(sep, '-', size * writer->celllen);
+        clr += size * writer->celllen;
+        sep += size * writer->celllen;
+        if (i < size - 1) {
+            memcpy(clr, " | ", 3);
+            memcpy(sep, "-+-", 3);
+            clr += 3;
+            sep += 3;
+        }
+    }
+}
+
+/* Append line LINE of LEN characters and a newline at POS. Returns position
+ * after it. */
+static char *
+writer_line(char *pos, const char *line, int len)
+{
+    memcpy(pos, line, len);
+    pos[len] = '\n';
+    return pos + len + 1;
+}
+
+void
+writer_sudoku(struct writer *writer, const struct sudoku *sudoku)
+{
+    const int size = sudoku->size;
+    const int nelems = sudoku->nelems;
+
+    if (writer->format == WRITER_LINE) {
+        char *pos = writer_reserve(writer, (size_t) nelems * nelems + 1);
+        writer->len += sudoku_sprint_line(pos, sudoku);
+        return;
+    }
+
+    if (writer->size != size) {
+        writer_build(writer, size);
+    }
+    const int fancy = writer->format == WRITER_FANCY;
+    const int celllen = writer->celllen;
+    const int linelen = writer->linelen;
+
+    /* Rows, and in the fancy format an empty line after each one, two lines
+     * between bands and one at the top */
+    char *start = writer_reserve(writer, (size_t) (linelen + 1) * (2 * nelems + 2 * size));
+    char *pos = start;
+    if (fancy) {
+        pos = writer_line(pos, writer->clrline, linelen);
+    }
+    for (int i = 0; i < nelems; ++i) {
+        const uint8_t *row = &sudoku->data[i * nelems];
+        for (int j = 0; j < nelems; ++j) {
+            if (fancy && (j > 0) && (j % size == 0)) {
+                memcpy(pos, " | ", 3);
+                pos += 3;
+            }
+            memcpy(pos, &writer->cells[row[j] * celllen], celllen);
+            pos += celllen;
+        }
+        *pos++ = '\n';
+        if (fancy) {
+            pos = writer_line(pos, writer->clrline, linelen);
+            if ((i < nelems - 1) && (i + 1) % size == 0) {
+                pos = writer_line(pos, writer->sepline, linelen);
+                pos = writer_line(pos, writer->clrline, linelen);
+            }
+        }
+    }
+    writer->len += pos - start;
+}
+
+void
+writer_puts(struct writer *writer, const char *str)
+{
+    const size_t len = strlen(str);
+    memcpy(writer_reserve(writer, len), str, len);
+    writer->len += len;
+}
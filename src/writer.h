@@ -0,0 +1,47 @@
+/* writer.h
+ *
+ * Header for writing sudokus to files through a large output buffer.
+ *
+ */
+
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdio.h>
+
+#include "sudoku.h"
+
+/* Formats sudokus are written in */
+enum writer_format {
+    WRITER_PLAIN,   /* Matrix of numbers */
+    WRITER_FANCY,   /* Matrix with separators between blocks */
+    WRITER_LINE     /* One character per cell on a single line (see
+                     * `sudoku_sprint_line') */
+};
+
+/* Writer formatting sudokus into a buffer which is handed to its file in bulk
+ * whenever it is full */
+struct writer;
+
+/* Create writer of sudokus in format FORMAT to OUT */
+struct writer *
+writer_create(FILE *out, enum writer_format format);
+
+/* Flush and free writer WRITER; its file is left open */
+void
+writer_free(struct writer *writer);
+
+/* Write SUDOKU with WRITER. Lines of the fancy format are built once per
+ * size. */
+void
+writer_sudoku(struct writer *writer, const struct sudoku *sudoku);
+
+/* Write string STR with WRITER */
+void
+writer_puts(struct writer *writer, const char *str);
+
+/* Hand everything written with WRITER so far to its file */
+void
+writer_flush(struct writer *writer);
+
+#endif /* WRITER_H */